@@ -32,6 +32,11 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
+  // pages of a database opened again keep their ids, new pages are allocated after them
+  auto num_pages = static_cast<uint32_t>(disk_manager_->GetNumPages());
+  next_page_id_ = static_cast<page_id_t>(num_pages + (num_instances_ + instance_index_ - num_pages % num_instances_) %
+                                                         num_instances_);
+
   // We allocate a consecutive memory space for the buffer pool.
   pages_ = new Page[pool_size_];
   replacer_ = new LRUReplacer(pool_size);
@@ -50,10 +55,31 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
 void BufferPoolManagerInstance::ResetPage(Page *page) {
   page->ResetMemory();
   page->is_dirty_ = false;
+  page->rec_lsn_ = INVALID_LSN;
   page->page_id_ = INVALID_PAGE_ID;
   page->pin_count_ = 0;
 }
 
+void BufferPoolManagerInstance::WritePageToDisk(Page *page) {
+  if (enable_logging && log_manager_ != nullptr && page->GetLSN() > log_manager_->GetPersistentLSN()) {
+    log_manager_->Flush(true);
+  }
+  page->is_dirty_ = false;
+  // a pinned page may be updated again right away, anything after this point is newer than the disk copy
+  page->rec_lsn_ = CurrentLSN();
+  disk_manager_->WritePage(page->GetPageId(), page->GetData());
+}
+
+void BufferPoolManagerInstance::GetDirtyPageTable(std::unordered_map<page_id_t, lsn_t> *dirty_page_table) {
+  std::lock_guard<std::mutex> lock(latch_);
+  for (auto &it : page_table_) {
+    Page *page = pages_ + it.second;
+    if ((page->IsDirty() || page->GetPinCount() > 0) && page->rec_lsn_ != INVALID_LSN) {
+      (*dirty_page_table)[it.first] = page->rec_lsn_;
+    }
+  }
+}
+
 bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
   std::lock_guard<std::mutex> lock(latch_);
@@ -61,8 +87,7 @@ bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
     return false;
   }
   Page *page = pages_ + page_table_[page_id];
-  page->is_dirty_ = false;
-  disk_manager_->WritePage(page_id, page->GetData());
+  WritePageToDisk(page);
   return true;
 }
 
@@ -70,10 +95,7 @@ void BufferPoolManagerInstance::FlushAllPgsImp() {
   // You can do it!
   std::lock_guard<std::mutex> lock(latch_);
   for (auto &it : page_table_) {
-    page_id_t page_id = it.first;
-    Page *page = pages_ + page_table_[it.first];
-    page->is_dirty_ = false;
-    disk_manager_->WritePage(page_id, page->GetData());
+    WritePageToDisk(pages_ + it.second);
   }
 }
 
@@ -100,8 +122,7 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
     BUSTUB_ASSERT(replacer_->Victim(&frame_id), true);
     page = pages_ + frame_id;
     if (page->IsDirty()) {
-      page->is_dirty_ = false;
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
+      WritePageToDisk(page);
     }
     page_table_.erase(page->GetPageId());
   }
@@ -111,6 +132,7 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   page_table_[*page_id] = frame_id;
   page->page_id_ = *page_id;
   page->pin_count_ = 1;
+  page->rec_lsn_ = CurrentLSN();
   // Print();
   return page;
 }
@@ -128,11 +150,7 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   Page *page = nullptr;
   // 1.1 p exist
   if (page_table_.find(page_id) != page_table_.end()) {
-    page = pages_ + page_table_[page_id];
-    page->pin_count_ += 1;
-    replacer_->Pin(page_table_[page_id]);
-    // Print();
-    return page;
+    return PinFrame(page_table_[page_id]);
   }
   // 1.2 p does not exist
   // 1.2.1 find page R from free_list
@@ -149,8 +167,7 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   // 2. if dirty, flush
   page = pages_ + frame_id;
   if (page->IsDirty()) {
-    page->is_dirty_ = false;
-    disk_manager_->WritePage(page->GetPageId(), page->GetData());
+    WritePageToDisk(page);
   }
 
   // 3, delete R and insert p
@@ -161,12 +178,36 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   ResetPage(page);
   page->page_id_ = page_id;
   page->pin_count_ += 1;
+  page->rec_lsn_ = CurrentLSN();
   disk_manager_->ReadPage(page_id, page->GetData());
+  // a page recovery brings back may not have reached the database file before the crash
+  if (page_id >= next_page_id_) {
+    next_page_id_ = page_id + static_cast<page_id_t>(num_instances_);
+  }
 
   // Print();
   return page;
 }
 
+Page *BufferPoolManagerInstance::FetchPageIfResident(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto it = page_table_.find(page_id);
+  if (it == page_table_.end()) {
+    return nullptr;
+  }
+  return PinFrame(it->second);
+}
+
+Page *BufferPoolManagerInstance::PinFrame(frame_id_t frame_id) {
+  Page *page = pages_ + frame_id;
+  if (page->pin_count_ == 0 && !page->is_dirty_) {
+    page->rec_lsn_ = CurrentLSN();
+  }
+  page->pin_count_ += 1;
+  replacer_->Pin(frame_id);
+  return page;
+}
+
 bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
   // 0.   Make sure you call DeallocatePage!
   // 1.   Search the page table for the requested page (P).
@@ -36,6 +36,17 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return pool_size_ * num_instances_;
 }
 
+void ParallelBufferPoolManager::GetDirtyPageTable(std::unordered_map<page_id_t, lsn_t> *dirty_page_table) {
+  // page ids are disjoint across instances, so the tables simply add up
+  for (auto &instance : instances_) {
+    instance->GetDirtyPageTable(dirty_page_table);
+  }
+}
+
+Page *ParallelBufferPoolManager::FetchPageIfResident(page_id_t page_id) {
+  return instances_[page_id % num_instances_]->FetchPageIfResident(page_id);
+}
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   return instances_[page_id % num_instances_];
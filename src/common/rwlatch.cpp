@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// rwlatch.cpp
+//
+// Identification: src/common/rwlatch.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/rwlatch.h"
+
+#include <climits>
+#include <thread>  // NOLINT
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bustub {
+
+void ReaderWriterLatch::WLockSlow() {
+  // First keep the new readers out, then wait for the ones inside to leave.
+  bool waiting = false;
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (!waiting && (state & (WRITER | WRITER_WAITING)) == 0) {
+      uint32_t next = (state & MAX_READERS) == 0 ? (state | WRITER) : (state | WRITER_WAITING);
+      if (state_.compare_exchange_weak(state, next, std::memory_order_acquire)) {
+        if ((next & WRITER) != 0) {
+          return;
+        }
+        waiting = true;
+      }
+      continue;
+    }
+    if (waiting && (state & MAX_READERS) == 0) {
+      if (state_.compare_exchange_weak(state, (state & ~WRITER_WAITING) | WRITER, std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (spins < SPIN_LIMIT) {
+      std::this_thread::yield();
+      continue;
+    }
+    if ((state & PARKED) == 0 && !state_.compare_exchange_weak(state, state | PARKED, std::memory_order_relaxed)) {
+      continue;
+    }
+    Park(state | PARKED);
+  }
+}
+
+void ReaderWriterLatch::RLockSlow() {
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & (WRITER | WRITER_WAITING)) == 0 && (state & MAX_READERS) != MAX_READERS) {
+      if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (spins < SPIN_LIMIT) {
+      std::this_thread::yield();
+      continue;
+    }
+    if ((state & PARKED) == 0 && !state_.compare_exchange_weak(state, state | PARKED, std::memory_order_relaxed)) {
+      continue;
+    }
+    Park(state | PARKED);
+  }
+}
+
+void ReaderWriterLatch::Park(uint32_t state) {
+#ifdef __linux__
+  // returns at once if the word changed since it was read, so a release in between is not missed
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAIT_PRIVATE, state, nullptr, nullptr, 0);
+#else
+  std::this_thread::yield();
+#endif
+}
+
+void ReaderWriterLatch::Wake() {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+}  // namespace bustub
@@ -12,6 +12,9 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <memory>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -19,6 +22,258 @@
 
 namespace bustub {
 
+namespace {
+
+using LockMode = LockManager::LockMode;
+
+/** Bit of a lock mode in a set of modes. */
+constexpr uint32_t ModeBit(LockMode lock_mode) { return 1U << static_cast<uint32_t>(lock_mode); }
+
+/** @return the set of modes other transactions may hold together with the given one */
+uint32_t CompatibleModes(LockMode lock_mode) {
+  switch (lock_mode) {
+    case LockMode::INTENTION_SHARED:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::INTENTION_EXCLUSIVE) |
+             ModeBit(LockMode::SHARED) | ModeBit(LockMode::SHARED_INTENTION_EXCLUSIVE);
+    case LockMode::INTENTION_EXCLUSIVE:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::INTENTION_EXCLUSIVE);
+    case LockMode::SHARED:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::SHARED);
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return ModeBit(LockMode::INTENTION_SHARED);
+    case LockMode::EXCLUSIVE:
+      return 0;
+  }
+  return 0;
+}
+
+/** @return the set of modes whose rights the given mode includes */
+uint32_t CoveredModes(LockMode lock_mode) {
+  switch (lock_mode) {
+    case LockMode::INTENTION_SHARED:
+      return ModeBit(LockMode::INTENTION_SHARED);
+    case LockMode::INTENTION_EXCLUSIVE:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::INTENTION_EXCLUSIVE);
+    case LockMode::SHARED:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::SHARED);
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::INTENTION_EXCLUSIVE) |
+             ModeBit(LockMode::SHARED) | ModeBit(LockMode::SHARED_INTENTION_EXCLUSIVE);
+    case LockMode::EXCLUSIVE:
+      return ModeBit(LockMode::INTENTION_SHARED) | ModeBit(LockMode::INTENTION_EXCLUSIVE) |
+             ModeBit(LockMode::SHARED) | ModeBit(LockMode::SHARED_INTENTION_EXCLUSIVE) | ModeBit(LockMode::EXCLUSIVE);
+  }
+  return 0;
+}
+
+bool Covers(LockMode held_mode, LockMode lock_mode) { return (CoveredModes(held_mode) & ModeBit(lock_mode)) != 0; }
+
+/** @return the weakest mode that covers both modes */
+LockMode Combine(LockMode held_mode, LockMode lock_mode) {
+  if (Covers(held_mode, lock_mode)) {
+    return held_mode;
+  }
+  if (Covers(lock_mode, held_mode)) {
+    return lock_mode;
+  }
+  // S and IX are the only modes that do not cover one another
+  return LockMode::SHARED_INTENTION_EXCLUSIVE;
+}
+
+std::shared_ptr<std::unordered_set<table_oid_t>> TableLockSet(Transaction *txn, LockMode lock_mode) {
+  switch (lock_mode) {
+    case LockMode::SHARED:
+      return txn->GetSharedTableLockSet();
+    case LockMode::EXCLUSIVE:
+      return txn->GetExclusiveTableLockSet();
+    case LockMode::INTENTION_SHARED:
+      return txn->GetIntentionSharedTableLockSet();
+    case LockMode::INTENTION_EXCLUSIVE:
+      return txn->GetIntentionExclusiveTableLockSet();
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return txn->GetSharedIntentionExclusiveTableLockSet();
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+LockManager::LockManager(DeadlockMode deadlock_mode, size_t escalation_threshold)
+    : deadlock_mode_(deadlock_mode), escalation_threshold_(escalation_threshold) {
+  if (deadlock_mode_ == DeadlockMode::DETECTION) {
+    enable_cycle_detection_ = true;
+    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+  }
+}
+
+LockManager::~LockManager() {
+  if (cycle_detection_thread_ != nullptr) {
+    enable_cycle_detection_ = false;
+    cycle_detection_thread_->join();
+    delete cycle_detection_thread_;
+  }
+}
+
+LockManager::LockTableShard<RID> *LockManager::ShardOf(const RID &rid) {
+  // rids on one page differ in the low bits of the hash, pages in the high bits; fold both into the shard index
+  auto hash = std::hash<RID>()(rid);
+  return &shards_[(hash ^ (hash >> 32)) % LOCK_TABLE_SHARDS];
+}
+
+LockManager::LockRequest *LockManager::LockRequestQueue::Find(txn_id_t txn_id) {
+  auto it = requests_.find(txn_id);
+  return it == requests_.end() ? nullptr : it->second.get();
+}
+
+LockManager::LockRequest *LockManager::LockRequestQueue::Append(txn_id_t txn_id, LockMode lock_mode) {
+  auto *request = (requests_[txn_id] = std::make_unique<LockRequest>(txn_id, lock_mode)).get();
+  Link(request, nullptr);
+  return request;
+}
+
+LockManager::LockRequest *LockManager::LockRequestQueue::InsertAfterGranted(txn_id_t txn_id, LockMode lock_mode) {
+  auto *request = (requests_[txn_id] = std::make_unique<LockRequest>(txn_id, lock_mode)).get();
+  LockRequest *next = head_;
+  while (next != nullptr && next->granted_) {
+    next = next->next_;
+  }
+  Link(request, next);
+  return request;
+}
+
+void LockManager::LockRequestQueue::Link(LockRequest *request, LockRequest *next) {
+  LockRequest *prev = next == nullptr ? tail_ : next->prev_;
+  request->prev_ = prev;
+  request->next_ = next;
+  (prev == nullptr ? head_ : prev->next_) = request;
+  (next == nullptr ? tail_ : next->prev_) = request;
+}
+
+void LockManager::LockRequestQueue::Remove(LockRequest *request) {
+  (request->prev_ == nullptr ? head_ : request->prev_->next_) = request->next_;
+  (request->next_ == nullptr ? tail_ : request->next_->prev_) = request->prev_;
+  requests_.erase(request->txn_id_);
+}
+
+void LockManager::LockRequestQueue::Grant() {
+  // modes of the requests before the current one
+  uint32_t ahead = 0;
+  for (LockRequest *request = head_; request != nullptr; request = request->next_) {
+    if (!request->granted_) {
+      if ((ahead & ~CompatibleModes(request->lock_mode_)) != 0) {
+        return;
+      }
+      request->granted_ = true;
+      request->cv_.notify_one();
+    }
+    ahead |= ModeBit(request->lock_mode_);
+  }
+}
+
+bool LockManager::LockRequestQueue::GrantableNow(txn_id_t txn_id, LockMode lock_mode, bool is_upgrade) const {
+  for (LockRequest *request = head_; request != nullptr; request = request->next_) {
+    if (request->txn_id_ == txn_id) {
+      continue;
+    }
+    if (!request->granted_) {
+      // the granted requests all come first; an upgrade would be inserted here, a new request behind all waiters
+      return is_upgrade;
+    }
+    if ((CompatibleModes(lock_mode) & ModeBit(request->lock_mode_)) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LockManager::Wound(LockRequest *request, std::vector<txn_id_t> *wounded) {
+  {
+    TransactionRegistry::Guard guard(&TransactionManager::txn_registry);
+    Transaction *txn = TransactionManager::GetTransaction(request->txn_id_);
+    if (txn != nullptr) {
+      txn->SetState(TransactionState::ABORTED);
+    }
+  }
+  if (!request->granted_) {
+    request->cv_.notify_one();
+  } else {
+    // the transaction may be waiting on another queue, whose mutex cannot be taken while holding this one
+    wounded->push_back(request->txn_id_);
+  }
+}
+
+void LockManager::WoundYounger(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode,
+                               std::vector<txn_id_t> *wounded) {
+  if (deadlock_mode_ == DeadlockMode::DETECTION) {
+    return;
+  }
+  for (LockRequest *other = queue->Head(); other != nullptr; other = other->next_) {
+    if (txn->GetTransactionId() < other->txn_id_ && (CompatibleModes(lock_mode) & ModeBit(other->lock_mode_)) == 0) {
+      Wound(other, wounded);
+    }
+  }
+}
+
+void LockManager::MarkWaiting(txn_id_t txn_id, const RID &rid) {
+  std::lock_guard<std::mutex> guard(waiting_latch_);
+  waiting_rows_[txn_id] = rid;
+}
+
+void LockManager::MarkWaiting(txn_id_t txn_id, table_oid_t oid) {
+  std::lock_guard<std::mutex> guard(waiting_latch_);
+  waiting_tables_[txn_id] = oid;
+}
+
+void LockManager::ClearWaiting(txn_id_t txn_id) {
+  std::lock_guard<std::mutex> guard(waiting_latch_);
+  waiting_rows_.erase(txn_id);
+  waiting_tables_.erase(txn_id);
+}
+
+bool LockManager::WakeWaiting(txn_id_t txn_id, bool abort) {
+  std::unique_lock<std::mutex> guard(waiting_latch_);
+  auto row = waiting_rows_.find(txn_id);
+  if (row != waiting_rows_.end()) {
+    RID rid = row->second;
+    guard.unlock();
+    return WakeWaiter(ShardOf(rid), rid, txn_id, abort);
+  }
+  auto table = waiting_tables_.find(txn_id);
+  if (table != waiting_tables_.end()) {
+    table_oid_t oid = table->second;
+    guard.unlock();
+    return WakeWaiter(&table_locks_, oid, txn_id, abort);
+  }
+  return false;
+}
+
+template <typename K>
+bool LockManager::WaitForGrant(Transaction *txn, const K &key, LockRequestQueue *queue, LockRequest *request,
+                               std::unique_lock<std::mutex> *lock, const std::vector<txn_id_t> &wounded) {
+  if (!wounded.empty()) {
+    // only one queue mutex is ever held at a time, so the transactions wounded here are woken with it released
+    lock->unlock();
+    for (txn_id_t txn_id : wounded) {
+      WakeWaiting(txn_id);
+    }
+    lock->lock();
+  }
+  if (!request->granted_ && txn->GetState() == TransactionState::GROWING) {
+    // marked before the state is checked again, so an abort either is seen here or finds the request to wake
+    MarkWaiting(txn->GetTransactionId(), key);
+    while (!request->granted_ && txn->GetState() == TransactionState::GROWING) {
+      request->cv_.wait(*lock);
+    }
+    ClearWaiting(txn->GetTransactionId());
+  }
+  if (txn->GetState() == TransactionState::GROWING) {
+    return true;
+  }
+  queue->Remove(request);
+  queue->Grant();
+  return false;
+}
+
 // deadlock prevention ==> wound - wait
 // 1, older txn request newer txn lock: newer txn abort and older txn hold lock
 // 2, newer txn reques older txn lock: wait
@@ -27,46 +282,27 @@ bool LockManager::LockShared(Transaction *txn, const RID &rid) {
   if (txn->GetState() != TransactionState::GROWING) {
     txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+  } else if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_READ_ONLY);
   } else if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED) {
     txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
   }
 
-  // std::cout << "S-lock(" << txn->GetTransactionId() << ", " << rid << ")" << std::endl;
-  latch_.lock();
-  auto& req_q =  lock_table_[rid];
+  QueueHandle<RID> handle(ShardOf(rid), rid);
+  auto &req_q = handle.Queue();
   std::unique_lock<std::mutex> lock(req_q.mutex);
-  latch_.unlock();
-
-  req_q.request_queue_.push_front({txn->GetTransactionId(), LockMode::SHARED});
+  LockRequest *request = req_q.Append(txn->GetTransactionId(), LockMode::SHARED);
 
   // if older txn request newer txn lock: newer txn abort
-  for (auto iter = req_q.request_queue_.rbegin(); iter != req_q.request_queue_.rend(); ++iter) {
-    if (txn->GetTransactionId() < iter->txn_id_ && iter->lock_mode_ == LockMode::EXCLUSIVE) {
-      TransactionManager::GetTransaction(iter->txn_id_)->SetState(TransactionState::ABORTED);
-    }
-  }
-
-  auto should_wait = [&]()-> bool {
-    for (auto iter = req_q.request_queue_.rbegin(); iter != req_q.request_queue_.rend(); ++iter) {
-      if (txn->GetState() != TransactionState::GROWING) return false;
-      if (iter->txn_id_ == txn->GetTransactionId()) return false;
-      if (iter->lock_mode_ == LockMode::EXCLUSIVE) return true;
-    }
-    return true;
-  };
-
-  while (should_wait()) req_q.cv_.wait(lock);
+  std::vector<txn_id_t> wounded;
+  WoundYounger(txn, &req_q, LockMode::SHARED, &wounded);
+  req_q.Grant();
 
-  auto lock_req = req_q.GetIterByTxnId(txn->GetTransactionId());
-  if (txn->GetState() != TransactionState::GROWING) {
-    req_q.request_queue_.erase(lock_req);
-    req_q.cv_.notify_all();
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+  if (!WaitForGrant(txn, rid, &req_q, request, &lock, wounded)) {
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
   }
-  // std::cout << "S-lock(" << txn->GetTransactionId() << ", " << rid << "),  success" << std::endl;
-  lock_req->granted_ = true;
-  txn->SetState(TransactionState::GROWING);
   txn->GetSharedLockSet()->emplace(rid);
   return true;
 }
@@ -75,44 +311,24 @@ bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
   if (txn->GetState() != TransactionState::GROWING) {
     txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+  } else if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_READ_ONLY);
   }
-  // std::cout << "X-lock(" << txn->GetTransactionId() << ", " << rid << ")" << std::endl;
-  latch_.lock();
-  auto& req_q =  lock_table_[rid];
+
+  QueueHandle<RID> handle(ShardOf(rid), rid);
+  auto &req_q = handle.Queue();
   std::unique_lock<std::mutex> lock(req_q.mutex);
-  latch_.unlock();
+  LockRequest *request = req_q.Append(txn->GetTransactionId(), LockMode::EXCLUSIVE);
 
-  req_q.request_queue_.emplace_front(txn->GetTransactionId(), LockMode::EXCLUSIVE);
-  
   // if older txn request newer txn lock: newer txn abort
-  for (auto iter = req_q.request_queue_.begin(); iter != req_q.request_queue_.end(); ++iter) {
-    if (txn->GetTransactionId() < iter->txn_id_) {
-      TransactionManager::GetTransaction(iter->txn_id_)->SetState(TransactionState::ABORTED);
-    }
-  }
-  
-
-  auto should_wait = [&]()-> bool {
-    if (txn->GetState() != TransactionState::GROWING) return false;
-    return txn->GetTransactionId() != req_q.request_queue_.back().txn_id_;
-  };
+  std::vector<txn_id_t> wounded;
+  WoundYounger(txn, &req_q, LockMode::EXCLUSIVE, &wounded);
+  req_q.Grant();
 
-  while (should_wait()) {
-    // std::cout << txn->GetTransactionId() << " X-lock waiting... ";
-    // std::cout << "queue front is " << req_q.request_queue_.back().txn_id_ << std::endl;
-    req_q.cv_.wait(lock);
+  if (!WaitForGrant(txn, rid, &req_q, request, &lock, wounded)) {
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
   }
-
-  auto lock_req = req_q.GetIterByTxnId(txn->GetTransactionId());
-  if (txn->GetState() != TransactionState::GROWING) {
-    req_q.request_queue_.erase(lock_req);
-    req_q.cv_.notify_all();
-    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
-  }
-  
-  // std::cout << "X-lock(" << txn->GetTransactionId() << ", " << rid << "),  success" << std::endl;
-  lock_req->granted_ = true;
-  txn->SetState(TransactionState::GROWING);
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
@@ -121,95 +337,376 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
   if (txn->GetState() != TransactionState::GROWING) {
     txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+  } else if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_READ_ONLY);
   }
 
-  latch_.lock();
-  auto& req_q =  lock_table_[rid];
+  QueueHandle<RID> handle(ShardOf(rid), rid);
+  auto &req_q = handle.Queue();
   std::unique_lock<std::mutex> lock(req_q.mutex);
-  latch_.unlock();
 
-  bool has_s_lock = false;
-  for (auto iter = req_q.request_queue_.begin(); iter != req_q.request_queue_.end(); ++iter) {
-    if(iter->txn_id_ == txn->GetTransactionId()) {
-      req_q.request_queue_.erase(iter);
-      has_s_lock = true;
-      txn->GetSharedLockSet()->erase(rid);
-      break;
-    }
-  }
-  if (!has_s_lock) {
+  // only one transaction may wait for an upgrade, two would each wait for the other's shared lock
+  LockRequest *shared_request = req_q.Find(txn->GetTransactionId());
+  if (shared_request == nullptr || req_q.upgrading_ != INVALID_TXN_ID) {
+    txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::UPGRADE_CONFLICT);
   }
-  
+  req_q.Remove(shared_request);
+  txn->GetSharedLockSet()->erase(rid);
+
   // if older txn request newer txn lock: newer txn abort
-  for (auto iter = req_q.request_queue_.begin(); iter != req_q.request_queue_.end(); ++iter) {
-    if (txn->GetTransactionId() < iter->txn_id_) {
-      TransactionManager::GetTransaction(iter->txn_id_)->SetState(TransactionState::ABORTED);
+  std::vector<txn_id_t> wounded;
+  WoundYounger(txn, &req_q, LockMode::EXCLUSIVE, &wounded);
+
+  // the upgrade goes ahead of every waiting request
+  LockRequest *request = req_q.InsertAfterGranted(txn->GetTransactionId(), LockMode::EXCLUSIVE);
+  req_q.upgrading_ = txn->GetTransactionId();
+  req_q.Grant();
+
+  bool granted = WaitForGrant(txn, rid, &req_q, request, &lock, wounded);
+  req_q.upgrading_ = INVALID_TXN_ID;
+  if (!granted) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+  }
+  txn->GetExclusiveLockSet()->emplace(rid);
+  return true;
+}
+
+bool LockManager::Unlock(Transaction *txn, const RID &rid) {
+  if (!ReleaseRow(txn, rid)) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::GROWING) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  return true;
+}
+
+bool LockManager::ReleaseRow(Transaction *txn, const RID &rid) {
+  txn->GetSharedLockSet()->erase(rid);
+  txn->GetExclusiveLockSet()->erase(rid);
+  for (auto &table_rows : *txn->GetTableRowLockSet()) {
+    table_rows.second.erase(rid);
+  }
+
+  QueueHandle<RID> handle(ShardOf(rid), rid);
+  auto &req_q = handle.Queue();
+  std::unique_lock<std::mutex> lock(req_q.mutex);
+  LockRequest *request = req_q.Find(txn->GetTransactionId());
+  if (request == nullptr) {
+    return false;
+  }
+  req_q.Remove(request);
+  req_q.Grant();
+  return true;
+}
+
+bool LockManager::Lock(Transaction *txn, table_oid_t oid, RID rid, bool is_read) {
+  // snapshot and optimistic reads see committed versions only, the optimistic ones are validated at commit
+  if (is_read && txn->ReadsVersions()) {
+    return true;
+  }
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_READ_ONLY);
+  }
+  LockMode table_mode;
+  if (HeldTableLockMode(txn, oid, &table_mode)) {
+    if (table_mode == LockMode::EXCLUSIVE) {
+      return true;
+    }
+    if (is_read && (table_mode == LockMode::SHARED || table_mode == LockMode::SHARED_INTENTION_EXCLUSIVE)) {
+      return true;
     }
   }
 
-  bool has_insert = false;
-  for (auto iter = req_q.request_queue_.begin(); iter != req_q.request_queue_.end(); ++iter) {
-    if (iter->granted_) {
-    req_q.request_queue_.insert(iter, {txn->GetTransactionId(), LockMode::EXCLUSIVE});
-    has_insert = true;
-    break;
+  if (!is_read) {
+    // a buffered optimistic write is locked when the transaction commits
+    if (txn->GetBufferedWriteSet()->count(rid) != 0) {
+      return true;
     }
+    LockTable(txn, LockMode::INTENTION_EXCLUSIVE, oid);
+    // a row locked without Lock(), as TablePage::InsertTuple locks a new row, is still counted on its table below
+    if (txn->IsSharedLocked(rid)) {
+      LockUpgrade(txn, rid);
+    } else if (!txn->IsExclusiveLocked(rid)) {
+      LockExclusive(txn, rid);
+    }
+  } else {
+    if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
+      return true;
+    }
+    if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED) {
+      return true;
+    }
+    LockTable(txn, LockMode::INTENTION_SHARED, oid);
+    LockShared(txn, rid);
   }
-  
-  if (!has_insert) {
-    req_q.request_queue_.emplace_front(txn->GetTransactionId(), LockMode::EXCLUSIVE);
+
+  auto &rows = (*txn->GetTableRowLockSet())[oid];
+  // a failed escalation is retried once as many rows are locked again, not on every lock
+  if (rows.emplace(rid).second && escalation_threshold_ != 0 && rows.size() % escalation_threshold_ == 0) {
+    Escalate(txn, oid);
   }
-  req_q.upgrading_ = txn->GetTransactionId();
+  return true;
+}
 
-  auto should_wait = [&]()-> bool {
-    if (txn->GetState() != TransactionState::GROWING) return false;
-    return txn->GetTransactionId() != req_q.request_queue_.back().txn_id_;
-  };
+void LockManager::UnlockRead(Transaction *txn, const RID &rid) {
+  if (txn->IsSharedLocked(rid)) {
+    ReleaseRow(txn, rid);
+  }
+}
 
-  while (should_wait()) {
-    // std::cout << txn->GetTransactionId() << " X-lock waiting... ";
-    // std::cout << "queue front is " << req_q.request_queue_.front().txn_id_ << std::endl;
-    req_q.cv_.wait(lock);
+void LockManager::Escalate(Transaction *txn, table_oid_t oid) {
+  auto &rows = (*txn->GetTableRowLockSet())[oid];
+  bool has_exclusive = std::any_of(rows.begin(), rows.end(), [txn](const RID &rid) {
+    return txn->IsExclusiveLocked(rid);
+  });
+  if (!AcquireTable(txn, has_exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED, oid, false)) {
+    return;
+  }
+  LockMode table_mode;
+  HeldTableLockMode(txn, oid, &table_mode);
+  // S and SIX only cover reading, the exclusive row locks stay under them
+  std::vector<RID> covered;
+  for (const auto &rid : rows) {
+    if (table_mode == LockMode::EXCLUSIVE || !txn->IsExclusiveLocked(rid)) {
+      covered.push_back(rid);
+    }
+  }
+  for (const auto &rid : covered) {
+    ReleaseRow(txn, rid);
   }
+}
+
+bool LockManager::LockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid) {
+  return AcquireTable(txn, lock_mode, oid, true);
+}
 
-  auto lock_req = req_q.GetIterByTxnId(txn->GetTransactionId());
+bool LockManager::AcquireTable(Transaction *txn, LockMode lock_mode, table_oid_t oid, bool wait) {
   if (txn->GetState() != TransactionState::GROWING) {
-    req_q.request_queue_.erase(lock_req);
-    req_q.cv_.notify_all();
-     txn->SetState(TransactionState::ABORTED);
+    txn->SetState(TransactionState::ABORTED);
     throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_SHRINKING);
+  } else if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCK_ON_READ_ONLY);
+  }
+  LockMode held_mode;
+  bool is_upgrade = HeldTableLockMode(txn, oid, &held_mode);
+  if (is_upgrade) {
+    if (Covers(held_mode, lock_mode)) {
+      return true;
+    }
+    lock_mode = Combine(held_mode, lock_mode);
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && lock_mode != LockMode::INTENTION_EXCLUSIVE &&
+      lock_mode != LockMode::EXCLUSIVE) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
   }
 
-  req_q.upgrading_ = INVALID_TXN_ID;
-  lock_req->granted_ = true;
-  txn->GetExclusiveLockSet()->emplace(rid);
+  QueueHandle<table_oid_t> handle(&table_locks_, oid);
+  auto &req_q = handle.Queue();
+  std::unique_lock<std::mutex> lock(req_q.mutex);
+  if (!wait && ((is_upgrade && req_q.upgrading_ != INVALID_TXN_ID) ||
+                !req_q.GrantableNow(txn->GetTransactionId(), lock_mode, is_upgrade))) {
+    // giving up leaves the transaction as it was, another transaction's pending upgrade is no conflict then
+    return false;
+  }
+  LockRequest *request;
+  std::vector<txn_id_t> wounded;
+  if (is_upgrade) {
+    if (req_q.upgrading_ != INVALID_TXN_ID) {
+      txn->SetState(TransactionState::ABORTED);
+      throw TransactionAbortException(txn->GetTransactionId(), AbortReason::UPGRADE_CONFLICT);
+    }
+    req_q.Remove(req_q.Find(txn->GetTransactionId()));
+    TableLockSet(txn, held_mode)->erase(oid);
+    if (wait) {
+      WoundYounger(txn, &req_q, lock_mode, &wounded);
+    }
+    // the upgrade goes ahead of every waiting request
+    request = req_q.InsertAfterGranted(txn->GetTransactionId(), lock_mode);
+    req_q.upgrading_ = txn->GetTransactionId();
+  } else {
+    request = req_q.Append(txn->GetTransactionId(), lock_mode);
+    if (wait) {
+      WoundYounger(txn, &req_q, lock_mode, &wounded);
+    }
+  }
+  req_q.Grant();
+
+  bool granted = WaitForGrant(txn, oid, &req_q, request, &lock, wounded);
+  if (is_upgrade) {
+    req_q.upgrading_ = INVALID_TXN_ID;
+  }
+  if (!granted) {
+    txn->SetState(TransactionState::ABORTED);
+    throw TransactionAbortException(txn->GetTransactionId(), AbortReason::DEADLOCK);
+  }
+  TableLockSet(txn, lock_mode)->emplace(oid);
   return true;
 }
 
-bool LockManager::Unlock(Transaction *txn, const RID &rid) {
-  txn->GetSharedLockSet()->erase(rid);
-  txn->GetExclusiveLockSet()->erase(rid);
-  //std::cout << "un-lock(" << txn->GetTransactionId() << ", " << rid << ")" << std::endl;
-  std::lock_guard<std::mutex> lock_guard(latch_);
-  auto& req_q =  lock_table_.at(rid);
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  LockMode held_mode;
+  if (!HeldTableLockMode(txn, oid, &held_mode)) {
+    return false;
+  }
+  TableLockSet(txn, held_mode)->erase(oid);
 
+  QueueHandle<table_oid_t> handle(&table_locks_, oid);
+  auto &req_q = handle.Queue();
   std::unique_lock<std::mutex> lock(req_q.mutex);
-  for(auto iter = req_q.request_queue_.begin(); iter != req_q.request_queue_.end(); ++iter) {
-    if (iter->txn_id_ == txn->GetTransactionId()) {
-      req_q.request_queue_.erase(iter);
-      req_q.cv_.notify_all();
-      if (txn->GetState() == TransactionState::GROWING) {
-        txn->SetState(TransactionState::SHRINKING);
+  LockRequest *request = req_q.Find(txn->GetTransactionId());
+  if (request == nullptr) {
+    return false;
+  }
+  req_q.Remove(request);
+  req_q.Grant();
+  if (txn->GetState() == TransactionState::GROWING) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  return true;
+}
+
+bool LockManager::HeldTableLockMode(Transaction *txn, table_oid_t oid, LockMode *lock_mode) {
+  for (LockMode mode : {LockMode::EXCLUSIVE, LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::SHARED,
+                        LockMode::INTENTION_EXCLUSIVE, LockMode::INTENTION_SHARED}) {
+    if (TableLockSet(txn, mode)->count(oid) != 0) {
+      *lock_mode = mode;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) { waits_for_[t1].insert(t2); }
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  auto it = waits_for_.find(t1);
+  if (it == waits_for_.end()) {
+    return;
+  }
+  it->second.erase(t2);
+  if (it->second.empty()) {
+    waits_for_.erase(it);
+  }
+}
+
+bool LockManager::HasCycle(txn_id_t *txn_id) {
+  std::set<txn_id_t> visited;
+  for (const auto &edges : waits_for_) {
+    std::vector<txn_id_t> path;
+    if (visited.count(edges.first) == 0 && FindCycle(edges.first, &path, &visited, txn_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LockManager::FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::set<txn_id_t> *visited,
+                            txn_id_t *victim) {
+  visited->insert(txn_id);
+  path->push_back(txn_id);
+  auto it = waits_for_.find(txn_id);
+  if (it != waits_for_.end()) {
+    for (txn_id_t next : it->second) {
+      auto on_path = std::find(path->begin(), path->end(), next);
+      if (on_path != path->end()) {
+        *victim = *std::max_element(on_path, path->end());
+        return true;
       }
-      if (req_q.request_queue_.empty()) {
-        lock_table_.erase(rid);
+      if (visited->count(next) == 0 && FindCycle(next, path, visited, victim)) {
+        return true;
       }
-      //std::cout << "un-lock(" << txn->GetTransactionId() << ", " << rid << "),  success" << std::endl;
-      return true;
     }
   }
+  path->pop_back();
   return false;
 }
 
+std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
+  std::vector<std::pair<txn_id_t, txn_id_t>> edges;
+  for (const auto &from : waits_for_) {
+    for (txn_id_t to : from.second) {
+      edges.emplace_back(from.first, to);
+    }
+  }
+  return edges;
+}
+
+template <typename K>
+void LockManager::BuildGraph(LockTableShard<K> *shard) {
+  std::lock_guard<std::mutex> guard(shard->latch_);
+  for (auto &entry : shard->lock_table_) {
+    LockRequestQueue &queue = entry.second;
+    std::lock_guard<std::mutex> queue_guard(queue.mutex);
+    for (LockRequest *waiter = queue.Head(); waiter != nullptr; waiter = waiter->next_) {
+      if (waiter->granted_) {
+        continue;
+      }
+      // a waiter waits for everything conflicting ahead of it, granted or not, since grants go in queue order
+      for (LockRequest *ahead = queue.Head(); ahead != waiter; ahead = ahead->next_) {
+        if ((CompatibleModes(waiter->lock_mode_) & ModeBit(ahead->lock_mode_)) == 0) {
+          AddEdge(waiter->txn_id_, ahead->txn_id_);
+        }
+      }
+    }
+  }
+}
+
+template <typename K>
+bool LockManager::WakeWaiter(LockTableShard<K> *shard, const K &key, txn_id_t txn_id, bool abort) {
+  QueueHandle<K> handle(shard, key);
+  auto &req_q = handle.Queue();
+  std::unique_lock<std::mutex> lock(req_q.mutex);
+  LockRequest *request = req_q.Find(txn_id);
+  if (request == nullptr || request->granted_) {
+    return false;
+  }
+  if (abort) {
+    // under the queue mutex the waiter can neither be granted nor go on to commit, so its state is final here
+    TransactionRegistry::Guard guard(&TransactionManager::txn_registry);
+    Transaction *txn = TransactionManager::GetTransaction(txn_id);
+    if (txn == nullptr || txn->GetState() != TransactionState::GROWING) {
+      return false;
+    }
+    txn->SetState(TransactionState::ABORTED);
+  }
+  request->cv_.notify_one();
+  return true;
+}
+
+bool LockManager::BreakCycles() {
+  txn_id_t victim;
+  while (HasCycle(&victim)) {
+    if (!WakeWaiting(victim, true)) {
+      return false;
+    }
+    waits_for_.erase(victim);
+    for (auto &edges : waits_for_) {
+      edges.second.erase(victim);
+    }
+  }
+  return true;
+}
+
+void LockManager::RunCycleDetection() {
+  while (enable_cycle_detection_) {
+    std::this_thread::sleep_for(cycle_detection_interval);
+    // the graph is rebuilt from the queues every round, nothing is kept in sync with the lock calls; the queues are
+    // not latched all at once, so a victim may have been granted its lock since, and the graph is rebuilt then
+    do {
+      waits_for_.clear();
+      for (auto &shard : shards_) {
+        BuildGraph(&shard);
+      }
+      BuildGraph(&table_locks_);
+    } while (!BreakCycles() && enable_cycle_detection_);
+  }
+}
+
 }  // namespace bustub
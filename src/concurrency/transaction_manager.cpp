@@ -12,35 +12,71 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
+TransactionRegistry TransactionManager::txn_registry;
 
-Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
+Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level,
+                                       ConcurrencyControl concurrency_control) {
   // Acquire the global transaction latch in shared mode.
   global_txn_latch_.RLock();
 
   if (txn == nullptr) {
     txn = new Transaction(next_txn_id_++, isolation_level);
   }
-  txn_map_mutex.lock();
-  txn_map[txn->GetTransactionId()] = txn;
-  txn_map_mutex.unlock();
+  txn->SetConcurrencyControl(concurrency_control);
+  txn_registry.Register(txn);
+
+  BeginSnapshot(txn);
+
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+  return txn;
+}
+
+Transaction *TransactionManager::BeginReadOnly() {
+  // Changing no page, a read-only transaction has nothing to log and no checkpoint to wait for.
+  auto *txn = new Transaction(next_txn_id_++, IsolationLevel::SNAPSHOT_ISOLATION, true);
+  BeginSnapshot(txn);
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
+bool TransactionManager::Commit(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::COMMITTED);
+    EndSnapshot(txn);
+    return true;
+  }
+  if (txn->IsOptimistic() && !ValidateOptimistic(txn)) {
+    Abort(txn);
+    return false;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
-  // Perform all deletes before we commit.
+  // Publish the versions first, a snapshot that sees the commit must see all of its writes.
   auto write_set = txn->GetWriteSet();
+  if (!write_set->empty()) {
+    std::lock_guard<std::mutex> guard(ts_latch_);
+    timestamp_t commit_ts = last_commit_ts_ + 1;
+    for (const auto &item : *write_set) {
+      item.table_->CommitVersion(item.rid_, txn, commit_ts);
+      version_garbage_.push_back({commit_ts, item.table_, item.rid_});
+    }
+    last_commit_ts_ = commit_ts;
+  }
+
+  // Perform all deletes before we commit.
   while (!write_set->empty()) {
     auto &item = write_set->back();
     auto table = item.table_;
@@ -52,16 +88,74 @@ void TransactionManager::Commit(Transaction *txn) {
   }
   write_set->clear();
 
+  // The commit is only durable once its record is on disk, the flush thread batches concurrent commits together.
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+    log_manager_->Flush(true);
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
+  EndSnapshot(txn);
+  // The owner deletes the transaction once we return, nobody may still be using it by then.
+  txn_registry.Unregister(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
+  return true;
+}
+
+bool TransactionManager::ValidateOptimistic(Transaction *txn) {
+  // Lock in rid order, so that optimistic transactions committing at the same time cannot deadlock each other.
+  auto buffered = txn->GetBufferedWriteSet();
+  std::vector<const TableWriteRecord *> writes;
+  writes.reserve(buffered->size());
+  for (const auto &[rid, write] : *buffered) {
+    writes.push_back(&write);
+  }
+  std::sort(writes.begin(), writes.end(),
+            [](const TableWriteRecord *a, const TableWriteRecord *b) { return a->rid_.Get() < b->rid_.Get(); });
+  try {
+    for (const auto *write : writes) {
+      if (!txn->IsExclusiveLocked(write->rid_)) {
+        lock_manager_->LockExclusive(txn, write->rid_);
+      }
+    }
+  } catch (TransactionAbortException &e) {
+    return false;
+  }
+
+  // Write the tuples before validating, an optimistic transaction validating at the same time sees them as written.
+  txn->SetState(TransactionState::SHRINKING);
+  for (const auto *write : writes) {
+    bool written = write->wtype_ == WType::DELETE ? write->table_->MarkDelete(write->rid_, txn)
+                                                  : write->table_->UpdateTuple(write->tuple_, write->rid_, txn);
+    if (!written) {
+      return false;
+    }
+  }
+  buffered->clear();
+
+  for (const auto &[rid, read] : *txn->GetReadSet()) {
+    if (!read.table_->ValidateRead(rid, txn, read.ts_)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
+  if (txn->IsReadOnly()) {
+    EndSnapshot(txn);
+    return;
+  }
   // Rollback before releasing the lock.
   auto table_write_set = txn->GetWriteSet();
+  std::vector<std::pair<TableHeap *, RID>> written;
+  for (const auto &item : *table_write_set) {
+    written.emplace_back(item.table_, item.rid_);
+  }
   while (!table_write_set->empty()) {
     auto &item = table_write_set->back();
     auto table = item.table_;
@@ -69,13 +163,25 @@ void TransactionManager::Abort(Transaction *txn) {
       table->RollbackDelete(item.rid_, txn);
     } else if (item.wtype_ == WType::INSERT) {
       // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+      table->RollbackInsert(item.rid_, txn);
     } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
+      if (item.delta_.empty()) {
+        table->UpdateTuple(item.tuple_, item.rid_, txn);
+      } else {
+        table->RollbackUpdate(item.delta_, item.rid_, txn);
+      }
     }
     table_write_set->pop_back();
   }
   table_write_set->clear();
+  // The heap holds the old tuples again, drop the versions that replaced them.
+  {
+    std::lock_guard<std::mutex> guard(ts_latch_);
+    for (const auto &[table, rid] : written) {
+      table->AbortVersion(rid, txn);
+      version_garbage_.push_back({last_commit_ts_, table, rid});
+    }
+  }
   // Rollback index updates
   auto index_write_set = txn->GetIndexWriteSet();
   while (!index_write_set->empty()) {
@@ -101,12 +207,38 @@ void TransactionManager::Abort(Transaction *txn) {
   }
   table_write_set->clear();
   index_write_set->clear();
+
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
   // Release all the locks.
   ReleaseLocks(txn);
+  EndSnapshot(txn);
+  // The owner deletes the transaction once we return, nobody may still be using it by then.
+  txn_registry.Unregister(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+void TransactionManager::BeginSnapshot(Transaction *txn) {
+  // The snapshot holds everything committed so far.
+  std::lock_guard<std::mutex> guard(ts_latch_);
+  txn->SetReadTs(last_commit_ts_);
+  active_read_ts_.insert(last_commit_ts_);
+}
+
+void TransactionManager::EndSnapshot(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(ts_latch_);
+  active_read_ts_.erase(active_read_ts_.find(txn->GetReadTs()));
+  timestamp_t watermark = active_read_ts_.empty() ? last_commit_ts_ : *active_read_ts_.begin();
+  while (!version_garbage_.empty() && version_garbage_.front().ts_ <= watermark) {
+    auto &garbage = version_garbage_.front();
+    garbage.table_->CollectVersion(garbage.rid_, watermark);
+    version_garbage_.pop_front();
+  }
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
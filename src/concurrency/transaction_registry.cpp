@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+void TransactionRegistry::Register(Transaction *txn) {
+  Shard &shard = ShardOf(txn->GetTransactionId());
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  shard.txns_[txn->GetTransactionId()] = txn;
+}
+
+void TransactionRegistry::Unregister(Transaction *txn) {
+  {
+    Shard &shard = ShardOf(txn->GetTransactionId());
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    // every transaction manager counts ids from 0, the id may have been taken over by another transaction since
+    auto it = shard.txns_.find(txn->GetTransactionId());
+    if (it != shard.txns_.end() && it->second == txn) {
+      shard.txns_.erase(it);
+    }
+  }
+  Synchronize();
+}
+
+Transaction *TransactionRegistry::Find(txn_id_t txn_id) {
+  Shard &shard = ShardOf(txn_id);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.txns_.find(txn_id);
+  return it == shard.txns_.end() ? nullptr : it->second;
+}
+
+size_t TransactionRegistry::Size() {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    size += shard.txns_.size();
+  }
+  return size;
+}
+
+uint64_t TransactionRegistry::Enter() {
+  while (true) {
+    uint64_t epoch = epoch_.load();
+    active_[epoch % 2]++;
+    // a flip in between may already be waiting on the other counter, enter the new epoch instead
+    if (epoch_.load() == epoch) {
+      return epoch;
+    }
+    active_[epoch % 2]--;
+  }
+}
+
+void TransactionRegistry::Exit(uint64_t epoch) { active_[epoch % 2]--; }
+
+void TransactionRegistry::Synchronize() {
+  // a guard entered after the caller's change cannot see the old state, and none held is the common case
+  if (active_[0] == 0 && active_[1] == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(sync_latch_);
+  // the guards of older epochs were waited for by the flips before, the held ones are all in the current epoch
+  uint64_t epoch = epoch_++;
+  while (active_[epoch % 2] != 0) {
+    std::this_thread::yield();
+  }
+}
+
+}  // namespace bustub
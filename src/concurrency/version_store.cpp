@@ -0,0 +1,159 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/concurrency/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/version_store.h"
+
+namespace bustub {
+
+VersionStore::Shard &VersionStore::ShardOf(const RID &rid) {
+  auto hash = std::hash<RID>()(rid);
+  return shards_[(hash ^ (hash >> 32)) % VERSION_STORE_SHARDS];
+}
+
+bool VersionStore::CanWrite(const RID &rid, Transaction *txn) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    return true;
+  }
+  const VersionChain &chain = it->second;
+  if (chain.writer_ != INVALID_TXN_ID) {
+    return chain.writer_ == txn->GetTransactionId();
+  }
+  return txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION || chain.ts_ <= txn->GetReadTs();
+}
+
+void VersionStore::RecordWrite(const RID &rid, Transaction *txn, const Tuple *before) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  VersionChain &chain = shard.chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    return;
+  }
+  chain.undo_.push_front({chain.ts_, before != nullptr, before != nullptr ? *before : Tuple{}});
+  chain.writer_ = txn->GetTransactionId();
+}
+
+void VersionStore::Commit(const RID &rid, Transaction *txn, timestamp_t commit_ts) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it != shard.chains_.end() && it->second.writer_ == txn->GetTransactionId()) {
+    it->second.writer_ = INVALID_TXN_ID;
+    it->second.ts_ = commit_ts;
+  }
+}
+
+void VersionStore::Abort(const RID &rid, Transaction *txn) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  VersionChain &chain = it->second;
+  chain.writer_ = INVALID_TXN_ID;
+  chain.ts_ = chain.undo_.front().ts_;
+  chain.undo_.pop_front();
+}
+
+bool VersionStore::Resolve(const RID &rid, Transaction *txn, bool heap_exists, Tuple *tuple) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  const VersionChain *chain = it == shard.chains_.end() ? nullptr : &it->second;
+  bool heap_visible = chain == nullptr || chain->writer_ == txn->GetTransactionId() ||
+                      (chain->writer_ == INVALID_TXN_ID && chain->ts_ <= txn->GetReadTs());
+  if (heap_visible) {
+    return heap_exists;
+  }
+  for (const auto &version : chain->undo_) {
+    if (version.ts_ <= txn->GetReadTs()) {
+      if (!version.exists_) {
+        return false;
+      }
+      *tuple = version.tuple_;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool VersionStore::ReadLatest(const RID &rid, Transaction *txn, bool heap_exists, Tuple *tuple, timestamp_t *ts) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    *ts = 0;
+    return heap_exists;
+  }
+  // while the transaction is the writer, ts_ still is the timestamp of the version it replaced
+  const VersionChain &chain = it->second;
+  *ts = chain.ts_;
+  if (chain.writer_ == INVALID_TXN_ID || chain.writer_ == txn->GetTransactionId()) {
+    return heap_exists;
+  }
+  const Version &version = chain.undo_.front();
+  if (!version.exists_) {
+    return false;
+  }
+  *tuple = version.tuple_;
+  return true;
+}
+
+bool VersionStore::Validate(const RID &rid, Transaction *txn, timestamp_t ts) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    // a chain is only collected once every running transaction began after its last commit
+    return ts <= txn->GetReadTs();
+  }
+  const VersionChain &chain = it->second;
+  if (chain.writer_ != INVALID_TXN_ID && chain.writer_ != txn->GetTransactionId()) {
+    return false;
+  }
+  return chain.ts_ == ts;
+}
+
+void VersionStore::Collect(const RID &rid, timestamp_t watermark) {
+  Shard &shard = ShardOf(rid);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end() || it->second.writer_ != INVALID_TXN_ID) {
+    return;
+  }
+  VersionChain &chain = it->second;
+  if (chain.ts_ <= watermark) {
+    shard.chains_.erase(it);
+    return;
+  }
+  // keep the newest version every snapshot since the watermark can see, older ones are unreachable
+  for (auto version = chain.undo_.begin(); version != chain.undo_.end(); ++version) {
+    if (version->ts_ <= watermark) {
+      chain.undo_.erase(version + 1, chain.undo_.end());
+      return;
+    }
+  }
+}
+
+size_t VersionStore::Size() {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    size += shard.chains_.size();
+  }
+  return size;
+}
+
+}  // namespace bustub
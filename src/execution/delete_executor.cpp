@@ -27,6 +27,8 @@ void DeleteExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  exec_ctx_->GetLockManager()->LockTable(exec_ctx_->GetTransaction(), LockManager::LockMode::INTENTION_EXCLUSIVE,
+                                         plan_->TableOid());
 }
 
 bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) { 
@@ -36,7 +38,7 @@ bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   auto lock_ma = exec_ctx_->GetLockManager();
   while (child_executor_->Next(tuple, rid)) {
     if (table_info->table_->MarkDelete(*rid, exec_ctx_->GetTransaction())) {
-      lock_ma->Lock(txn, *rid, false);
+      lock_ma->Lock(txn, plan_->TableOid(), *rid, false);
       for (auto& index : index_infos) {
         IndexWriteRecord iwr(*rid, plan_->TableOid(), WType::DELETE, *tuple, index->index_oid_, exec_ctx_->GetCatalog());
         txn->AppendTableWriteRecord(std::move(iwr));
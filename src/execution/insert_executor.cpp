@@ -27,6 +27,8 @@ void InsertExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  exec_ctx_->GetLockManager()->LockTable(exec_ctx_->GetTransaction(), LockManager::LockMode::INTENTION_EXCLUSIVE,
+                                         plan_->TableOid());
 }
 
 bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
@@ -40,7 +42,7 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
     for(auto& row : rows) {
       *tuple = Tuple(row, schema);
       if (table_info->table_->InsertTuple(*tuple, rid, GetExecutorContext()->GetTransaction())) {
-        lock_ma->Lock(txn, *rid, false);
+        lock_ma->Lock(txn, plan_->TableOid(), *rid, false);
         for (auto index : index_infos) {
           IndexWriteRecord iwr(*rid, plan_->TableOid(), WType::INSERT, *tuple, index->index_oid_, exec_ctx_->GetCatalog());
           txn->AppendTableWriteRecord(std::move(iwr));
@@ -51,7 +53,7 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   } else {
     while(child_executor_->Next(tuple, rid)) {
       if (table_info->table_->InsertTuple(*tuple, rid, GetExecutorContext()->GetTransaction())) {
-        lock_ma->Lock(txn, *rid, false);
+        lock_ma->Lock(txn, plan_->TableOid(), *rid, false);
         for (auto index : index_infos) {
           IndexWriteRecord iwr(*rid, plan_->TableOid(), WType::INSERT, *tuple, index->index_oid_, exec_ctx_->GetCatalog());
           txn->AppendTableWriteRecord(std::move(iwr));
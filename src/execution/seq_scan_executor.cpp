@@ -27,10 +27,15 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
   auto out_schema = GetOutputSchema();
   auto table_schema = &exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid())->schema_;
   auto lock_ma = exec_ctx_->GetLockManager();
+  auto txn = exec_ctx_->GetTransaction();
   while (table_iter_ != table_iter_end_) {
-    lock_ma->Lock(exec_ctx_->GetTransaction(), table_iter_->GetRid());
+    // IS on the table and S on the row; a long scan has its row locks escalated to a table lock
+    lock_ma->Lock(txn, plan_->GetTableOid(), table_iter_->GetRid());
     auto cur_tuple = *table_iter_;
     ++table_iter_;
+    if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+      lock_ma->UnlockRead(txn, cur_tuple.GetRid());
+    }
     auto predicate = plan_->GetPredicate();
     if (predicate == nullptr || predicate->Evaluate(&cur_tuple, table_schema).GetAs<bool>()) {
       auto& cols = out_schema->GetColumns();
@@ -28,6 +28,8 @@ void UpdateExecutor::Init() {
   if (child_executor_ != nullptr) {
     child_executor_->Init();
   }
+  exec_ctx_->GetLockManager()->LockTable(exec_ctx_->GetTransaction(), LockManager::LockMode::INTENTION_EXCLUSIVE,
+                                         plan_->TableOid());
 }
 
 bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
@@ -41,7 +43,7 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   while(child_executor_->Next(tuple, rid)) {
     auto update_tuple = GenerateUpdatedTuple(*tuple);
     if (table_info->table_->UpdateTuple(update_tuple, *rid, GetExecutorContext()->GetTransaction())) {
-      lock_ma->Lock(txn, *rid, false);
+      lock_ma->Lock(txn, plan_->TableOid(), *rid, false);
       for(auto& index : index_infos) {
         IndexWriteRecord iwr(*rid, plan_->TableOid(), WType::UPDATE, *tuple, index->index_oid_, exec_ctx_->GetCatalog());
         txn->AppendTableWriteRecord(std::move(iwr));
@@ -87,6 +87,20 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /**
+   * Collects the dirty page table for a checkpoint. Pinned pages are included as well since they may be in the middle
+   * of an update that has already been logged.
+   * @param[out] dirty_page_table each dirty page with its recovery LSN
+   */
+  virtual void GetDirtyPageTable(std::unordered_map<page_id_t, lsn_t> *dirty_page_table) = 0;
+
+  /**
+   * Pins a page only if it is already in the buffer pool, so that background writers never pull pages in from disk.
+   * @param page_id id of page to be fetched
+   * @return the pinned page, or nullptr if the page is not resident
+   */
+  virtual Page *FetchPageIfResident(page_id_t page_id) = 0;
+
  protected:
   /**
    * Grading function. Do not modify!
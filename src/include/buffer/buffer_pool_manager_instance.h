@@ -60,6 +60,10 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
+  void GetDirtyPageTable(std::unordered_map<page_id_t, lsn_t> *dirty_page_table) override;
+
+  Page *FetchPageIfResident(page_id_t page_id) override;
+
  protected:
   /**
    * Fetch the requested page from the buffer pool.
@@ -126,6 +130,18 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   // init page
   void ResetPage(Page *page);
 
+  /** Pin a frame that is already in the page table. Must be called with latch_ held. */
+  Page *PinFrame(frame_id_t frame_id);
+
+  /**
+   * Write a page back to disk, forcing the log first if it holds updates that are not durable yet (WAL rule).
+   * Must be called with latch_ held.
+   */
+  void WritePageToDisk(Page *page);
+
+  /** @return the LSN the next update will get at the earliest, used as the recovery LSN of pages becoming dirty */
+  lsn_t CurrentLSN() const { return log_manager_ == nullptr ? INVALID_LSN : log_manager_->GetNextLSN(); }
+
   void Print() {
     using std::cout;
     using std::endl;
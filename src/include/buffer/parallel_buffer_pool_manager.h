@@ -42,6 +42,10 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  void GetDirtyPageTable(std::unordered_map<page_id_t, lsn_t> *dirty_page_table) override;
+
+  Page *FetchPageIfResident(page_id_t page_id) override;
+
  protected:
   /**
    * @param page_id id of page
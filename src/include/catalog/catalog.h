@@ -186,17 +186,24 @@ class Catalog {
    * @param key_attrs Key attributes
    * @param keysize Size of the key
    * @param hash_function The hash function for the index
-   * @return A (non-owning) pointer to the metadata of the new table
+   * @param is_unique Whether the key identifies at most one tuple, a non-unique index returns all tuples of a key
+   * @return A (non-owning) pointer to the metadata of the new table, NULL_INDEX_INFO if the key is too small to hold
+   * the longest values of the key columns, and the rid of a non-unique key
    */
   template <class KeyType, class ValueType, class KeyComparator>
   IndexInfo *CreateIndex(Transaction *txn, const std::string &index_name, const std::string &table_name,
                          const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs,
-                         std::size_t keysize, HashFunction<KeyType> hash_function) {
+                         std::size_t keysize, HashFunction<KeyType> hash_function, bool is_unique = true) {
     // Reject the creation request for nonexistent table
     if (table_names_.find(table_name) == table_names_.end()) {
       return NULL_INDEX_INFO;
     }
 
+    // Reject a key too small for its columns, and the rid of a non-unique key; distinct keys would compare equal
+    if (!KeyType::ColumnsFit(&key_schema, !is_unique)) {
+      return NULL_INDEX_INFO;
+    }
+
     // If the table exists, an entry for the table should already be present in index_names_
     BUSTUB_ASSERT((index_names_.find(table_name) != index_names_.end()), "Broken Invariant");
 
@@ -208,20 +215,24 @@ class Catalog {
     }
 
     // Construct index metdata
-    auto meta = std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
+    auto meta = std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs, is_unique);
 
     // Construct the index, take ownership of metadata
     // TODO(Kyle): We should update the API for CreateIndex
     // to allow specification of the index type itself, not
     // just the key, value, and comparator types
-    auto index = std::make_unique<BPlusTreeIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_);
+    auto index =
+        std::make_unique<BPlusTreeIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_, log_manager_);
 
-    // Populate the index with all tuples in table heap
+    // Populate the index with all tuples in table heap, sorted and built bottom-up rather than inserted one by one
     auto *table_meta = GetTable(table_name);
     auto *heap = table_meta->table_.get();
+    std::vector<std::pair<KeyType, ValueType>> entries;
     for (auto tuple = heap->Begin(txn); tuple != heap->End(); ++tuple) {
-      index->InsertEntry(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid(), txn);
+      entries.emplace_back(index->IndexKey(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid()),
+                           tuple->GetRid());
     }
+    index->BulkLoad(&entries, txn);
 
     // Get the next OID for the new index
     const auto index_oid = next_index_oid_.fetch_add(1);
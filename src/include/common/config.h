@@ -27,6 +27,9 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** A fuzzy checkpoint writes back one dirty page every CHECKPOINT_FLUSH_INTERVAL to throttle its I/O. */
+extern std::chrono::microseconds checkpoint_flush_interval;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
@@ -34,12 +37,20 @@ static constexpr int HEADER_PAGE_ID = 0;                                      //
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_SEGMENT_SIZE = 16 * LOG_BUFFER_SIZE;                 // size of a log segment file in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LOCK_TABLE_SHARDS = 64;                                  // independently latched lock table parts
+static constexpr size_t LOCK_ESCALATION_THRESHOLD = 1000;                     // row locks per table before escalation
+static constexpr int VERSION_STORE_SHARDS = 16;                               // independently latched version parts
+static constexpr int TXN_REGISTRY_SHARDS = 16;                                // independently latched registry parts
+static constexpr double BULK_LOAD_FILL_FACTOR = 0.9;                          // share of a page filled by bulk loads
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
+using log_offset_t = int64_t;  // logical log offset type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
@@ -12,25 +12,38 @@
 
 #pragma once
 
-#include <climits>
-#include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <atomic>
+#include <cstdint>
 
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.
+ * Reader-Writer latch packed into one atomic word.
+ *
+ * Readers take the latch with a single compare-and-swap on the word, so they do not serialize on a mutex. A waiting
+ * writer blocks new readers, as writers are preferred. A thread that cannot take the latch spins briefly, then parks
+ * on the word (a futex on Linux) until the holder releases it.
+ *
+ * There is no optimistic, version-validated read mode. B+tree readers already hold one page latch at a time, and
+ * descending without the latch would decode prefix-compressed internal pages while a writer may be rewriting them,
+ * which can run a key copy past its buffer before the version check catches the change.
  */
 class ReaderWriterLatch {
-  using mutex_t = std::mutex;
-  using cond_t = std::condition_variable;
-  static const uint32_t MAX_READERS = UINT_MAX;
+  /** A writer holds the latch. */
+  static constexpr uint32_t WRITER = 1U << 31;
+  /** A writer waits for the readers to leave, no new reader may enter. */
+  static constexpr uint32_t WRITER_WAITING = 1U << 30;
+  /** Some thread is parked on the word and has to be woken up on release. */
+  static constexpr uint32_t PARKED = 1U << 29;
+  static constexpr uint32_t MAX_READERS = PARKED - 1;
+  /** Attempts before a thread parks; a latch is held for a few hundred instructions at most. */
+  static constexpr int SPIN_LIMIT = 64;
 
  public:
   ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  ~ReaderWriterLatch() = default;
 
   DISALLOW_COPY(ReaderWriterLatch);
 
@@ -38,13 +51,9 @@ class ReaderWriterLatch {
    * Acquire a write latch.
    */
   void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {
-      reader_.wait(latch);
-    }
-    writer_entered_ = true;
-    while (reader_count_ > 0) {
-      writer_.wait(latch);
+    uint32_t state = 0;
+    if (!state_.compare_exchange_strong(state, WRITER, std::memory_order_acquire)) {
+      WLockSlow();
     }
   }
 
@@ -52,45 +61,44 @@ class ReaderWriterLatch {
    * Release a write latch.
    */
   void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+    if ((state_.fetch_and(~(WRITER | PARKED), std::memory_order_release) & PARKED) != 0) {
+      Wake();
+    }
   }
 
   /**
    * Acquire a read latch.
    */
   void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & (WRITER | WRITER_WAITING | PARKED)) != 0 || (state & MAX_READERS) == MAX_READERS ||
+        !state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+      RLockSlow();
     }
-    reader_count_++;
   }
 
   /**
    * Release a read latch.
    */
   void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0) {
-        writer_.notify_one();
-      }
-    } else {
-      if (reader_count_ == MAX_READERS - 1) {
-        reader_.notify_one();
-      }
+    uint32_t state = state_.fetch_sub(1, std::memory_order_release);
+    // only a writer waits for the readers to leave
+    if ((state & MAX_READERS) == 1 && (state & PARKED) != 0) {
+      state_.fetch_and(~PARKED, std::memory_order_relaxed);
+      Wake();
     }
   }
 
  private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_{0};
-  bool writer_entered_{false};
+  void WLockSlow();
+  void RLockSlow();
+
+  /** Sleep until the word no longer holds state, or a spurious wakeup. */
+  void Park(uint32_t state);
+  /** Wake up every thread parked on the word. */
+  void Wake();
+
+  std::atomic<uint32_t> state_{0};
 };
 
 }  // namespace bustub
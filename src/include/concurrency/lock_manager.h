@@ -13,15 +13,20 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
-#include <list>
+#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <set>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "common/config.h"
+#include "common/macros.h"
 #include "common/rid.h"
 #include "concurrency/transaction.h"
 
@@ -30,11 +35,32 @@ namespace bustub {
 class TransactionManager;
 
 /**
- * LockManager handles transactions asking for locks on records.
+ * How deadlocks are dealt with. PREVENTION wounds younger transactions in the way of an older one as soon as it asks
+ * for a lock (wound-wait). DETECTION lets transactions wait and has a background thread break the cycles of the
+ * waits-for graph every cycle_detection_interval, aborting the youngest transaction of each cycle.
+ */
+enum class DeadlockMode { PREVENTION, DETECTION };
+
+/**
+ * LockManager handles transactions asking for locks on tables and records.
+ *
+ * Locks are taken on two levels. A transaction announces what it is going to do to the rows of a table with an
+ * intention lock on the table, or locks the table as a whole in shared or exclusive mode, which then covers its rows:
+ *
+ *             IS    IX    S     SIX   X
+ *     IS      yes   yes   yes   yes   no
+ *     IX      yes   yes   no    no    no
+ *     S       yes   no    yes   no    no
+ *     SIX     yes   no    no    no    no
+ *     X       no    no    no    no    no
+ *
+ * Rows are only locked in shared or exclusive mode.
  */
 class LockManager {
-  enum class LockMode { SHARED, EXCLUSIVE };
+ public:
+  enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
 
+ private:
   class LockRequest {
    public:
     LockRequest(txn_id_t txn_id, LockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
@@ -42,35 +68,105 @@ class LockManager {
     txn_id_t txn_id_;
     LockMode lock_mode_;
     bool granted_;
+    // the transaction waiting for this request sleeps here, it is woken when the request is granted or wounded
+    std::condition_variable cv_;
+    // neighbours in the queue, towards the oldest request and towards the newest
+    LockRequest *prev_{nullptr};
+    LockRequest *next_{nullptr};
   };
 
+  /**
+   * Requests on one rid or table in arrival order, linked through the requests themselves. A release grants the
+   * requests at the head that are compatible with everything before them, and wakes only those.
+   */
   class LockRequestQueue {
    public:
-    std::list<LockRequest> request_queue_;
-    // for notifying blocked transactions on this rid
-    std::condition_variable cv_;
+    /** @return the request of a transaction, nullptr if it has none in this queue */
+    LockRequest *Find(txn_id_t txn_id);
+    /** Add a request behind all others. */
+    LockRequest *Append(txn_id_t txn_id, LockMode lock_mode);
+    /** Add a request right behind the granted ones, so that it is the next to be granted. */
+    LockRequest *InsertAfterGranted(txn_id_t txn_id, LockMode lock_mode);
+    /** Drop a request from the queue. */
+    void Remove(LockRequest *request);
+    /** Grant the requests at the head that are compatible with the granted ones, and wake their waiters. */
+    void Grant();
+    /**
+     * @return whether a request of the transaction would be granted without waiting, an upgrade going ahead of the
+     * waiting requests
+     */
+    bool GrantableNow(txn_id_t txn_id, LockMode lock_mode, bool is_upgrade) const;
+    bool Empty() const { return head_ == nullptr; }
+    LockRequest *Head() const { return head_; }
+
     // txn_id of an upgrading transaction (if any)
     txn_id_t upgrading_ = INVALID_TXN_ID;
-    
+    // number of QueueHandles on this queue, guarded by the shard latch
+    size_t users_ = 0;
+
     std::mutex mutex;
 
-    std::list<LockRequest>::iterator GetIterByTxnId(txn_id_t txn_id) {
-      for (auto iter = request_queue_.begin(); iter != request_queue_.end(); ++iter) {
-        if (iter->txn_id_ == txn_id) {
-          return iter;
-        }
+   private:
+    void Link(LockRequest *request, LockRequest *next);
+
+    // oldest and newest request
+    LockRequest *head_{nullptr};
+    LockRequest *tail_{nullptr};
+    // owns the requests and finds them by transaction
+    std::unordered_map<txn_id_t, std::unique_ptr<LockRequest>> requests_;
+  };
+
+  /** One partition of the lock table. Its latch only guards finding, creating and dropping queues. */
+  template <typename K>
+  struct LockTableShard {
+    std::mutex latch_;
+    std::unordered_map<K, LockRequestQueue> lock_table_;
+  };
+
+  /**
+   * Keeps the request queue of a rid or table alive while in scope. Queues are created on first use and dropped by
+   * the last handle once they are empty, so no global latch is needed to keep a queue from being freed under its users.
+   */
+  template <typename K>
+  class QueueHandle {
+   public:
+    QueueHandle(LockTableShard<K> *shard, const K &key) : shard_(shard), key_(key) {
+      std::lock_guard<std::mutex> guard(shard_->latch_);
+      queue_ = &shard_->lock_table_[key];
+      queue_->users_++;
+    }
+
+    ~QueueHandle() {
+      std::lock_guard<std::mutex> guard(shard_->latch_);
+      // without other users nobody can be touching the queue, so it is safe to look at it without its mutex
+      if (--queue_->users_ == 0 && queue_->Empty()) {
+        shard_->lock_table_.erase(key_);
       }
-      throw Exception("should unreach");
     }
+
+    DISALLOW_COPY_AND_MOVE(QueueHandle);
+
+    LockRequestQueue &Queue() { return *queue_; }
+
+   private:
+    LockTableShard<K> *shard_;
+    K key_;
+    LockRequestQueue *queue_;
   };
 
  public:
   /**
-   * Creates a new lock manager configured for the deadlock prevention policy.
+   * Creates a new lock manager configured for the given deadlock policy.
+   * @param deadlock_mode whether deadlocks are prevented or detected
+   * @param escalation_threshold number of row locks a transaction may take through Lock() on one table before they are
+   * escalated to a table lock, 0 to never escalate
    */
-  LockManager() = default;
+  explicit LockManager(DeadlockMode deadlock_mode = DeadlockMode::PREVENTION,
+                       size_t escalation_threshold = LOCK_ESCALATION_THRESHOLD);
+
+  ~LockManager();
 
-  ~LockManager() = default;
+  DISALLOW_COPY_AND_MOVE(LockManager);
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -115,34 +211,153 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
-  bool Lock(Transaction* txn, RID rid, bool is_read = true) {
-    if (!is_read) {
-      if (txn->GetExclusiveLockSet()->count(rid)) {
-        return true;
-      }
-      if (txn->GetSharedLockSet()->count(rid)) {
-        return LockUpgrade(txn, rid);
-      }
-      return LockExclusive(txn, rid);
-    }
+  /**
+   * Acquire a lock on a table. A transaction holds at most one lock per table: asking for a mode that the held one
+   * does not cover upgrades it to the weakest mode covering both, e.g. S and IX to SIX. See [LOCK_NOTE].
+   * @param txn the transaction requesting the lock
+   * @param lock_mode the mode to lock the table in
+   * @param oid the table to lock
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid);
 
-    if (txn->GetSharedLockSet()->count(rid)) {
-        return true;
-    }
+  /**
+   * Release the table lock held by the transaction. Its row locks on the table should be released first.
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
 
-    if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED) {
-      return true;
-    }
+  /**
+   * Look up the mode a transaction holds a table in.
+   * @return false if the transaction does not hold a lock on the table
+   */
+  static bool HeldTableLockMode(Transaction *txn, table_oid_t oid, LockMode *lock_mode);
 
-    return LockShared(txn, rid);
-  }
+  /**
+   * Lock a row of a table for reading or writing. The matching intention lock is taken on the table first, and no
+   * row lock is taken when the table lock already covers the row. Once the transaction holds the escalation threshold
+   * of row locks on the table, they are traded for a table lock if that can be granted right away.
+   */
+  bool Lock(Transaction *txn, table_oid_t oid, RID rid, bool is_read = true);
+
+  /**
+   * Drop the shared lock on a row once it has been read, as READ_COMMITTED reads do, without leaving the growing
+   * phase. An exclusive lock on the row is kept.
+   */
+  void UnlockRead(Transaction *txn, const RID &rid);
+
+  /*** Graph API ***/
+  /** Adds an edge from t1 -> t2, t1 waits for a lock t2 holds or asked for earlier. */
+  void AddEdge(txn_id_t t1, txn_id_t t2);
+
+  /** Removes an edge from t1 -> t2. */
+  void RemoveEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Checks if the graph has a cycle, searching from the oldest transaction and visiting older neighbours first.
+   * @param[out] txn_id if the graph has a cycle, the youngest transaction in it
+   * @return true if the graph has a cycle, false otherwise
+   */
+  bool HasCycle(txn_id_t *txn_id);
+
+  /** @return the list of all edges in the graph */
+  std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
+
+  /**
+   * Abort the youngest transaction of each cycle in the graph. The graph may be out of date, a victim is only aborted
+   * if it still waits for a lock and has not finished.
+   * @return false if a victim no longer waits, the graph has to be rebuilt then
+   */
+  bool BreakCycles();
+
+  /** Runs cycle detection in the background until the lock manager is destroyed, in DETECTION mode. */
+  void RunCycleDetection();
 
  private:
-  std::mutex latch_;
+  /** Add the waits-for edges of the queues in a lock table shard. */
+  template <typename K>
+  void BuildGraph(LockTableShard<K> *shard);
+
+  /**
+   * Wake the waiting request of a transaction on a row or table, which then leaves the queue if it is aborted.
+   * @param abort whether to abort the transaction first, which only happens while it is growing and still waiting
+   * @return false if the transaction no longer waits there, or is not aborted
+   */
+  template <typename K>
+  bool WakeWaiter(LockTableShard<K> *shard, const K &key, txn_id_t txn_id, bool abort);
+
+  /** Depth first search for a cycle through txn_id, the transactions on the current path are in path. */
+  bool FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::set<txn_id_t> *visited, txn_id_t *victim);
+
+  /** @return the shard of the row lock table that holds the queue of a rid */
+  LockTableShard<RID> *ShardOf(const RID &rid);
+
+  /**
+   * Acquire a table lock, see LockTable().
+   * @param wait false to give up instead of waiting when the lock cannot be granted right away; nobody is wounded then
+   * @return false if the lock was given up on
+   */
+  bool AcquireTable(Transaction *txn, LockMode lock_mode, table_oid_t oid, bool wait);
+
+  /**
+   * Trade the row locks of a transaction on a table for a table lock, keeping the rows the table lock does not cover.
+   * Nothing changes if the table lock would have to wait.
+   */
+  void Escalate(Transaction *txn, table_oid_t oid);
+
+  /**
+   * Drop a row lock without leaving the growing phase.
+   * @return false if the transaction does not hold the lock
+   */
+  bool ReleaseRow(Transaction *txn, const RID &rid);
+
+  /**
+   * Wound the younger transactions in the queue whose requests conflict with a request in the given mode. Nobody is
+   * wounded in DETECTION mode.
+   * @param[out] wounded the wounded transactions that may be waiting on another queue, to be woken by WaitForGrant()
+   */
+  void WoundYounger(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode, std::vector<txn_id_t> *wounded);
+
+  /**
+   * Abort a younger transaction whose request is in the way, waking it if it is waiting on this queue and adding it
+   * to wounded otherwise.
+   */
+  void Wound(LockRequest *request, std::vector<txn_id_t> *wounded);
+
+  /** Record the row or table a transaction is about to wait on, so that an abort can find and wake it. */
+  void MarkWaiting(txn_id_t txn_id, const RID &rid);
+  void MarkWaiting(txn_id_t txn_id, table_oid_t oid);
+  void ClearWaiting(txn_id_t txn_id);
+
+  /** Wake a transaction if it is waiting for a lock, as WakeWaiter() does. No queue mutex may be held. */
+  bool WakeWaiting(txn_id_t txn_id, bool abort = false);
+
+  /**
+   * Wake the wounded transactions, then sleep until the request on the row or table key is granted or its
+   * transaction is aborted.
+   * @return false if the transaction was aborted, its request is then removed from the queue
+   */
+  template <typename K>
+  bool WaitForGrant(Transaction *txn, const K &key, LockRequestQueue *queue, LockRequest *request,
+                    std::unique_lock<std::mutex> *lock, const std::vector<txn_id_t> &wounded);
+
+  DeadlockMode deadlock_mode_;
+  /** Row locks per table and transaction after which Lock() escalates to a table lock, 0 if it never does. */
+  size_t escalation_threshold_;
+  /** Lock table for row lock requests, partitioned by rid hash. */
+  std::array<LockTableShard<RID>, LOCK_TABLE_SHARDS> shards_;
+  /** Lock table for table lock requests. There are few tables, so one partition does. */
+  LockTableShard<table_oid_t> table_locks_;
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
+  /** The row or table each waiting transaction waits on. */
+  std::mutex waiting_latch_;
+  std::unordered_map<txn_id_t, RID> waiting_rows_;
+  std::unordered_map<txn_id_t, table_oid_t> waiting_tables_;
 
+  std::atomic<bool> enable_cycle_detection_{false};
+  std::thread *cycle_detection_thread_{nullptr};
+  /** Waits-for graph, only used by the thread running cycle detection. Ordered so that the search is deterministic. */
+  std::map<txn_id_t, std::set<txn_id_t>> waits_for_;
 };
 
 }  // namespace bustub
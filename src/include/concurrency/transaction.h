@@ -17,7 +17,9 @@
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
@@ -44,9 +46,17 @@ namespace bustub {
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
- * Transaction isolation level.
+ * Transaction isolation level. SNAPSHOT_ISOLATION reads the versions committed before the transaction began without
+ * taking any read locks; its writes are locked like the others and abort on a version committed after the snapshot.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION };
+
+/**
+ * How a transaction is kept apart from the others. An OPTIMISTIC transaction takes no locks while it runs: it reads the
+ * latest committed versions, remembers which ones, and buffers its updates and deletes. At commit it locks and writes
+ * the buffered tuples, and aborts if any tuple it read has changed since.
+ */
+enum class ConcurrencyControl { TWO_PHASE_LOCKING, OPTIMISTIC };
 
 /**
  * Type of write operation.
@@ -70,10 +80,25 @@ class TableWriteRecord {
   WType wtype_;
   /** The tuple is only used for the update operation. */
   Tuple tuple_;
+  /** Changed byte ranges of an update that kept the tuple length, which then leaves the tuple empty. */
+  std::vector<char> delta_;
   /** The table heap specifies which table this write record is for. */
   TableHeap *table_;
 };
 
+/**
+ * ReadRecord tracks the version an optimistic transaction read, to be validated at commit.
+ */
+class TableReadRecord {
+ public:
+  TableReadRecord(TableHeap *table, timestamp_t ts) : table_(table), ts_(ts) {}
+
+  /** The table heap specifies which table this read record is for. */
+  TableHeap *table_;
+  /** Commit timestamp of the version that was read. */
+  timestamp_t ts_;
+};
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -107,7 +132,8 @@ enum class AbortReason {
   UNLOCK_ON_SHRINKING,
   UPGRADE_CONFLICT,
   DEADLOCK,
-  LOCKSHARED_ON_READ_UNCOMMITTED
+  LOCKSHARED_ON_READ_UNCOMMITTED,
+  LOCK_ON_READ_ONLY
 };
 
 /**
@@ -137,6 +163,8 @@ class TransactionAbortException : public std::exception {
         return "Transaction " + std::to_string(txn_id_) + " aborted on deadlock\n";
       case AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED:
         return "Transaction " + std::to_string(txn_id_) + " aborted on lockshared on READ_UNCOMMITTED\n";
+      case AbortReason::LOCK_ON_READ_ONLY:
+        return "Transaction " + std::to_string(txn_id_) + " aborted because a read-only transaction can not lock\n";
     }
     // Todo: Should fail with unreachable.
     return "";
@@ -148,19 +176,36 @@ class TransactionAbortException : public std::exception {
  */
 class Transaction {
  public:
-  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
+  /**
+   * @param read_only a read-only transaction must read a snapshot; it never writes or locks, so it gets no write and
+   * lock sets
+   */
+  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                       bool read_only = false)
       : state_(TransactionState::GROWING),
         isolation_level_(isolation_level),
+        read_only_(read_only),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
-        prev_lsn_(INVALID_LSN),
-        shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        prev_lsn_(INVALID_LSN) {
+    if (read_only) {
+      return;
+    }
     // Initialize the sets that will be tracked.
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
+    table_read_set_ = std::make_shared<std::unordered_map<RID, TableReadRecord>>();
+    buffered_write_set_ = std::make_shared<std::unordered_map<RID, TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    shared_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    exclusive_lock_set_ = std::make_shared<std::unordered_set<RID>>();
+    shared_table_lock_set_ = std::make_shared<std::unordered_set<table_oid_t>>();
+    exclusive_table_lock_set_ = std::make_shared<std::unordered_set<table_oid_t>>();
+    intention_shared_table_lock_set_ = std::make_shared<std::unordered_set<table_oid_t>>();
+    intention_exclusive_table_lock_set_ = std::make_shared<std::unordered_set<table_oid_t>>();
+    shared_intention_exclusive_table_lock_set_ = std::make_shared<std::unordered_set<table_oid_t>>();
+    table_row_lock_set_ = std::make_shared<std::unordered_map<table_oid_t, std::unordered_set<RID>>>();
   }
 
   ~Transaction() = default;
@@ -176,9 +221,39 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
 
+  /** @return how this transaction is kept apart from the others */
+  inline ConcurrencyControl GetConcurrencyControl() const { return concurrency_control_; }
+
+  /**
+   * Set how this transaction is kept apart from the others, done by the transaction manager when it begins.
+   * @param concurrency_control locking or optimistic
+   */
+  inline void SetConcurrencyControl(ConcurrencyControl concurrency_control) {
+    concurrency_control_ = concurrency_control;
+  }
+
+  /** @return true if this transaction was declared read-only when it began */
+  inline bool IsReadOnly() const { return read_only_; }
+
+  /** @return true if this transaction is optimistic */
+  inline bool IsOptimistic() const { return concurrency_control_ == ConcurrencyControl::OPTIMISTIC; }
+
+  /** @return true if this transaction reads committed versions instead of locking the tuples it reads */
+  inline bool ReadsVersions() const {
+    return isolation_level_ == IsolationLevel::SNAPSHOT_ISOLATION || IsOptimistic();
+  }
+
   /** @return the list of table write records of this transaction */
   inline std::shared_ptr<std::deque<TableWriteRecord>> GetWriteSet() { return table_write_set_; }
 
+  /** @return the versions read by this optimistic transaction, by tuple */
+  inline std::shared_ptr<std::unordered_map<RID, TableReadRecord>> GetReadSet() { return table_read_set_; }
+
+  /** @return the updates and deletes this optimistic transaction has not written to the table heap yet, by tuple */
+  inline std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> GetBufferedWriteSet() {
+    return buffered_write_set_;
+  }
+
   /** @return the list of index write records of this transaction */
   inline std::shared_ptr<std::deque<IndexWriteRecord>> GetIndexWriteSet() { return index_write_set_; }
 
@@ -228,6 +303,34 @@ class Transaction {
   /** @return true if rid is exclusively locked by this transaction */
   bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end(); }
 
+  /** @return the set of tables under a shared lock */
+  inline std::shared_ptr<std::unordered_set<table_oid_t>> GetSharedTableLockSet() { return shared_table_lock_set_; }
+
+  /** @return the set of tables under an exclusive lock */
+  inline std::shared_ptr<std::unordered_set<table_oid_t>> GetExclusiveTableLockSet() {
+    return exclusive_table_lock_set_;
+  }
+
+  /** @return the set of tables under an intention shared lock */
+  inline std::shared_ptr<std::unordered_set<table_oid_t>> GetIntentionSharedTableLockSet() {
+    return intention_shared_table_lock_set_;
+  }
+
+  /** @return the set of tables under an intention exclusive lock */
+  inline std::shared_ptr<std::unordered_set<table_oid_t>> GetIntentionExclusiveTableLockSet() {
+    return intention_exclusive_table_lock_set_;
+  }
+
+  /** @return the set of tables under a shared intention exclusive lock */
+  inline std::shared_ptr<std::unordered_set<table_oid_t>> GetSharedIntentionExclusiveTableLockSet() {
+    return shared_intention_exclusive_table_lock_set_;
+  }
+
+  /** @return the row locks taken through a table lock, by table */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> GetTableRowLockSet() {
+    return table_row_lock_set_;
+  }
+
   /** @return the current state of the transaction */
   inline TransactionState GetState() { return state_; }
 
@@ -237,6 +340,15 @@ class Transaction {
    */
   inline void SetState(TransactionState state) { state_ = state; }
 
+  /** @return the timestamp of the snapshot the transaction reads */
+  inline timestamp_t GetReadTs() const { return read_ts_; }
+
+  /**
+   * Set the snapshot timestamp, done by the transaction manager when the transaction begins.
+   * @param read_ts commit timestamp of the last transaction the snapshot includes
+   */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
   /** @return the previous LSN */
   inline lsn_t GetPrevLSN() { return prev_lsn_; }
 
@@ -251,6 +363,10 @@ class Transaction {
   TransactionState state_;
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
+  /** Locking or optimistic. */
+  ConcurrencyControl concurrency_control_{ConcurrencyControl::TWO_PHASE_LOCKING};
+  /** A read-only transaction has no write and lock sets. */
+  bool read_only_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
@@ -258,10 +374,16 @@ class Transaction {
 
   /** The undo set of table tuples. */
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
+  /** Optimistic: the versions read, validated at commit. */
+  std::shared_ptr<std::unordered_map<RID, TableReadRecord>> table_read_set_;
+  /** Optimistic: the updates and deletes written to the table heap at commit. */
+  std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> buffered_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** Snapshot timestamp, the commits up to it are visible to snapshot isolation reads. */
+  timestamp_t read_ts_{0};
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -272,6 +394,14 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the tables held by this transaction, one set per lock mode. */
+  std::shared_ptr<std::unordered_set<table_oid_t>> shared_table_lock_set_;
+  std::shared_ptr<std::unordered_set<table_oid_t>> exclusive_table_lock_set_;
+  std::shared_ptr<std::unordered_set<table_oid_t>> intention_shared_table_lock_set_;
+  std::shared_ptr<std::unordered_set<table_oid_t>> intention_exclusive_table_lock_set_;
+  std::shared_ptr<std::unordered_set<table_oid_t>> shared_intention_exclusive_table_lock_set_;
+  /** LockManager: the rows locked under each table, counted for lock escalation. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> table_row_lock_set_;
 };
 
 }  // namespace bustub
@@ -13,17 +13,20 @@
 #pragma once
 
 #include <atomic>
-#include <shared_mutex>
-#include <unordered_map>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <set>
 #include <unordered_set>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
 class LockManager;
+class TableHeap;
 
 /**
  * TransactionManager keeps track of all the transactions running in the system.
@@ -39,15 +42,25 @@ class TransactionManager {
    * Begins a new transaction.
    * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
    * @param isolation_level an optional isolation level of the transaction.
+   * @param concurrency_control whether the transaction locks or is optimistic
    * @return an initialized transaction
    */
-  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
+  Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                     ConcurrencyControl concurrency_control = ConcurrencyControl::TWO_PHASE_LOCKING);
 
   /**
-   * Commits a transaction.
+   * Begins a new read-only transaction. It reads a snapshot without taking locks, and aborts if it tries to write.
+   * Beginning and finishing it touches nothing but the snapshot bookkeeping: no write or lock sets, no log records.
+   * @return an initialized read-only transaction
+   */
+  Transaction *BeginReadOnly();
+
+  /**
+   * Commits a transaction. An optimistic transaction that fails validation is aborted instead.
    * @param txn the transaction to commit
+   * @return false if the transaction was aborted
    */
-  void Commit(Transaction *txn);
+  bool Commit(Transaction *txn);
 
   /**
    * Aborts a transaction
@@ -55,27 +68,16 @@ class TransactionManager {
    */
   void Abort(Transaction *txn);
 
-  /**
-   * Global list of running transactions
-   */
-
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
+  /** The registry of all the running transactions in the system. */
+  static TransactionRegistry txn_registry;
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * Locates and returns the running transaction with the given transaction ID. The transaction may finish and be
+   * freed at any time, so the caller has to hold a TransactionRegistry::Guard for as long as it uses it.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it has finished
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    TransactionManager::txn_map_mutex.lock_shared();
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    TransactionManager::txn_map_mutex.unlock_shared();
-    return res;
-  }
+  static Transaction *GetTransaction(txn_id_t txn_id) { return txn_registry.Find(txn_id); }
 
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
@@ -99,14 +101,53 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    // table locks go last, the row locks under them are released by now
+    std::unordered_set<table_oid_t> table_lock_set;
+    for (const auto &table_locks :
+         {txn->GetSharedTableLockSet(), txn->GetExclusiveTableLockSet(), txn->GetIntentionSharedTableLockSet(),
+          txn->GetIntentionExclusiveTableLockSet(), txn->GetSharedIntentionExclusiveTableLockSet()}) {
+      table_lock_set.insert(table_locks->begin(), table_locks->end());
+    }
+    for (auto locked_oid : table_lock_set) {
+      lock_manager_->UnlockTable(txn, locked_oid);
+    }
   }
 
+  /**
+   * Write phase of an optimistic transaction: lock and write the buffered tuples, then check that nothing it read has
+   * been written by another transaction since.
+   * @return false if the transaction has to abort
+   */
+  bool ValidateOptimistic(Transaction *txn);
+
+  /** Register the snapshot of a beginning transaction. */
+  void BeginSnapshot(Transaction *txn);
+
+  /** Unregister the snapshot of a finished transaction and collect the versions no snapshot can see anymore. */
+  void EndSnapshot(Transaction *txn);
+
+  /** A tuple whose old versions can be dropped once every snapshot is at or after ts_. */
+  struct VersionGarbage {
+    timestamp_t ts_;
+    TableHeap *table_;
+    RID rid_;
+  };
+
   std::atomic<txn_id_t> next_txn_id_{0};
-  LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
+
+  /** Protects the timestamps, the running snapshots and the version garbage. */
+  std::mutex ts_latch_;
+  /** Commit timestamp of the last committed transaction that wrote something. */
+  timestamp_t last_commit_ts_{0};
+  /** Read timestamps of the running transactions. */
+  std::multiset<timestamp_t> active_read_ts_;
+  /** Written tuples in the order of their timestamps. */
+  std::deque<VersionGarbage> version_garbage_;
 };
 
 }  // namespace bustub
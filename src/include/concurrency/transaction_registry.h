@@ -0,0 +1,91 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * TransactionRegistry maps the ids of the running transactions to the transactions, for the lock manager to find the
+ * transaction it wounds or picks as deadlock victim.
+ *
+ * A transaction is unregistered when it finishes, after which its owner deletes it. A thread that looked the
+ * transaction up just before may still be using it, so lookups are done inside an epoch: Unregister waits until every
+ * epoch that could have seen the transaction is over, and the owner can free it as soon as Unregister returns.
+ */
+class TransactionRegistry {
+ public:
+  /** Keeps the transactions found while it is held from being freed. */
+  class Guard {
+   public:
+    explicit Guard(TransactionRegistry *registry) : registry_(registry), epoch_(registry->Enter()) {}
+    ~Guard() { registry_->Exit(epoch_); }
+    DISALLOW_COPY_AND_MOVE(Guard);
+
+   private:
+    TransactionRegistry *registry_;
+    uint64_t epoch_;
+  };
+
+  TransactionRegistry() = default;
+  DISALLOW_COPY_AND_MOVE(TransactionRegistry);
+
+  /** Make a transaction that begins findable. */
+  void Register(Transaction *txn);
+
+  /** Forget a transaction that finished, then wait until no thread can still be using it. */
+  void Unregister(Transaction *txn);
+
+  /**
+   * Find a running transaction. The caller has to hold a Guard for as long as it uses the transaction.
+   * @return the transaction, nullptr if it has finished
+   */
+  Transaction *Find(txn_id_t txn_id);
+
+  /** @return the number of running transactions */
+  size_t Size();
+
+ private:
+  struct Shard {
+    std::mutex latch_;
+    std::unordered_map<txn_id_t, Transaction *> txns_;
+  };
+
+  Shard &ShardOf(txn_id_t txn_id) { return shards_[static_cast<size_t>(txn_id) % TXN_REGISTRY_SHARDS]; }
+
+  /** Enter the current epoch. @return the epoch entered */
+  uint64_t Enter();
+
+  /** Leave an epoch entered before. */
+  void Exit(uint64_t epoch);
+
+  /** Wait until every guard held when this is called is released. */
+  void Synchronize();
+
+  std::array<Shard, TXN_REGISTRY_SHARDS> shards_;
+  /** Guards enter the current epoch; the parity of an epoch selects its counter of held guards. */
+  std::atomic<uint64_t> epoch_{0};
+  std::array<std::atomic<int>, 2> active_{};
+  /** Synchronize flips the epoch, one at a time. */
+  std::mutex sync_latch_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,122 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/concurrency/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the older versions of the tuples of one table heap for snapshot isolation.
+ *
+ * The table heap always holds the newest version of a tuple. When a tuple is written, the version it replaces is put
+ * in front of the tuple's undo chain together with the commit timestamp it was created at; tuples that were not
+ * written recently have no chain and are visible to everyone. A snapshot reader walks the chain to the newest version
+ * committed at or before its read timestamp.
+ *
+ * Chains are changed while the page of the tuple is latched, and readers latch the page before looking at the chain,
+ * so that a reader never sees a page change without the chain entry that goes with it.
+ */
+class VersionStore {
+ public:
+  VersionStore() = default;
+  DISALLOW_COPY_AND_MOVE(VersionStore);
+
+  /**
+   * Check whether a transaction may write a tuple. Under snapshot isolation a transaction may not overwrite a
+   * version committed after its snapshot was taken (first updater wins); nobody may write a version another
+   * transaction has not committed yet.
+   * @return false if the write conflicts
+   */
+  bool CanWrite(const RID &rid, Transaction *txn);
+
+  /**
+   * Remember the version a write replaces. Only the first write of a transaction to a tuple adds a version.
+   * @param before the replaced tuple, nullptr if the slot held no tuple
+   */
+  void RecordWrite(const RID &rid, Transaction *txn, const Tuple *before);
+
+  /** Make the version written by the transaction visible to snapshots taken at or after commit_ts. */
+  void Commit(const RID &rid, Transaction *txn, timestamp_t commit_ts);
+
+  /** Drop the version written by the transaction, the table heap holds the replaced one again by now. */
+  void Abort(const RID &rid, Transaction *txn);
+
+  /**
+   * Find the version of a tuple a transaction sees.
+   * @param heap_exists whether the table heap holds a tuple in the slot
+   * @param[in,out] tuple the newest version as read from the table heap, replaced by the visible version
+   * @return false if no version is visible to the transaction
+   */
+  bool Resolve(const RID &rid, Transaction *txn, bool heap_exists, Tuple *tuple);
+
+  /**
+   * Find the latest committed version of a tuple, or the transaction's own write.
+   * @param heap_exists whether the table heap holds a tuple in the slot
+   * @param[in,out] tuple the newest version as read from the table heap, replaced by the committed version
+   * @param[out] ts commit timestamp of the version found
+   * @return false if the latest committed version has no tuple
+   */
+  bool ReadLatest(const RID &rid, Transaction *txn, bool heap_exists, Tuple *tuple, timestamp_t *ts);
+
+  /**
+   * Check that the latest committed version of a tuple is still the one an optimistic transaction read.
+   * @param ts commit timestamp of the version that was read
+   * @return false if another transaction has written the tuple since, committed or not
+   */
+  bool Validate(const RID &rid, Transaction *txn, timestamp_t ts);
+
+  /** Drop the versions no snapshot taken at or after watermark can see, the chain itself once it is not needed. */
+  void Collect(const RID &rid, timestamp_t watermark);
+
+  /** @return the number of tuples with a version chain */
+  size_t Size();
+
+ private:
+  struct Version {
+    /** Commit timestamp of the transaction that created this version. */
+    timestamp_t ts_;
+    /** False if the tuple did not exist in this version. */
+    bool exists_;
+    Tuple tuple_;
+  };
+
+  struct VersionChain {
+    /** Transaction that wrote the heap version and has not committed yet, INVALID_TXN_ID if none. */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** Commit timestamp of the heap version, meaningless while there is a writer. */
+    timestamp_t ts_{0};
+    /** Replaced versions, newest first. */
+    std::deque<Version> undo_;
+  };
+
+  struct Shard {
+    std::mutex latch_;
+    std::unordered_map<RID, VersionChain> chains_;
+  };
+
+  Shard &ShardOf(const RID &rid);
+
+  std::array<Shard, VERSION_STORE_SHARDS> shards_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +22,10 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager creates fuzzy checkpoints without blocking transactions. A checkpoint logs a begin record, then
+ * the active transaction table and the dirty page table in an end record, so that recovery can start its analysis at
+ * the checkpoint instead of at the beginning of the log. The dirty pages are written back by a background thread at
+ * the rate set by checkpoint_flush_interval, which advances the redo point of the next checkpoint.
  */
 class CheckpointManager {
  public:
@@ -29,15 +35,21 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager() { EndCheckpoint(); }
 
+  /** Log the checkpoint and start writing back the pages that were dirty at that point. Returns right away. */
   void BeginCheckpoint();
+  /** Wait for the write-back started by BeginCheckpoint to finish. */
   void EndCheckpoint();
 
  private:
+  /** Write back the given pages one at a time, skipping pages that were evicted or cleaned in the meantime. */
+  void FlushPages(const std::vector<page_id_t> &page_ids);
+
   TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  std::thread *flush_thread_{nullptr};
 };
 
 }  // namespace bustub
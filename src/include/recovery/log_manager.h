@@ -15,7 +15,11 @@
 #include <algorithm>
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
-#include <mutex>               // NOLINT
+#include <map>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <utility>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -28,11 +32,11 @@ namespace bustub {
  */
 class LogManager {
  public:
-  explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
-  }
+  /**
+   * Open the log at its end. The newest segment is walked from its start lsn so that lsns keep increasing across
+   * restarts and a torn tail left by a crash gets overwritten.
+   */
+  explicit LogManager(DiskManager *disk_manager);
 
   ~LogManager() {
     delete[] log_buffer_;
@@ -46,13 +50,42 @@ class LogManager {
 
   lsn_t AppendLogRecord(LogRecord *log_record);
 
+  /**
+   * Block until every log record appended so far is on disk.
+   * @param force wake the flush thread right away instead of waiting for the timeout
+   */
+  void Flush(bool force);
+
+  /**
+   * @return a log file offset at or before the record with the given lsn. The offset is exact for lsns that have not
+   * been appended yet, otherwise it is the start of the flushed batch holding the record.
+   */
+  log_offset_t GetLogOffset(lsn_t lsn);
+
+  /**
+   * Recovery never starts scanning before the given lsn again: forget offsets of batches that end before it and
+   * recycle the log segments that lie entirely before it.
+   */
+  void TruncateLog(lsn_t lsn);
+
+  /**
+   * Snapshot the transactions that have log records but no COMMIT/ABORT record yet.
+   * @param[out] active_txn_table each active transaction with its last lsn
+   * @return the first lsn of the oldest active transaction, or the next lsn if there is none
+   */
+  lsn_t GetActiveTxnTable(std::unordered_map<txn_id_t, lsn_t> *active_txn_table);
+
+  /** Point the master record at the last checkpoint appended, which must already be flushed. */
+  void WriteMasterRecord();
+
   inline lsn_t GetNextLSN() { return next_lsn_; }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline char *GetLogBuffer() { return log_buffer_; }
 
  private:
-  // TODO(students): you may add your own member variables
+  /** Swap the buffers and write out what was appended, called with latch_ held by whoever owns the flush. */
+  void FlushBuffer(std::unique_lock<std::mutex> *lock);
 
   /** The atomic counter which records the next log sequence number. */
   std::atomic<lsn_t> next_lsn_;
@@ -61,14 +94,32 @@ class LogManager {
 
   char *log_buffer_;
   char *flush_buffer_;
+  /** Bytes used in log_buffer_. */
+  int offset_{0};
+  /** Logical log offset of log_buffer_, i.e. the end of what was handed to the disk manager. */
+  log_offset_t log_size_;
+  /** True once someone asked for the buffer to be written out before the timeout. */
+  bool need_flush_{false};
+  /** Lsn of the first record in log_buffer_. */
+  lsn_t buffer_first_lsn_{INVALID_LSN};
+  /** Offset of the last BEGIN_CHECKPOINT record appended. */
+  log_offset_t checkpoint_offset_{-1};
+
+  /** First lsn of each flushed batch and its file offset, used to turn lsns into scan offsets. */
+  std::map<lsn_t, log_offset_t> lsn_offsets_;
+  /** Transactions without an end record yet, mapped to their (first lsn, last lsn). */
+  std::unordered_map<txn_id_t, std::pair<lsn_t, lsn_t>> active_txns_;
 
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
 
+  /** Wakes the flush thread. */
   std::condition_variable cv_;
+  /** Wakes appenders waiting for buffer space and committers waiting for durability. */
+  std::condition_variable flushed_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -14,6 +14,9 @@
 
 #include <cassert>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +35,16 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Start of a fuzzy checkpoint, the master record points here. */
+  BEGIN_CHECKPOINT,
+  /** End of a fuzzy checkpoint carrying the active transaction table and the dirty page table. */
+  END_CHECKPOINT,
+  /** Updating a tuple in place without changing its length, only the changed bytes are logged. */
+  DELTAUPDATE,
+  /** Inserting an entry into a B+ tree index, with every page the insert changed. */
+  INDEXINSERT,
+  /** Removing an entry from a B+ tree index, with every page the remove changed. */
+  INDEXDELETE,
 };
 
 /**
@@ -53,10 +66,32 @@ enum class LogRecordType {
  *-----------------------------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
+ * For delta update type log record
+ *-----------------------------------------------------------------------
+ * | HEADER | tuple_rid | delta_size | (offset, length, old, new)... |
+ *-----------------------------------------------------------------------
+ * offset and length are uint16_t and locate a changed range within the tuple, see Tuple::EncodeDelta.
+ * For index insert and delete type log record
+ *-------------------------------------------------------------------------------------------------------
+ * | HEADER | name_size | index_name | key_size | key | rid | page_count | (page_id, delta_size, delta)... |
+ *-------------------------------------------------------------------------------------------------------
+ * The key and rid are used to undo the operation logically, since the entry may have moved to another page by
+ * then. Each delta holds the new bytes of one page as (offset, length, bytes) ranges, see IndexPageLog, and is only
+ * used for redo.
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *------------------------------------
+ * For begin checkpoint type log record
+ *----------
+ * | HEADER |
+ *----------
+ * For end checkpoint type log record
+ *------------------------------------------------------------------------------------------------
+ * | HEADER | scan_offset | att_size | (txn_id, last_lsn)... | dpt_size | (page_id, rec_lsn)... |
+ *------------------------------------------------------------------------------------------------
+ * scan_offset is the log file offset from which recovery must scan to see every record of the active transactions
+ * and every update that may be missing from a dirty page.
  */
 class LogRecord {
   friend class LogManager;
@@ -98,6 +133,36 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
 
+  // constructor for DELTAUPDATE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
+            std::vector<char> delta)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        update_rid_(update_rid),
+        delta_(std::move(delta)) {
+    // calculate log record size
+    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + delta_.size();
+  }
+
+  // constructor for INDEXINSERT/INDEXDELETE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, std::string index_name,
+            std::vector<char> index_key, const RID &index_rid,
+            std::vector<std::pair<page_id_t, std::vector<char>>> page_deltas)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        index_name_(std::move(index_name)),
+        index_key_(std::move(index_key)),
+        index_rid_(index_rid),
+        page_deltas_(std::move(page_deltas)) {
+    // calculate log record size, header size + name + key + rid + every page delta with its page id and size
+    size_ = HEADER_SIZE + 3 * sizeof(int32_t) + index_name_.size() + index_key_.size() + sizeof(RID);
+    for (const auto &delta : page_deltas_) {
+      size_ += sizeof(page_id_t) + sizeof(int32_t) + delta.second.size();
+    }
+  }
+
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
       : size_(HEADER_SIZE),
@@ -110,6 +175,21 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for END_CHECKPOINT type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, log_offset_t scan_offset,
+            std::unordered_map<txn_id_t, lsn_t> active_txn_table, std::unordered_map<page_id_t, lsn_t> dirty_page_table)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        scan_offset_(scan_offset),
+        active_txn_table_(std::move(active_txn_table)),
+        dirty_page_table_(std::move(dirty_page_table)) {
+    // calculate log record size, header size + scan offset + both tables with their sizes
+    size_ = HEADER_SIZE + sizeof(log_offset_t) + 2 * sizeof(int32_t) +
+            active_txn_table_.size() * (sizeof(txn_id_t) + sizeof(lsn_t)) +
+            dirty_page_table_.size() * (sizeof(page_id_t) + sizeof(lsn_t));
+  }
+
   ~LogRecord() = default;
 
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
@@ -126,8 +206,26 @@ class LogRecord {
 
   inline RID &GetUpdateRID() { return update_rid_; }
 
+  inline std::vector<char> &GetUpdateDelta() { return delta_; }
+
+  inline std::string &GetIndexName() { return index_name_; }
+
+  inline std::vector<char> &GetIndexKey() { return index_key_; }
+
+  inline RID &GetIndexRID() { return index_rid_; }
+
+  inline std::vector<std::pair<page_id_t, std::vector<char>>> &GetPageDeltas() { return page_deltas_; }
+
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline page_id_t GetNewPageId() { return page_id_; }
+
+  inline log_offset_t GetScanOffset() { return scan_offset_; }
+
+  inline std::unordered_map<txn_id_t, lsn_t> &GetActiveTxnTable() { return active_txn_table_; }
+
+  inline std::unordered_map<page_id_t, lsn_t> &GetDirtyPageTable() { return dirty_page_table_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -172,10 +270,23 @@ class LogRecord {
   RID update_rid_;
   Tuple old_tuple_;
   Tuple new_tuple_;
+  // changed byte ranges of an in place update, instead of the two tuples
+  std::vector<char> delta_;
+
+  // case4: for index operation, the entry for logical undo and the changed bytes of each page for redo
+  std::string index_name_;
+  std::vector<char> index_key_;
+  RID index_rid_;
+  std::vector<std::pair<page_id_t, std::vector<char>>> page_deltas_;
 
-  // case4: for new page operation
+  // case5: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case6: for checkpoint, active transactions with their last lsn and dirty pages with their recovery lsn
+  log_offset_t scan_offset_{0};
+  std::unordered_map<txn_id_t, lsn_t> active_txn_table_;
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
@@ -13,17 +13,24 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <mutex>  // NOLINT
+#include <string>
 #include <unordered_map>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
 #include "recovery/log_record.h"
+#include "storage/index/index.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo starts with an analysis pass from the last checkpoint named by the master record, which rebuilds the active
+ * transaction table and the dirty page table. Redo then only replays from the checkpoint's scan offset and skips
+ * records whose page is not dirty or already reflects them, so restart time is bounded by the checkpoint interval.
  */
 class LogRecovery {
  public:
@@ -39,18 +46,49 @@ class LogRecovery {
 
   void Redo();
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord *log_record);
+  /**
+   * Make an index known to undo. Index entries of losers are removed or put back through the index by name, those of
+   * indexes that are not registered are left as redo restored them.
+   */
+  void RegisterIndex(Index *index) { indexes_[index->GetName()] = index; }
+  /**
+   * @param data serialized log records
+   * @param size number of valid bytes at data
+   * @param[out] log_record the first record at data
+   * @return false if data does not start with a complete log record
+   */
+  bool DeserializeLogRecord(const char *data, int size, LogRecord *log_record);
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** Rebuild active_txn_ and dirty_page_table_ from the last checkpoint onwards, and pick the redo start offset. */
+  void Analysis();
+
+  /** Call handler on every record from the given offset to the end of the log, stopping early if it returns false. */
+  void ScanLog(log_offset_t offset, const std::function<bool(LogRecord *, log_offset_t)> &handler);
+
+  /** Read the single log record at the given offset. */
+  bool ReadLogRecord(log_offset_t offset, LogRecord *log_record);
+
+  /** Apply the page deltas of an index record to the pages that miss them. */
+  void RedoIndexPages(LogRecord *log_record);
+
+  /** Undo an index record of a loser by removing or putting back its entry. */
+  void UndoIndexEntry(LogRecord *log_record);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  std::unordered_map<lsn_t, log_offset_t> lsn_mapping_;
+  /** Pages that may miss updates and the first lsn that may be missing. */
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
+  /** Indexes whose entries are undone logically, by name. */
+  std::unordered_map<std::string, Index *> indexes_;
 
-  int offset_ __attribute__((__unused__));
+  /** Log offset where redo starts scanning. */
+  log_offset_t offset_;
   char *log_buffer_;
 };
 
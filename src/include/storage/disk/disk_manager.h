@@ -55,21 +55,66 @@ class DiskManager {
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
+  /** @return the number of pages the database file spans, pages past them have never been written */
+  int GetNumPages();
+
   /**
    * Flush the entire log buffer into disk.
+   * The log is split into segment files of LOG_SEGMENT_SIZE bytes addressed by one logical offset. A write never
+   * straddles two segments: if it does not fit in what is left of the current segment, the rest of that segment is
+   * left unused and the write starts the next one.
    * @param log_data raw log data
    * @param size size of log entry
+   * @param first_lsn lsn of the first record in log_data, kept in the header of a segment this write starts
    */
-  void WriteLog(char *log_data, int size);
+  void WriteLog(char *log_data, int size, lsn_t first_lsn = INVALID_LSN);
 
   /**
-   * Read a log entry from the log file.
+   * Read a log entry from the log file. Reads stop at the end of the segment holding offset, the remainder of the
+   * output buffer is zeroed.
    * @param[out] log_data output buffer
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
+   * @param offset logical offset of the log entry
    * @return true if the read was successful, false otherwise
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, log_offset_t offset);
+
+  /**
+   * Locate the newest log segment, from which the log manager finds the end of the log after a restart.
+   * @param[out] offset logical offset of the start of the newest segment
+   * @param[out] start_lsn lsn of the first record in that segment, INVALID_LSN if it is unknown
+   * @return false if the log is empty
+   */
+  bool GetLastLogSegment(log_offset_t *offset, lsn_t *start_lsn);
+
+  /** @return the logical offset of the start of the oldest live segment, where a scan of the whole log starts */
+  log_offset_t GetLogStart();
+
+  /** @return the logical offset of the end of the log */
+  log_offset_t GetLogEnd();
+
+  /**
+   * Set where the next log write goes, i.e. the end of the valid records in the newest segment. Anything after it is
+   * left over from an earlier use of a recycled segment file.
+   * @param offset logical offset of the end of the log
+   */
+  void SetLogEnd(log_offset_t offset);
+
+  /**
+   * Recycle the segments that lie entirely before offset. Their files are renamed to the next unused segment numbers
+   * and rewritten in place once the log reaches them, instead of being deleted and allocated again.
+   * @param offset logical offset before which no log record is needed anymore
+   */
+  void TruncateLog(log_offset_t offset);
+
+  /**
+   * Durably record the log offset of the most recent complete checkpoint.
+   * @param offset offset of the checkpoint log record in the log file
+   */
+  void WriteMasterRecord(log_offset_t offset);
+
+  /** @return the log offset of the most recent complete checkpoint, or -1 if there is none */
+  log_offset_t ReadMasterRecord();
 
   /** @return the number of disk flushes */
   int GetNumFlushes() const;
@@ -89,11 +134,48 @@ class DiskManager {
   /** Checks if the non-blocking flush future was set. */
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
+  /** Size of the header at the start of each log segment file, which is not part of the logical log. */
+  static constexpr int LOG_SEGMENT_HEADER_SIZE = 16;
+
  private:
   int GetFileSize(const std::string &file_name);
-  // stream to write log file
+  /** @return the file name of the given log segment */
+  std::string GetLogSegmentName(int segment) const;
+  /**
+   * Check that a segment file holds that segment of this log. Spare files still carry the number they had before
+   * being recycled, and files of an earlier log carry a different log id.
+   * @param segment the segment number
+   * @param[out] start_lsn lsn of the first record in the segment
+   */
+  bool IsLiveLogSegment(int segment, lsn_t *start_lsn);
+  /** Open the given segment for writing, writing a fresh header into it (reusing a spare file if there is one). */
+  void StartLogSegment(int segment, lsn_t start_lsn);
+  /** Persist the number of the oldest live segment and the log id into the log control file. */
+  void WriteLogControl();
+
+  // stream to write the current log segment
   std::fstream log_io_;
+  // stream to read log segments, kept open on the segment read last
+  std::fstream log_read_io_;
+  // the log control file, segments are named after it
   std::string log_name_;
+  // segment log_io_ is open on, -1 if none
+  int log_write_segment_{-1};
+  // segment log_read_io_ is open on, -1 if none
+  int log_read_segment_{-1};
+  // random id of this log, stamped into every segment header
+  uint32_t log_id_{0};
+  // oldest and newest live segment, the log is empty while last < first
+  int first_log_segment_{0};
+  int last_log_segment_{-1};
+  // first segment number past every live and spare segment file
+  int next_spare_segment_{0};
+  // logical offset of the end of the log
+  log_offset_t log_end_{0};
+  // protects the log segment state
+  std::mutex log_io_latch_;
+  // file holding the offset of the last checkpoint record in the log
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
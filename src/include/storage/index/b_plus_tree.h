@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
@@ -29,13 +30,18 @@ namespace bustub {
  *
  * Implementation of simple b+ tree data structure where internal pages direct
  * the search and leaf pages contain actual data.
- * (1) We only support unique key
+ * (1) We only support unique key, a non-unique index appends the rid to
+ *     its keys (see BPlusTreeIndex::IndexKey)
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ * (5) Pages are linked to their right siblings and carry high keys (B-link
+ *     tree), readers descend holding one latch at a time
+ * (6) Leaves are linked to their left siblings too, for reverse range scans
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
+  friend class IndexIterator<KeyType, ValueType, KeyComparator>;
   using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
 
@@ -43,7 +49,8 @@ class BPlusTree {
 
  public:
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     LogManager *log_manager = nullptr);
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -51,17 +58,34 @@ class BPlusTree {
   // Insert a key-value pair into this B+ tree.
   bool Insert(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
+  // Build this empty B+ tree from a batch of entries, bottom-up.
+  bool BulkLoad(std::vector<MappingType> *entries, double fill_factor = BULK_LOAD_FILL_FACTOR,
+                Transaction *transaction = nullptr);
+
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
   // return the value associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
+  // return the values of a batch of sorted key ranges, descending once for the whole batch
+  void ScanRanges(const std::vector<std::pair<KeyType, KeyType>> &ranges, std::vector<std::vector<ValueType>> *results,
+                  Transaction *transaction = nullptr);
+
   // index iterator
   INDEXITERATOR_TYPE Begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
+  INDEXITERATOR_TYPE Begin(const KeyType &key, const KeyType &end_key);
   INDEXITERATOR_TYPE End();
 
+  // reverse index iterator, from the largest key to the smallest
+  INDEXITERATOR_TYPE RBegin();
+  INDEXITERATOR_TYPE RBegin(const KeyType &key);
+  INDEXITERATOR_TYPE RBegin(const KeyType &key, const KeyType &end_key);
+
+  // split the keys from key on into ranges for parallel scans, returns the first key of each
+  std::vector<KeyType> SplitRange(const KeyType &key, int parts);
+
   void Print(BufferPoolManager *bpm) {
     ToString(reinterpret_cast<BPlusTreePage *>(bpm->FetchPage(root_page_id_)->GetData()), bpm);
   }
@@ -81,12 +105,15 @@ class BPlusTree {
   void RemoveFromFile(const std::string &file_name, Transaction *transaction = nullptr);
   // expose for test purpose
   Page *FindLeafPage(const KeyType &key, bool leftMost = false);
+  Page *FindLeafBefore(const KeyType &key);
 
  private:
   void StartNewTree(const KeyType &key, const ValueType &value);
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
+  void LinkNextLeafBack(BPlusTreeLeafPage<KVC> *leaf, std::vector<Page *> *latches, OPTYPE op_type);
+
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
                         Transaction *transaction = nullptr);
 
@@ -105,16 +132,29 @@ class BPlusTree {
 
   void UpdateRootPageId(int insert_record = 0);
 
+  // read the root page id recorded in the header page, once, so that a reopened tree finds its pages again
+  void LoadRootPageId();
+
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
 
   void ToString(BPlusTreePage *page, BufferPoolManager *bpm) const;
 
  private:
-  Page *Search(const KeyType &key, Page *node, OPTYPE op_type, std::vector<Page *> *latches);
-  Page *FindSiblingRedistribute(BPlusTreePage *node, int max_size, bool *is_right);
+  Page *LatchRoot(OPTYPE op_type, bool crab);
+  Page *FindLeaf(const KeyType &key, OPTYPE op_type, bool optimistic, std::vector<Page *> *latches);
+  Page *DescendToLeaf(const KeyType &key, bool left_most, Page *page, std::vector<Page *> *path);
+  void UnpinPath(std::vector<Page *> *path);
+  Page *FindSiblingRedistribute(BPlusTreePage *node);
   Page *FindSiblingCoalesce(BPlusTreePage *node, BPlusTreeInternalPage<INTERNAL_KVC> **parent, bool *is_right);
   bool IsSafe(BPlusTreePage *node, OPTYPE op_type) const;
+  int Capacity(BPlusTreePage *node) const;
+  int MergedCapacity(BPlusTreePage *left, BPlusTreePage *right) const;
+  bool CanBorrow(BPlusTreePage *left, BPlusTreePage *right) const;
+  template <typename N, typename T>
+  int BulkLoadPageEntries(N *page, const std::vector<T> &items, int begin, double fill_factor) const;
+  template <typename N>
+  void ChainBulkLoadPage(Page **last_page, Page *page);
   void PLatch(Page *page, OPTYPE op_type);
   void PUnlatch(Page *page, OPTYPE op_type);
   void LatchPush(std::vector<Page *> *latches, Page *page, OPTYPE op_type);
@@ -127,6 +167,8 @@ class BPlusTree {
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
+  LogManager *log_manager_;
+  bool root_loaded_;
   std::mutex latch_;  // protect when update root page id
 };
 
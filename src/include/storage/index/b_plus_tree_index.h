@@ -26,21 +26,53 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager);
+  BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
+                 LogManager *log_manager = nullptr);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
   void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
+  // a non-unique index returns the rids of all entries of the key, in rid order
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  // sorts the keys and looks them up with one descent, see BPlusTree::ScanRanges
+  void ScanKeys(const std::vector<Tuple> &keys, std::vector<std::vector<RID>> *results,
+                Transaction *transaction) override;
+
+  Tuple KeyFromStoredKey(const char *key_data) const override;
+
+  // the key the tree holds the entry of a table tuple under: the key of a non-unique index ends with the rid, so that
+  // the entries of equal keys are distinct and sorted by rid, and the ones of a common key share the prefix of a page
+  KeyType IndexKey(const Tuple &key, RID rid) const;
+
+  // build the empty index from the entries of an existing table, see BPlusTree::BulkLoad
+  bool BulkLoad(std::vector<MappingType> *entries, Transaction *transaction);
+
   INDEXITERATOR_TYPE GetBeginIterator();
 
   INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key);
 
+  INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key, const KeyType &end_key);
+
+  // split a scan from key to the end for parallel scans, see BPlusTree::SplitRange
+  std::vector<KeyType> SplitRange(const KeyType &key, int parts);
+
   INDEXITERATOR_TYPE GetEndIterator();
 
+  // iterate from larger keys to smaller ones, see BPlusTree::RBegin
+  INDEXITERATOR_TYPE GetReverseBeginIterator();
+
+  INDEXITERATOR_TYPE GetReverseBeginIterator(const KeyType &key);
+
+  INDEXITERATOR_TYPE GetReverseBeginIterator(const KeyType &key, const KeyType &end_key);
+
  protected:
+  // the range of stored keys of the entries of a key: the key itself, or the key with any rid if it is not unique
+  std::pair<KeyType, KeyType> KeyRange(const Tuple &key) const;
+
+  // whether the keys are stored without rids
+  bool is_unique_;
   // comparator for key
   KeyComparator comparator_;
   // container
@@ -39,6 +39,8 @@ class ExtendibleHashTableIndex : public Index {
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  Tuple KeyFromStoredKey(const char *key_data) const override;
+
  protected:
   // comparator for key
   KeyComparator comparator_;
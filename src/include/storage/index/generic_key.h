@@ -12,8 +12,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstring>
+#include <string>
+#include <vector>
 
+#include "common/rid.h"
 #include "storage/table/tuple.h"
 #include "type/value.h"
 
@@ -25,39 +29,138 @@ namespace bustub {
  * This key type uses an fixed length array to hold data for indexing
  * purposes, the actual size of which is specified and instantiated
  * with a template argument.
+ *
+ * The columns of the key are stored one after the other in an encoding whose
+ * bytes sort like the values, so keys compare with memcmp:
+ *  - integers and booleans big-endian with the sign bit flipped
+ *  - decimals with the sign bit flipped if positive, all bits if negative
+ *  - timestamps big-endian
+ *  - varchars zero padded
+ * NULL is stored as the smallest value of a type and so sorts first, a NULL
+ * varchar is all zeros like an empty one. Fixed size columns keep their size,
+ * the varchars share the bytes left over. Values that do not fit would be cut
+ * off and compare equal, Catalog::CreateIndex rejects such key schemas.
+ *
+ * A key of a non-unique index ends with the rid of its entry, so that entries
+ * of equal columns are distinct keys ordered by rid. The columns then share
+ * the bytes before the last RID_SIZE ones.
  */
 template <size_t KeySize>
 class GenericKey {
  public:
-  inline void SetFromKey(const Tuple &tuple) {
+  // bytes at the end of a key that hold the rid, page id and slot big-endian
+  static constexpr uint32_t RID_SIZE = sizeof(page_id_t) + sizeof(uint32_t);
+
+  inline void SetFromKey(const Tuple &tuple, const Schema *key_schema) {
     // intialize to 0
     memset(data_, 0, KeySize);
-    memcpy(data_, tuple.GetData(), tuple.GetLength());
+    SetColumns(tuple, key_schema, KeySize);
+  }
+
+  // number of key bytes the columns share, the rest hold the rid if the key ends with one
+  static constexpr uint32_t ColumnsSize(bool with_rid) {
+    return !with_rid ? KeySize : KeySize > RID_SIZE ? static_cast<uint32_t>(KeySize - RID_SIZE) : 0;
+  }
+
+  // number of key bytes the fixed size columns of the key schema take
+  static uint32_t FixedColumnsSize(const Schema *key_schema) {
+    uint32_t fixed = 0;
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      const auto &col = key_schema->GetColumn(i);
+      fixed += col.IsInlined() ? col.GetFixedLength() : 0;
+    }
+    return fixed;
+  }
+
+  // whether every value of the key schema fits into the key uncut, so that distinct values make distinct keys
+  static bool ColumnsFit(const Schema *key_schema, bool with_rid) {
+    uint32_t size = ColumnsSize(with_rid);
+    if (FixedColumnsSize(key_schema) > size) {
+      return false;
+    }
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      const auto &col = key_schema->GetColumn(i);
+      if (!col.IsInlined() && col.GetLength() > ColumnWidth(key_schema, i, size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // the key of an entry of a non-unique index
+  inline void SetFromKey(const Tuple &tuple, const Schema *key_schema, const RID &rid) {
+    memset(data_, 0, KeySize);
+    SetColumns(tuple, key_schema, ColumnsSize(true));
+    SetRid(rid);
+  }
+
+  inline void SetRid(const RID &rid) {
+    char *dest = data_ + ColumnsSize(true);
+    EncodeBytes(static_cast<uint32_t>(rid.GetPageId()), sizeof(page_id_t), dest, sizeof(page_id_t));
+    EncodeBytes(rid.GetSlotNum(), sizeof(uint32_t), dest + sizeof(page_id_t), sizeof(uint32_t));
+  }
+
+  inline RID GetRid() const {
+    uint32_t offset = ColumnsSize(true);
+    auto page_id = static_cast<page_id_t>(DecodeUnsigned(offset, sizeof(page_id_t), sizeof(page_id_t)));
+    uint32_t slot_num = DecodeUnsigned(offset + sizeof(page_id_t), sizeof(uint32_t), sizeof(uint32_t));
+    return RID(page_id, slot_num);
   }
 
   // NOTE: for test purpose only
   inline void SetFromInteger(int64_t key) {
     memset(data_, 0, KeySize);
-    memcpy(data_, &key, sizeof(int64_t));
-  }
-
-  inline Value ToValue(Schema *schema, uint32_t column_idx) const {
-    const char *data_ptr;
-    const auto &col = schema->GetColumn(column_idx);
-    const TypeId column_type = col.GetType();
-    const bool is_inlined = col.IsInlined();
-    if (is_inlined) {
-      data_ptr = (data_ + col.GetOffset());
-    } else {
-      int32_t offset = *reinterpret_cast<int32_t *>(const_cast<char *>(data_ + col.GetOffset()));
-      data_ptr = (data_ + offset);
+    EncodeSigned<int64_t>(reinterpret_cast<const char *>(&key), data_, std::min<uint32_t>(KeySize, sizeof(key)));
+  }
+
+  // with_rid tells that the key ends with a rid, as the keys of a non-unique index do
+  inline Value ToValue(Schema *schema, uint32_t column_idx, bool with_rid = false) const {
+    uint32_t size = ColumnsSize(with_rid);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < column_idx; i++) {
+      offset += ColumnWidth(schema, i, size);
+    }
+    uint32_t width = std::min(ColumnWidth(schema, column_idx, size), offset < size ? size - offset : 0);
+    const TypeId column_type = schema->GetColumn(column_idx).GetType();
+    switch (column_type) {
+      case TypeId::BOOLEAN:
+      case TypeId::TINYINT:
+        return Value(column_type, static_cast<int8_t>(DecodeSigned(offset, width, sizeof(int8_t))));
+      case TypeId::SMALLINT:
+        return Value(column_type, static_cast<int16_t>(DecodeSigned(offset, width, sizeof(int16_t))));
+      case TypeId::INTEGER:
+        return Value(column_type, static_cast<int32_t>(DecodeSigned(offset, width, sizeof(int32_t))));
+      case TypeId::BIGINT:
+        return Value(column_type, DecodeSigned(offset, width, sizeof(int64_t)));
+      case TypeId::DECIMAL: {
+        uint64_t bits = DecodeUnsigned(offset, width, sizeof(uint64_t));
+        bits = (bits >> 63) != 0 ? bits & ~(1ULL << 63) : ~bits;
+        double decimal;
+        memcpy(&decimal, &bits, sizeof(decimal));
+        return Value(column_type, decimal);
+      }
+      case TypeId::TIMESTAMP:
+        return Value(column_type, DecodeUnsigned(offset, width, sizeof(uint64_t)));
+      case TypeId::VARCHAR:
+        return Value(column_type, std::string(data_ + offset, strnlen(data_ + offset, width)));
+      default:
+        return Value(column_type);
     }
-    return Value::DeserializeFrom(data_ptr, column_type);
+  }
+
+  // rebuild a tuple of the key schema, SetFromKey turns it into this key again
+  inline Tuple ToKeyTuple(Schema *key_schema, bool with_rid = false) const {
+    std::vector<Value> values;
+    values.reserve(key_schema->GetColumnCount());
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      values.emplace_back(ToValue(key_schema, i, with_rid));
+    }
+    return Tuple(values, key_schema);
   }
 
   // NOTE: for test purpose only
   // interpret the first 8 bytes as int64_t from data vector
-  inline int64_t ToString() const { return *reinterpret_cast<int64_t *>(const_cast<char *>(data_)); }
+  inline int64_t ToString() const { return DecodeSigned(0, std::min<uint32_t>(KeySize, 8), sizeof(int64_t)); }
 
   // NOTE: for test purpose only
   // interpret the first 8 bytes as int64_t from data vector
@@ -68,39 +171,132 @@ class GenericKey {
 
   // actual location of data, extends past the end.
   char data_[KeySize];
+
+ private:
+  // encode the columns of the key schema into the first size bytes of the key
+  inline void SetColumns(const Tuple &tuple, const Schema *key_schema, uint32_t size) {
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      const auto &col = key_schema->GetColumn(i);
+      uint32_t width = std::min(ColumnWidth(key_schema, i, size), offset < size ? size - offset : 0);
+      const char *src = tuple.GetData() + col.GetOffset();
+      switch (col.GetType()) {
+        case TypeId::BOOLEAN:
+        case TypeId::TINYINT:
+          EncodeSigned<int8_t>(src, data_ + offset, width);
+          break;
+        case TypeId::SMALLINT:
+          EncodeSigned<int16_t>(src, data_ + offset, width);
+          break;
+        case TypeId::INTEGER:
+          EncodeSigned<int32_t>(src, data_ + offset, width);
+          break;
+        case TypeId::BIGINT:
+          EncodeSigned<int64_t>(src, data_ + offset, width);
+          break;
+        case TypeId::DECIMAL: {
+          double decimal;
+          memcpy(&decimal, src, sizeof(decimal));
+          // -0.0 equals 0.0 but has the sign bit set, it would sort below it
+          decimal = decimal == 0.0 ? 0.0 : decimal;
+          uint64_t bits;
+          memcpy(&bits, &decimal, sizeof(bits));
+          bits = (bits >> 63) != 0 ? ~bits : bits | (1ULL << 63);
+          EncodeUnsigned(bits, data_ + offset, width);
+          break;
+        }
+        case TypeId::TIMESTAMP: {
+          uint64_t timestamp;
+          memcpy(&timestamp, src, sizeof(timestamp));
+          EncodeUnsigned(timestamp, data_ + offset, width);
+          break;
+        }
+        case TypeId::VARCHAR: {
+          int32_t varlen_offset;
+          memcpy(&varlen_offset, src, sizeof(varlen_offset));
+          uint32_t len;
+          memcpy(&len, tuple.GetData() + varlen_offset, sizeof(len));
+          if (len != BUSTUB_VALUE_NULL) {
+            memcpy(data_ + offset, tuple.GetData() + varlen_offset + sizeof(uint32_t), std::min(len, width));
+          }
+          break;
+        }
+        default:
+          break;
+      }
+      offset += width;
+    }
+  }
+
+  // number of key bytes column column_idx of the key schema takes when the columns share size bytes
+  static uint32_t ColumnWidth(const Schema *key_schema, uint32_t column_idx, uint32_t size) {
+    const auto &col = key_schema->GetColumn(column_idx);
+    if (col.IsInlined()) {
+      return col.GetFixedLength();
+    }
+    uint32_t varchars = 0;
+    for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+      varchars += key_schema->GetColumn(i).IsInlined() ? 0 : 1;
+    }
+    uint32_t fixed = FixedColumnsSize(key_schema);
+    return fixed < size ? (size - fixed) / varchars : 0;
+  }
+
+  template <typename T>
+  inline void EncodeSigned(const char *src, char *dest, uint32_t width) {
+    T value;
+    memcpy(&value, src, sizeof(T));
+    uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(value)) ^ (1ULL << (sizeof(T) * 8 - 1));
+    EncodeBytes(bits, sizeof(T), dest, width);
+  }
+
+  inline void EncodeUnsigned(uint64_t value, char *dest, uint32_t width) {
+    EncodeBytes(value, sizeof(uint64_t), dest, width);
+  }
+
+  // write the low size bytes of value big-endian, as far as they fit into the bytes left in the key
+  inline void EncodeBytes(uint64_t value, uint32_t size, char *dest, uint32_t width) {
+    uint32_t left = static_cast<uint32_t>(data_ + KeySize - dest);
+    for (uint32_t i = 0; i < size && i < width && i < left; i++) {
+      dest[i] = static_cast<char>(value >> (8 * (size - 1 - i)));
+    }
+  }
+
+  inline uint64_t DecodeUnsigned(uint32_t offset, uint32_t width, uint32_t size) const {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; i++) {
+      uint8_t byte = i < width && offset + i < KeySize ? static_cast<uint8_t>(data_[offset + i]) : 0;
+      value = (value << 8) | byte;
+    }
+    return value;
+  }
+
+  inline int64_t DecodeSigned(uint32_t offset, uint32_t width, uint32_t size) const {
+    uint64_t bits = DecodeUnsigned(offset, width, size) ^ (1ULL << (size * 8 - 1));
+    // sign extend from size bytes
+    uint32_t shift = 64 - size * 8;
+    return static_cast<int64_t>(bits << shift) >> shift;
+  }
 };
 
 /**
  * Function object returns true if lhs < rhs, used for trees
+ *
+ * The keys are encoded by GenericKey so that their bytes sort like their values, the key schema is not needed to
+ * compare them.
  */
 template <size_t KeySize>
 class GenericComparator {
  public:
   inline int operator()(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs) const {
-    uint32_t column_count = key_schema_->GetColumnCount();
-
-    for (uint32_t i = 0; i < column_count; i++) {
-      Value lhs_value = (lhs.ToValue(key_schema_, i));
-      Value rhs_value = (rhs.ToValue(key_schema_, i));
-
-      if (lhs_value.CompareLessThan(rhs_value) == CmpBool::CmpTrue) {
-        return -1;
-      }
-      if (lhs_value.CompareGreaterThan(rhs_value) == CmpBool::CmpTrue) {
-        return 1;
-      }
-    }
-    // equals
-    return 0;
+    int cmp = memcmp(lhs.data_, rhs.data_, KeySize);
+    return static_cast<int>(cmp > 0) - static_cast<int>(cmp < 0);
   }
 
-  GenericComparator(const GenericComparator &other) : key_schema_{other.key_schema_} {}
+  GenericComparator(const GenericComparator &other) = default;
 
   // constructor
-  explicit GenericComparator(Schema *key_schema) : key_schema_(key_schema) {}
-
- private:
-  Schema *key_schema_;
+  explicit GenericComparator(Schema * /* key_schema */) {}
 };
 
 }  // namespace bustub
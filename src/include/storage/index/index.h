@@ -43,10 +43,14 @@ class IndexMetadata {
    * @param table_name The name of the table on which the index is created
    * @param tuple_schema The schema of the indexed key
    * @param key_attrs The mapping from indexed columns to base table columns
+   * @param is_unique Whether a key identifies at most one entry, a non-unique index holds an entry per rid
    */
   IndexMetadata(std::string index_name, std::string table_name, const Schema *tuple_schema,
-                std::vector<uint32_t> key_attrs)
-      : name_(std::move(index_name)), table_name_(std::move(table_name)), key_attrs_(std::move(key_attrs)) {
+                std::vector<uint32_t> key_attrs, bool is_unique = true)
+      : name_(std::move(index_name)),
+        table_name_(std::move(table_name)),
+        key_attrs_(std::move(key_attrs)),
+        is_unique_(is_unique) {
     key_schema_ = Schema::CopySchema(tuple_schema, key_attrs_);
   }
 
@@ -72,6 +76,9 @@ class IndexMetadata {
   /** @return The mapping relation between indexed columns and base table columns */
   inline const std::vector<uint32_t> &GetKeyAttrs() const { return key_attrs_; }
 
+  /** @return Whether a key identifies at most one entry */
+  inline bool IsUnique() const { return is_unique_; }
+
   /** @return A string representation for debugging */
   std::string ToString() const {
     std::stringstream os;
@@ -92,6 +99,8 @@ class IndexMetadata {
   std::string table_name_;
   /** The mapping relation between key schema and tuple schema */
   const std::vector<uint32_t> key_attrs_;
+  /** Whether a key identifies at most one entry */
+  const bool is_unique_;
   /** The schema of the indexed key */
   Schema *key_schema_;
 };
@@ -139,6 +148,9 @@ class Index {
   /** @return The index key attributes */
   const std::vector<uint32_t> &GetKeyAttrs() const { return metadata_->GetKeyAttrs(); }
 
+  /** @return Whether a key identifies at most one entry */
+  bool IsUnique() const { return metadata_->IsUnique(); }
+
   /** @return A string representation for debugging */
   std::string ToString() const {
     std::stringstream os;
@@ -152,9 +164,10 @@ class Index {
   ///////////////////////////////////////////////////////////////////
 
   /**
-   * Insert an entry into the index.
+   * Insert an entry into the index. A unique index keeps the entry it already has for the key.
    * @param key The index key
-   * @param rid The RID associated with the key (unused)
+   * @param rid The RID associated with the key, a non-unique index adds it to the key to keep the entries of equal
+   * keys apart
    * @param transaction The transaction context
    */
   virtual void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) = 0;
@@ -162,11 +175,18 @@ class Index {
   /**
    * Delete an index entry by key.
    * @param key The index key
-   * @param rid The RID associated with the key (unused)
+   * @param rid The RID associated with the key, a non-unique index deletes the entry of this RID only
    * @param transaction The transaction context
    */
   virtual void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) = 0;
 
+  /**
+   * Rebuild an index key from the key bytes as the index stores them, e.g. as found in the log.
+   * @param key_data The stored key
+   * @return The index key, which InsertEntry and DeleteEntry store as the same bytes again
+   */
+  virtual Tuple KeyFromStoredKey(const char *key_data) const = 0;
+
   /**
    * Search the index for the provided key.
    * @param key The index key
@@ -175,6 +195,21 @@ class Index {
    */
   virtual void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) = 0;
 
+  /**
+   * Search the index for a batch of keys, e.g. the inner side of an index nested loop join or an IN list. Indexes that
+   * can share the work of one search with the next override this, the keys are searched one by one otherwise.
+   * @param keys The index keys, in any order and possibly repeated
+   * @param results Set to one collection of RIDs per key, in the order of the keys
+   * @param transaction The transaction context
+   */
+  virtual void ScanKeys(const std::vector<Tuple> &keys, std::vector<std::vector<RID>> *results,
+                        Transaction *transaction) {
+    results->assign(keys.size(), std::vector<RID>());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ScanKey(keys[i], &(*results)[i], transaction);
+    }
+  }
+
  private:
   /** The Index structure owns its metadata */
   std::unique_ptr<IndexMetadata> metadata_;
@@ -19,6 +19,9 @@ namespace bustub {
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 #define KVC KeyType, ValueType, KeyComparator
 
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTree;
+
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
  public:
@@ -26,7 +29,15 @@ class IndexIterator {
   IndexIterator();
   ~IndexIterator();
 
-  IndexIterator(Page *page, int start, BufferPoolManager *buffer_pool_manager);
+  // an iterator with an end key stops before the first entry that is not smaller, a reverse one, which goes from
+  // larger keys to smaller ones, before the first entry that is smaller
+  IndexIterator(BPlusTree<KVC> *tree, Page *page, int start, const KeyType *end_key = nullptr, bool reverse = false);
+
+  // an iterator holds the latch and pin of its leaf until it moves past it or goes away, so it is only moved
+  IndexIterator(IndexIterator &&other) noexcept;
+  IndexIterator &operator=(IndexIterator &&other) noexcept;
+  IndexIterator(const IndexIterator &other) = delete;
+  IndexIterator &operator=(const IndexIterator &other) = delete;
 
   bool isEnd() const;
 
@@ -55,11 +66,21 @@ class IndexIterator {
   int GetIndex() const { return cur_idx_; }
 
  private:
+  void SkipFinishedLeaves();
+  void SkipFinishedLeavesReverse();
+  void Release();
+
   // add your own private member variables here
   Page *page_;
   BPlusTreeLeafPage<KVC> *cur_node_;
   int cur_idx_;
+  MappingType item_;
+  BPlusTree<KVC> *tree_;
   BufferPoolManager *buffer_pool_manager_;
+  const KeyComparator *comparator_;
+  bool has_end_key_;
+  KeyType end_key_;
+  bool reverse_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_page_log.h
+//
+// Identification: src/include/storage/index/index_page_log.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
+
+namespace bustub {
+
+/**
+ * IndexPageLog writes ahead the page changes of one B+ tree insert or remove, splits, merges and root changes
+ * included, as a single INDEXINSERT/INDEXDELETE record, so that recovery never sees half of a structure change.
+ *
+ * A page is registered with Track() before it is first modified, which pins it and keeps a copy of its bytes. Flush()
+ * logs the bytes that changed since then and stamps the pages with the record's lsn; it has to run while the
+ * operation still holds the latches of the pages it changed. Helpers that do not know about the operation, like the
+ * page classes re-parenting children, reach it through TrackCurrent().
+ *
+ * Nothing is tracked while logging is disabled.
+ */
+class IndexPageLog {
+ public:
+  /**
+   * Start logging an index operation on the calling thread.
+   * @param log_record_type INDEXINSERT or INDEXDELETE
+   * @param index_name name of the index, used to find it again for undo
+   * @param transaction the transaction on whose behalf the index is changed, may be nullptr for redo only changes
+   */
+  IndexPageLog(LogRecordType log_record_type, std::string index_name, BufferPoolManager *buffer_pool_manager,
+               LogManager *log_manager, Transaction *transaction);
+
+  /** Unpin the tracked pages and stop logging on the calling thread. Changes not flushed are not logged. */
+  ~IndexPageLog();
+
+  /** Set the entry that is inserted or removed, which undo inserts or removes again. */
+  void SetEntry(const void *key, size_t key_size, const RID &rid);
+
+  /** Register a page of the operation before it is modified, no-op if it is already tracked. */
+  void Track(page_id_t page_id);
+
+  /** Log the changes of all tracked pages as one record. No record is written if nothing changed. */
+  void Flush();
+
+  /** Track a page for the operation running on the calling thread, if any. */
+  static void TrackCurrent(page_id_t page_id);
+
+  /** Flush the operation running on the calling thread, if any. */
+  static void FlushCurrent();
+
+  /** Overwrite a page with the ranges of a delta built by Flush(). */
+  static void ApplyDelta(char *page_data, const std::vector<char> &delta);
+
+ private:
+  /** Encode the bytes that differ between two page images as | offset | length | new bytes | ranges. */
+  static void EncodeDelta(const char *before, const char *after, std::vector<char> *delta);
+
+  LogRecordType log_record_type_;
+  std::string index_name_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
+  Transaction *transaction_;
+  std::vector<char> key_;
+  RID rid_;
+  struct TrackedPage {
+    Page *page_;
+    /** Bytes of the page as of the last flush. */
+    std::unique_ptr<char[]> image_;
+    bool is_dirty_;
+  };
+  /** Pinned pages of the operation. */
+  std::vector<TrackedPage> pages_;
+  /** The operation this one is nested in on the same thread, restored on destruction. */
+  IndexPageLog *outer_;
+
+  static thread_local IndexPageLog *current;
+};
+
+}  // namespace bustub
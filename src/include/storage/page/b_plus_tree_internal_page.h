@@ -17,8 +17,9 @@
 namespace bustub {
 
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
-#define INTERNAL_PAGE_HEADER_SIZE 24
-#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(MappingType)))
+#define INTERNAL_PAGE_HEADER_SIZE 32
+// as many children as fit if the keys of a page share all but their last byte, pages hold fewer unless they do
+#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE - 2 * sizeof(KeyType)) / (1 + sizeof(ValueType)))
 /**
  * Store n indexed keys and n+1 child pointers (page_id) within internal page.
  * Pointer PAGE_ID(i) points to a subtree in which all keys K satisfy:
@@ -27,10 +28,18 @@ namespace bustub {
  * the first key always remains invalid. That is to say, any search/lookup
  * should ignore the first key.
  *
+ * Like leaf pages, internal pages are linked to their right sibling and carry
+ * fence keys: all keys K in the subtrees satisfy LOW_KEY <= K < HIGH_KEY, so a
+ * reader that reaches the page after a concurrent split follows the link to
+ * the right. The first page of each level has the smallest key as its low key,
+ * the last one the largest as its high key. The keys are stored without the
+ * prefix the fences share, like in leaf pages (see BPlusTreeLeafPage), the
+ * first key is the low key once the page is split off.
+ *
  * Internal page format (keys are stored in increasing order):
- *  --------------------------------------------------------------------------
- * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
- *  --------------------------------------------------------------------------
+ *  ------------------------------------------------------------------------------------------------------
+ * | HEADER | NEXT_PAGE_ID | PREFIX_SIZE | LOW_KEY | HIGH_KEY | SUFFIX(1)+PAGE_ID(1) | ... | SUFFIX(n)+PAGE_ID(n) |
+ *  ------------------------------------------------------------------------------------------------------
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
@@ -43,6 +52,16 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   void SetValueAt(int index, const ValueType &value);
   int ValueIndex(const ValueType &value) const;
   ValueType ValueAt(int index) const;
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  KeyType GetLowKey() const;
+  void SetLowKey(const KeyType &low_key);
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &high_key);
+  bool IsPastHighKey(const KeyType &key, const KeyComparator &comparator) const;
+  int GetPrefixSize() const;
+  int GetCapacity() const;
+  int CapacityFor(const KeyType &low_key, const KeyType &high_key) const;
 
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
@@ -59,9 +78,17 @@ class BPlusTreeInternalPage : public BPlusTreePage {
                          BufferPoolManager *buffer_pool_manager);
 
  private:
-  void CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
-  MappingType array_[0];
+  int SlotSize() const;
+  char *SlotAt(int index);
+  const char *SlotAt(int index) const;
+  MappingType ItemAt(int index) const;
+  void UpdatePrefix(const KeyType &old_fence);
+  page_id_t next_page_id_;
+  int prefix_size_;
+  KeyType low_key_;
+  KeyType high_key_;
+  char slots_[0];
 };
 }  // namespace bustub
@@ -18,8 +18,9 @@
 namespace bustub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
-#define LEAF_PAGE_HEADER_SIZE 28
-#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
+#define LEAF_PAGE_HEADER_SIZE 36
+// as many entries as fit if the keys of a page share all but their last byte, pages hold fewer unless they do
+#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - 2 * sizeof(KeyType)) / (1 + sizeof(ValueType)))
 
 /**
  * Store indexed key and record id(record id = page id combined with slot id,
@@ -27,17 +28,33 @@ namespace bustub {
  * page. Only support unique key.
  *
  * Leaf page format (keys are stored in order):
- *  ----------------------------------------------------------------------
- * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
- *  ----------------------------------------------------------------------
+ *  --------------------------------------------------------------------------------------
+ * | HEADER | LOW_KEY | HIGH_KEY | SUFFIX(1) + RID(1) | SUFFIX(2) + RID(2) | ... | SUFFIX(n) + RID(n)
+ *  --------------------------------------------------------------------------------------
  *
- *  Header format (size in byte, 28 bytes in total):
+ * All keys K in the page satisfy LOW_KEY <= K < HIGH_KEY, larger keys belong to
+ * the pages right of it. The first leaf has the smallest key (all zero bytes)
+ * as its low key, the last one the largest (all 0xff bytes) as its high key.
+ *
+ * Keys compare by their bytes (see GenericComparator), so every key between the
+ * two fence keys starts with the bytes the fences have in common. The page
+ * stores that prefix once, in its low key, and only the rest of each key in the
+ * slots. The slots of a page all have the same size, KeySize - PrefixSize +
+ * sizeof(RID), so the narrower the range of keys of a page, the more entries it
+ * holds: a page holds GetCapacity() entries, no more than its max size. Moving
+ * a fence re-encodes the slots.
+ *
+ *  Header format (size in byte, 36 bytes in total):
  *  ---------------------------------------------------------------------
  * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
  *  ---------------------------------------------------------------------
- *  -----------------------------------------------
- * | ParentPageId (4) | PageId (4) | NextPageId (4)
- *  -----------------------------------------------
+ *  ----------------------------------------------------------------------------------
+ * | ParentPageId (4) | PageId (4) | NextPageId (4) | PrevPageId (4) | PrefixSize (4)
+ *  ----------------------------------------------------------------------------------
+ *
+ * Leaves are linked both ways. The left link is for scans that go backwards; it is
+ * only changed while the page right of it is latched too, but readers check it
+ * against the fence keys all the same (see IndexIterator).
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeLeafPage : public BPlusTreePage {
@@ -48,9 +65,20 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  page_id_t GetPrevPageId() const;
+  void SetPrevPageId(page_id_t prev_page_id);
+  KeyType GetLowKey() const;
+  void SetLowKey(const KeyType &low_key);
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &high_key);
+  bool IsPastHighKey(const KeyType &key, const KeyComparator &comparator) const;
+  int GetPrefixSize() const;
+  int GetCapacity() const;
+  int CapacityFor(const KeyType &low_key, const KeyType &high_key) const;
   KeyType KeyAt(int index) const;
+  int LowerBound(const KeyType &key, const KeyComparator &comparator) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
-  const MappingType &GetItem(int index);
+  MappingType GetItem(int index) const;
 
   // insert and delete methods
   int Insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator);
@@ -62,12 +90,21 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   void MoveAllTo(BPlusTreeLeafPage *recipient);
   void MoveFirstToEndOf(BPlusTreeLeafPage *recipient);
   void MoveLastToFrontOf(BPlusTreeLeafPage *recipient);
+  void CopyNFrom(const MappingType *items, int size);
 
  private:
-  void CopyNFrom(MappingType *items, int size);
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item);
+  int SlotSize() const;
+  char *SlotAt(int index);
+  const char *SlotAt(int index) const;
+  void SetItemAt(int index, const KeyType &key, const ValueType &value);
+  void UpdatePrefix(const KeyType &old_fence);
   page_id_t next_page_id_;
-  MappingType array_[0];
+  page_id_t prev_page_id_;
+  int prefix_size_;
+  KeyType low_key_;
+  KeyType high_key_;
+  char slots_[0];
 };
 }  // namespace bustub
@@ -44,6 +44,7 @@ class BPlusTreePage {
  public:
   bool IsLeafPage() const;
   bool IsRootPage() const;
+  bool IsDeletedPage() const;
   void SetPageType(IndexPageType page_type);
 
   int GetSize() const;
@@ -64,6 +65,12 @@ class BPlusTreePage {
 
   static void UpdateChildParentId(page_id_t page_id, page_id_t parent_id, BufferPoolManager *buffer_pool_manager);
 
+ protected:
+  // prefix compression of the keys of leaf and internal pages, see BPlusTreeLeafPage
+  static int CommonPrefixSize(const char *lhs, const char *rhs, int key_size);
+  static void ResizeSlots(char *slots, int count, int key_size, int value_size, const char *prefix,
+                          int old_prefix_size, int new_prefix_size);
+
  private:
   // member variable, attributes that both internal and leaf page share
   IndexPageType page_type_ __attribute__((__unused__));
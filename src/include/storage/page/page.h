@@ -87,6 +87,8 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** A lower bound of the LSN of the first update since the page was last clean, i.e. its dirty page table entry. */
+  lsn_t rec_lsn_ = INVALID_LSN;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <cstring>
+#include <vector>
 
 #include "common/rid.h"
 #include "concurrency/lock_manager.h"
@@ -106,6 +107,18 @@ class TablePage : public Page {
   bool UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
                    LockManager *lock_manager, LogManager *log_manager);
 
+  /**
+   * Update a tuple in place by overwriting the byte ranges of a delta, the tuple keeps its length.
+   * @param delta changed byte ranges as encoded by Tuple::EncodeDelta
+   * @param rid rid of the tuple
+   * @param txn transaction performing the update
+   * @param lock_manager the lock manager
+   * @param log_manager the log manager
+   * @return true if updating the tuple succeeded
+   */
+  bool UpdateTupleDelta(const std::vector<char> &delta, const RID &rid, Transaction *txn, LockManager *lock_manager,
+                        LogManager *log_manager);
+
   /** To be called on commit or abort. Actually perform the delete or rollback an insert. */
   void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
 
@@ -122,20 +135,30 @@ class TablePage : public Page {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
 
+  /**
+   * Copy out a tuple without locking it, for snapshot reads that find their version themselves.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @return true if the slot holds a tuple that is not deleted
+   */
+  bool ReadTuple(const RID &rid, Tuple *tuple);
+
   /** @return the rid of the first tuple in this page */
 
   /**
    * @param[out] first_rid the RID of the first tuple in this page
+   * @param include_empty also stop at slots without a live tuple, which may still have older versions
    * @return true if the first tuple exists, false otherwise
    */
-  bool GetFirstTupleRid(RID *first_rid);
+  bool GetFirstTupleRid(RID *first_rid, bool include_empty = false);
 
   /**
    * @param cur_rid the RID of the current tuple
    * @param[out] next_rid the RID of the tuple following the current tuple
+   * @param include_empty also stop at slots without a live tuple, which may still have older versions
    * @return true if the next tuple exists, false otherwise
    */
-  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
+  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool include_empty = false);
 
  private:
   static_assert(sizeof(page_id_t) == 4);
@@ -12,7 +12,10 @@
 
 #pragma once
 
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
+#include "concurrency/version_store.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
 #include "storage/table/table_iterator.h"
@@ -60,7 +63,8 @@ class TableHeap {
   bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn);
 
   /**
-   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
+   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called. An optimistic transaction only
+   * buffers the delete until it commits.
    * @param rid resource id of the tuple of delete
    * @param txn transaction performing the delete
    * @return true iff the delete is successful (i.e the tuple exists)
@@ -68,7 +72,8 @@ class TableHeap {
   bool MarkDelete(const RID &rid, Transaction *txn);  // for delete
 
   /**
-   * if the new tuple is too large to fit in the old page, return false (will delete and insert)
+   * if the new tuple is too large to fit in the old page, return false (will delete and insert). An optimistic
+   * transaction only buffers the update until it commits.
    * @param tuple new tuple
    * @param rid rid of the old tuple
    * @param txn transaction performing the update
@@ -90,6 +95,56 @@ class TableHeap {
    */
   void RollbackDelete(const RID &rid, Transaction *txn);
 
+  /**
+   * Called on abort to rollback an update that kept the tuple length.
+   * @param delta changed byte ranges of the update, as kept in the write set
+   * @param rid rid of the updated tuple
+   * @param txn transaction performing the rollback
+   */
+  void RollbackUpdate(const std::vector<char> &delta, const RID &rid, Transaction *txn);
+
+  /**
+   * Called on abort to rollback an insert. Unlike ApplyDelete, this also drops the version the insert created before
+   * the slot can be reused.
+   * @param rid rid of the inserted tuple
+   * @param txn transaction performing the rollback
+   */
+  void RollbackInsert(const RID &rid, Transaction *txn);
+
+  /**
+   * Called on commit to make the versions a transaction wrote visible to the snapshots taken from now on.
+   * @param rid rid of the written tuple
+   * @param txn the committing transaction
+   * @param commit_ts commit timestamp of the transaction
+   */
+  void CommitVersion(const RID &rid, Transaction *txn, timestamp_t commit_ts) { versions_.Commit(rid, txn, commit_ts); }
+
+  /**
+   * Called on abort, after the write set is rolled back, to drop the versions a transaction wrote.
+   * @param rid rid of the written tuple
+   * @param txn the aborting transaction
+   */
+  void AbortVersion(const RID &rid, Transaction *txn) { versions_.Abort(rid, txn); }
+
+  /**
+   * Drop the old versions of a tuple that no running snapshot can see anymore.
+   * @param rid rid of the tuple
+   * @param watermark read timestamp of the oldest running snapshot
+   */
+  void CollectVersion(const RID &rid, timestamp_t watermark) { versions_.Collect(rid, watermark); }
+
+  /**
+   * Called on commit of an optimistic transaction, once its writes are in the table heap.
+   * @param rid rid of the tuple that was read
+   * @param txn the committing transaction
+   * @param ts commit timestamp of the version that was read
+   * @return true if the tuple has not been written by another transaction since it was read
+   */
+  bool ValidateRead(const RID &rid, Transaction *txn, timestamp_t ts) { return versions_.Validate(rid, txn, ts); }
+
+  /** @return the number of tuples that have old versions kept around */
+  size_t VersionCount() { return versions_.Size(); }
+
   /**
    * Read a tuple from the table.
    * @param rid rid of the tuple to read
@@ -105,14 +160,24 @@ class TableHeap {
   /** @return the end iterator of this table */
   TableIterator End();
 
+
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
  private:
+  /**
+   * Buffer an update or delete of an optimistic transaction that has not reached its commit yet.
+   * @param[out] result the result of the buffered write
+   * @return false if the transaction writes in place
+   */
+  bool BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn, bool *result);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  /** Older versions of the tuples, read by snapshot isolation transactions. */
+  VersionStore versions_;
 };
 
 }  // namespace bustub
@@ -56,6 +56,15 @@ class TableIterator {
   }
 
  private:
+  /**
+   * Move to the next slot, or the next tuple unless include_empty is set, and read it.
+   * @return false if the slot has no tuple visible to the transaction
+   */
+  bool Step(bool include_empty);
+
+  /** @return true if the scan reads versions, it then skips the slots without a visible version */
+  bool ReadsVersions() const { return txn_ != nullptr && txn_->ReadsVersions(); }
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
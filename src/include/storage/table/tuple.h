@@ -61,6 +61,19 @@ class Tuple {
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
 
+  /**
+   * Encode the bytes that differ between two tuples of the same length as a list of ranges
+   * | offset | length | old_bytes | new_bytes |, with offset and length as uint16_t.
+   * Ranges that are close together are merged when that is shorter than logging them apart.
+   */
+  static void EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::vector<char> *delta);
+
+  // Swap the old and new bytes of every range, which turns a delta into its own undo
+  static std::vector<char> ReverseDelta(const std::vector<char> &delta);
+
+  // Overwrite the tuple data at tuple_data with the new bytes of every range
+  static void ApplyDelta(char *tuple_data, const std::vector<char> &delta);
+
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
 
@@ -12,7 +12,52 @@
 
 #include "recovery/log_manager.h"
 
+#include <cstring>
+#include <iterator>
+
 namespace bustub {
+
+LogManager::LogManager(DiskManager *disk_manager)
+    : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+  log_buffer_ = new char[LOG_BUFFER_SIZE];
+  flush_buffer_ = new char[LOG_BUFFER_SIZE];
+  log_size_ = disk_manager_->GetLogEnd();
+
+  log_offset_t offset;
+  lsn_t lsn;
+  if (!disk_manager_->GetLastLogSegment(&offset, &lsn) || lsn == INVALID_LSN) {
+    return;
+  }
+  // records never straddle a segment, so the first one that does not parse or skips an lsn is the end of the log
+  char header[LogRecord::HEADER_SIZE];
+  log_offset_t checkpoint_offset = disk_manager_->ReadMasterRecord();
+  if (checkpoint_offset > offset && disk_manager_->ReadLog(header, LogRecord::HEADER_SIZE, checkpoint_offset)) {
+    // the last checkpoint is known to be complete, walk from there instead
+    lsn_t checkpoint_lsn;
+    memcpy(&checkpoint_lsn, header + 4, sizeof(lsn_t));
+    if (checkpoint_lsn > lsn) {
+      offset = checkpoint_offset;
+      lsn = checkpoint_lsn;
+    }
+  }
+  while (offset % LOG_SEGMENT_SIZE + LogRecord::HEADER_SIZE <= LOG_SEGMENT_SIZE &&
+         disk_manager_->ReadLog(header, LogRecord::HEADER_SIZE, offset)) {
+    int32_t size;
+    lsn_t record_lsn;
+    memcpy(&size, header, sizeof(int32_t));
+    memcpy(&record_lsn, header + 4, sizeof(lsn_t));
+    if (size < LogRecord::HEADER_SIZE || offset % LOG_SEGMENT_SIZE + size > LOG_SEGMENT_SIZE || record_lsn != lsn) {
+      break;
+    }
+    offset += size;
+    lsn++;
+  }
+  next_lsn_ = lsn;
+  persistent_lsn_ = lsn - 1;
+  log_size_ = offset;
+  disk_manager_->SetLogEnd(offset);
+}
+
 /*
  * set enable_logging = true
  * Start a separate thread to execute flush to disk operation periodically
@@ -22,33 +67,290 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (enable_logging) {
+      cv_.wait_for(lock, log_timeout, [this] { return need_flush_ || !enable_logging; });
+      // the last round also drains whatever was appended before StopFlushThread
+      FlushBuffer(&lock);
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    enable_logging = false;
+  }
+  cv_.notify_one();
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+}
+
+/*
+ * swap log_buffer_ with flush_buffer_ and write the latter out
+ * the latch is released during the write so that appenders can keep filling the other buffer, a null lock means the
+ * caller has no flush thread and keeps the latch for the whole write
+ */
+void LogManager::FlushBuffer(std::unique_lock<std::mutex> *lock) {
+  need_flush_ = false;
+  if (offset_ == 0) {
+    flushed_cv_.notify_all();
+    return;
+  }
+  std::swap(log_buffer_, flush_buffer_);
+  int size = offset_;
+  lsn_t first_lsn = buffer_first_lsn_;
+  lsn_t last_lsn = next_lsn_ - 1;
+  offset_ = 0;
+  // a batch that does not fit in the current segment starts the next one, see AppendLogRecord
+  if (log_size_ % LOG_SEGMENT_SIZE + size > LOG_SEGMENT_SIZE) {
+    log_size_ += LOG_SEGMENT_SIZE - log_size_ % LOG_SEGMENT_SIZE;
+  }
+  log_size_ += size;
+
+  if (lock != nullptr) {
+    lock->unlock();
+  }
+  disk_manager_->WriteLog(flush_buffer_, size, first_lsn);
+  if (lock != nullptr) {
+    lock->lock();
+  }
+  persistent_lsn_ = last_lsn;
+  flushed_cv_.notify_all();
+}
+
+/*
+ * block until everything appended before the call is durable, this is how
+ * commits and the buffer pool (WAL rule) wait for the log
+ */
+void LogManager::Flush(bool force) {
+  std::unique_lock<std::mutex> lock(latch_);
+  if (flush_thread_ == nullptr) {
+    FlushBuffer(nullptr);
+    return;
+  }
+  lsn_t lsn = next_lsn_ - 1;
+  while (persistent_lsn_ < lsn) {
+    if (force) {
+      need_flush_ = true;
+      cv_.notify_one();
+    }
+    flushed_cv_.wait(lock);
+  }
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
  *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
+ * the record is serialized in the layout documented in log_record.h, and the
+ * end of each transaction's chain is tracked here so that checkpoints can take
+ * the active transaction table without asking the transaction manager
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  std::unique_lock<std::mutex> lock(latch_);
+  // the buffer is written out as one piece that must fit in a single segment
+  while (offset_ + log_record->size_ > LOG_BUFFER_SIZE ||
+         (offset_ > 0 && log_size_ % LOG_SEGMENT_SIZE + offset_ + log_record->size_ > LOG_SEGMENT_SIZE)) {
+    if (flush_thread_ == nullptr) {
+      FlushBuffer(nullptr);
+      continue;
+    }
+    need_flush_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+
+  log_record->lsn_ = next_lsn_++;
+  if (offset_ == 0) {
+    if (log_size_ % LOG_SEGMENT_SIZE + log_record->size_ > LOG_SEGMENT_SIZE) {
+      log_size_ += LOG_SEGMENT_SIZE - log_size_ % LOG_SEGMENT_SIZE;
+    }
+    buffer_first_lsn_ = log_record->lsn_;
+    lsn_offsets_.emplace(log_record->lsn_, log_size_);
+  }
+
+  switch (log_record->log_record_type_) {
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+      active_txns_.erase(log_record->txn_id_);
+      break;
+    case LogRecordType::BEGIN_CHECKPOINT:
+      checkpoint_offset_ = log_size_ + offset_;
+      break;
+    case LogRecordType::END_CHECKPOINT:
+      break;
+    default: {
+      if (log_record->txn_id_ == INVALID_TXN_ID) {
+        // index changes made outside of any transaction are redo only
+        break;
+      }
+      auto it = active_txns_.find(log_record->txn_id_);
+      if (it == active_txns_.end()) {
+        active_txns_.emplace(log_record->txn_id_, std::make_pair(log_record->lsn_, log_record->lsn_));
+      } else {
+        it->second.second = log_record->lsn_;
+      }
+    }
+  }
+
+  // First, serialize the must have fields(20 bytes in total)
+  char *data = log_buffer_ + offset_;
+  memcpy(data, &log_record->size_, sizeof(int32_t));
+  memcpy(data + 4, &log_record->lsn_, sizeof(lsn_t));
+  memcpy(data + 8, &log_record->txn_id_, sizeof(txn_id_t));
+  memcpy(data + 12, &log_record->prev_lsn_, sizeof(lsn_t));
+  memcpy(data + 16, &log_record->log_record_type_, sizeof(LogRecordType));
+  int pos = LogRecord::HEADER_SIZE;
+
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(data + pos, &log_record->insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.SerializeTo(data + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(data + pos, &log_record->delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.SerializeTo(data + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(data + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.SerializeTo(data + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.SerializeTo(data + pos);
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      memcpy(data + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      auto delta_size = static_cast<int32_t>(log_record->delta_.size());
+      memcpy(data + pos, &delta_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(data + pos, log_record->delta_.data(), delta_size);
+      break;
+    }
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE: {
+      auto name_size = static_cast<int32_t>(log_record->index_name_.size());
+      memcpy(data + pos, &name_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(data + pos, log_record->index_name_.data(), name_size);
+      pos += name_size;
+      auto key_size = static_cast<int32_t>(log_record->index_key_.size());
+      memcpy(data + pos, &key_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(data + pos, log_record->index_key_.data(), key_size);
+      pos += key_size;
+      memcpy(data + pos, &log_record->index_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      auto page_count = static_cast<int32_t>(log_record->page_deltas_.size());
+      memcpy(data + pos, &page_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &delta : log_record->page_deltas_) {
+        auto delta_size = static_cast<int32_t>(delta.second.size());
+        memcpy(data + pos, &delta.first, sizeof(page_id_t));
+        memcpy(data + pos + sizeof(page_id_t), &delta_size, sizeof(int32_t));
+        pos += sizeof(page_id_t) + sizeof(int32_t);
+        memcpy(data + pos, delta.second.data(), delta_size);
+        pos += delta_size;
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      memcpy(data + pos, &log_record->prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(data + pos, &log_record->page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::END_CHECKPOINT: {
+      memcpy(data + pos, &log_record->scan_offset_, sizeof(log_offset_t));
+      pos += sizeof(log_offset_t);
+      auto att_size = static_cast<int32_t>(log_record->active_txn_table_.size());
+      memcpy(data + pos, &att_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &entry : log_record->active_txn_table_) {
+        memcpy(data + pos, &entry.first, sizeof(txn_id_t));
+        memcpy(data + pos + sizeof(txn_id_t), &entry.second, sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      auto dpt_size = static_cast<int32_t>(log_record->dirty_page_table_.size());
+      memcpy(data + pos, &dpt_size, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &entry : log_record->dirty_page_table_) {
+        memcpy(data + pos, &entry.first, sizeof(page_id_t));
+        memcpy(data + pos + sizeof(page_id_t), &entry.second, sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  offset_ += log_record->size_;
+  return log_record->lsn_;
+}
+
+log_offset_t LogManager::GetLogOffset(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (lsn >= next_lsn_) {
+    return log_size_ + offset_;
+  }
+  auto it = lsn_offsets_.upper_bound(lsn);
+  if (it == lsn_offsets_.begin()) {
+    // older than anything we know about, only the start of the log is safe
+    return disk_manager_->GetLogStart();
+  }
+  return std::prev(it)->second;
+}
+
+void LogManager::TruncateLog(lsn_t lsn) {
+  log_offset_t offset = GetLogOffset(lsn);
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    auto it = lsn_offsets_.upper_bound(lsn);
+    if (it != lsn_offsets_.begin()) {
+      lsn_offsets_.erase(lsn_offsets_.begin(), std::prev(it));
+    }
+  }
+  disk_manager_->TruncateLog(offset);
+}
+
+lsn_t LogManager::GetActiveTxnTable(std::unordered_map<txn_id_t, lsn_t> *active_txn_table) {
+  std::lock_guard<std::mutex> guard(latch_);
+  lsn_t oldest_lsn = next_lsn_;
+  for (const auto &entry : active_txns_) {
+    (*active_txn_table)[entry.first] = entry.second.second;
+    oldest_lsn = std::min(oldest_lsn, entry.second.first);
+  }
+  return oldest_lsn;
+}
+
+void LogManager::WriteMasterRecord() {
+  log_offset_t checkpoint_offset;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    checkpoint_offset = checkpoint_offset_;
+  }
+  if (checkpoint_offset >= 0) {
+    disk_manager_->WriteMasterRecord(checkpoint_offset);
+  }
+}
 
 }  // namespace bustub
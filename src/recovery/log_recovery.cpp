@@ -12,15 +12,303 @@
 
 #include "recovery/log_recovery.h"
 
+#include <cstring>
+#include <set>
+#include <unordered_set>
+
+#include "storage/index/index_page_log.h"
+#include "storage/page/b_plus_tree_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+/** @return the page a log record modifies, or INVALID_PAGE_ID for records that do not touch a page */
+static page_id_t GetRecordPageId(LogRecord *log_record) {
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      return log_record->GetInsertRID().GetPageId();
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return log_record->GetDeleteRID().GetPageId();
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      return log_record->GetUpdateRID().GetPageId();
+    case LogRecordType::NEWPAGE:
+      return log_record->GetNewPageId();
+    default:
+      return INVALID_PAGE_ID;
+  }
+}
+
+/** @return whether the length of a tuple serialized at pos and its data lie within a record of record_size bytes */
+static bool TupleFits(const char *data, int pos, int record_size) {
+  if (pos + static_cast<int>(sizeof(int32_t)) > record_size) {
+    return false;
+  }
+  int32_t length;
+  memcpy(&length, data + pos, sizeof(int32_t));
+  return length >= 0 && length <= record_size - pos - static_cast<int>(sizeof(int32_t));
+}
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, int size, LogRecord *log_record) {
+  if (size < LogRecord::HEADER_SIZE) {
+    return false;
+  }
+  int32_t record_size;
+  memcpy(&record_size, data, sizeof(int32_t));
+  if (record_size < LogRecord::HEADER_SIZE || record_size > size) {
+    return false;
+  }
+  LogRecordType type;
+  memcpy(&type, data + 16, sizeof(LogRecordType));
+  if (type <= LogRecordType::INVALID || type > LogRecordType::INDEXDELETE) {
+    return false;
+  }
+  log_record->size_ = record_size;
+  log_record->log_record_type_ = type;
+  memcpy(&log_record->lsn_, data + 4, sizeof(lsn_t));
+  memcpy(&log_record->txn_id_, data + 8, sizeof(txn_id_t));
+  memcpy(&log_record->prev_lsn_, data + 12, sizeof(lsn_t));
+  int pos = LogRecord::HEADER_SIZE;
+
+  switch (type) {
+    case LogRecordType::INSERT:
+      if (!TupleFits(data, pos + sizeof(RID), record_size)) {
+        return false;
+      }
+      memcpy(&log_record->insert_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      if (!TupleFits(data, pos + sizeof(RID), record_size)) {
+        return false;
+      }
+      memcpy(&log_record->delete_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::UPDATE:
+      if (!TupleFits(data, pos + sizeof(RID), record_size)) {
+        return false;
+      }
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.DeserializeFrom(data + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      if (!TupleFits(data, pos, record_size)) {
+        return false;
+      }
+      log_record->new_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      int32_t delta_size;
+      memcpy(&delta_size, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      if (delta_size < 0 || pos + delta_size > record_size) {
+        return false;
+      }
+      log_record->delta_.assign(data + pos, data + pos + delta_size);
+      break;
+    }
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE: {
+      int32_t name_size;
+      memcpy(&name_size, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      if (name_size < 0 || pos + name_size > record_size) {
+        return false;
+      }
+      log_record->index_name_.assign(data + pos, name_size);
+      pos += name_size;
+      int32_t key_size;
+      memcpy(&key_size, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      if (key_size < 0 || pos + key_size > record_size) {
+        return false;
+      }
+      log_record->index_key_.assign(data + pos, data + pos + key_size);
+      pos += key_size;
+      memcpy(&log_record->index_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      int32_t page_count;
+      memcpy(&page_count, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (int32_t i = 0; i < page_count; i++) {
+        page_id_t page_id;
+        int32_t delta_size;
+        memcpy(&page_id, data + pos, sizeof(page_id_t));
+        memcpy(&delta_size, data + pos + sizeof(page_id_t), sizeof(int32_t));
+        pos += sizeof(page_id_t) + sizeof(int32_t);
+        if (delta_size < 0 || pos + delta_size > record_size) {
+          return false;
+        }
+        log_record->page_deltas_.emplace_back(page_id, std::vector<char>(data + pos, data + pos + delta_size));
+        pos += delta_size;
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      memcpy(&log_record->prev_page_id_, data + pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(&log_record->page_id_, data + pos, sizeof(page_id_t));
+      break;
+    case LogRecordType::END_CHECKPOINT: {
+      memcpy(&log_record->scan_offset_, data + pos, sizeof(log_offset_t));
+      pos += sizeof(log_offset_t);
+      int32_t att_size;
+      memcpy(&att_size, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (int32_t i = 0; i < att_size; i++) {
+        txn_id_t txn_id;
+        lsn_t last_lsn;
+        memcpy(&txn_id, data + pos, sizeof(txn_id_t));
+        memcpy(&last_lsn, data + pos + sizeof(txn_id_t), sizeof(lsn_t));
+        log_record->active_txn_table_[txn_id] = last_lsn;
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      int32_t dpt_size;
+      memcpy(&dpt_size, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (int32_t i = 0; i < dpt_size; i++) {
+        page_id_t page_id;
+        lsn_t rec_lsn;
+        memcpy(&page_id, data + pos, sizeof(page_id_t));
+        memcpy(&rec_lsn, data + pos + sizeof(page_id_t), sizeof(lsn_t));
+        log_record->dirty_page_table_[page_id] = rec_lsn;
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+/*
+ * read the log sequentially from offset, prefetching LOG_BUFFER_SIZE bytes at
+ * a time; a record cut off at the end of the buffer is read again at the start
+ * of the next chunk, and a record that can't be parsed marks the end of the log
+ */
+void LogRecovery::ScanLog(log_offset_t offset, const std::function<bool(LogRecord *, log_offset_t)> &handler) {
+  // lsns are dense, anything else is the tail of a recycled segment file
+  lsn_t next_lsn = INVALID_LSN;
+  while (disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset)) {
+    int pos = 0;
+    while (true) {
+      LogRecord log_record;
+      if (!DeserializeLogRecord(log_buffer_ + pos, LOG_BUFFER_SIZE - pos, &log_record) ||
+          (next_lsn != INVALID_LSN && log_record.GetLSN() != next_lsn)) {
+        break;
+      }
+      if (!handler(&log_record, offset + pos)) {
+        return;
+      }
+      next_lsn = log_record.GetLSN() + 1;
+      pos += log_record.GetSize();
+    }
+    if (pos == 0) {
+      // a batch that did not fit at the end of a segment starts the next one
+      if (offset % LOG_SEGMENT_SIZE == 0) {
+        return;
+      }
+      offset += LOG_SEGMENT_SIZE - offset % LOG_SEGMENT_SIZE;
+      continue;
+    }
+    offset += pos;
+  }
+}
+
+bool LogRecovery::ReadLogRecord(log_offset_t offset, LogRecord *log_record) {
+  int32_t size;
+  if (!disk_manager_->ReadLog(reinterpret_cast<char *>(&size), sizeof(int32_t), offset)) {
+    return false;
+  }
+  if (size < 0 || size > LOG_BUFFER_SIZE || !disk_manager_->ReadLog(log_buffer_, size, offset)) {
+    return false;
+  }
+  return DeserializeLogRecord(log_buffer_, size, log_record);
+}
+
+/*
+ * analysis phase: start from the checkpoint named by the master record (or the
+ * beginning of the log without one) and roll the tables forward to the end of
+ * the log; the checkpoint is fuzzy, so records between its begin and end are
+ * scanned as usual and the snapshot in the end record only fills the gaps
+ */
+void LogRecovery::Analysis() {
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  dirty_page_table_.clear();
+  offset_ = disk_manager_->GetLogStart();
+
+  log_offset_t checkpoint_offset = disk_manager_->ReadMasterRecord();
+  LogRecord checkpoint;
+  if (checkpoint_offset < 0 || !ReadLogRecord(checkpoint_offset, &checkpoint) ||
+      checkpoint.GetLogRecordType() != LogRecordType::BEGIN_CHECKPOINT) {
+    checkpoint_offset = offset_;
+  }
+
+  // transactions that ended after the checkpoint began, the snapshot may still list them as active
+  std::unordered_set<txn_id_t> ended_txns;
+  ScanLog(checkpoint_offset, [this, &ended_txns](LogRecord *log_record, log_offset_t offset) {
+    lsn_t lsn = log_record->GetLSN();
+    lsn_mapping_[lsn] = offset;
+    switch (log_record->GetLogRecordType()) {
+      case LogRecordType::BEGIN_CHECKPOINT:
+        break;
+      case LogRecordType::END_CHECKPOINT:
+        for (const auto &entry : log_record->GetActiveTxnTable()) {
+          if (ended_txns.count(entry.first) == 0) {
+            active_txn_.emplace(entry.first, entry.second);
+          }
+        }
+        for (const auto &entry : log_record->GetDirtyPageTable()) {
+          auto it = dirty_page_table_.find(entry.first);
+          if (it == dirty_page_table_.end()) {
+            dirty_page_table_.emplace(entry.first, entry.second);
+          } else {
+            it->second = std::min(it->second, entry.second);
+          }
+        }
+        offset_ = log_record->GetScanOffset();
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record->GetTxnId());
+        ended_txns.insert(log_record->GetTxnId());
+        break;
+      case LogRecordType::INDEXINSERT:
+      case LogRecordType::INDEXDELETE:
+        // index changes made outside of a transaction have nothing to undo
+        if (log_record->GetTxnId() != INVALID_TXN_ID) {
+          active_txn_[log_record->GetTxnId()] = lsn;
+        }
+        for (const auto &delta : log_record->GetPageDeltas()) {
+          dirty_page_table_.emplace(delta.first, lsn);
+        }
+        break;
+      default:
+        active_txn_[log_record->GetTxnId()] = lsn;
+        page_id_t page_id = GetRecordPageId(log_record);
+        if (page_id != INVALID_PAGE_ID) {
+          dirty_page_table_.emplace(page_id, lsn);
+        }
+    }
+    return true;
+  });
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -28,13 +316,209 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *log buffer to reduce unnecessary I/O operations), remember to compare page's
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
+ *
+ *the analysis pass runs first, so redo only scans from the checkpoint's scan
+ *offset and only touches pages the dirty page table says may be stale
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  Analysis();
+
+  ScanLog(offset_, [this](LogRecord *log_record, log_offset_t offset) {
+    lsn_t lsn = log_record->GetLSN();
+    lsn_mapping_[lsn] = offset;
+
+    if (log_record->GetLogRecordType() == LogRecordType::NEWPAGE) {
+      // the link from the previous page is not logged separately, so it is repaired whenever it is missing
+      page_id_t prev_page_id = log_record->GetNewPageRecord();
+      if (prev_page_id != INVALID_PAGE_ID) {
+        auto *prev_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(prev_page_id));
+        bool relink = prev_page->GetNextPageId() != log_record->GetNewPageId();
+        if (relink) {
+          prev_page->SetNextPageId(log_record->GetNewPageId());
+        }
+        buffer_pool_manager_->UnpinPage(prev_page_id, relink);
+      }
+    }
+    if (log_record->GetLogRecordType() == LogRecordType::INDEXINSERT ||
+        log_record->GetLogRecordType() == LogRecordType::INDEXDELETE) {
+      RedoIndexPages(log_record);
+      return true;
+    }
+
+    page_id_t page_id = GetRecordPageId(log_record);
+    if (page_id == INVALID_PAGE_ID) {
+      return true;
+    }
+    auto it = dirty_page_table_.find(page_id);
+    if (it == dirty_page_table_.end() || lsn < it->second) {
+      return true;
+    }
+
+    auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    bool redo = page->GetLSN() < lsn;
+    switch (log_record->GetLogRecordType()) {
+      case LogRecordType::NEWPAGE:
+        // a page that never reached disk reads back as zeros, whose lsn says nothing
+        redo = redo || page->GetTablePageId() != page_id;
+        if (redo) {
+          page->Init(page_id, PAGE_SIZE, log_record->GetNewPageRecord(), nullptr, nullptr);
+        }
+        break;
+      case LogRecordType::INSERT:
+        if (redo) {
+          RID rid;
+          page->InsertTuple(log_record->GetInsertTuple(), &rid, nullptr, nullptr, nullptr);
+        }
+        break;
+      case LogRecordType::MARKDELETE:
+        if (redo) {
+          page->MarkDelete(log_record->GetDeleteRID(), nullptr, nullptr, nullptr);
+        }
+        break;
+      case LogRecordType::APPLYDELETE:
+        if (redo) {
+          page->ApplyDelete(log_record->GetDeleteRID(), nullptr, nullptr);
+        }
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        if (redo) {
+          page->RollbackDelete(log_record->GetDeleteRID(), nullptr, nullptr);
+        }
+        break;
+      case LogRecordType::UPDATE:
+        if (redo) {
+          Tuple old_tuple;
+          page->UpdateTuple(log_record->GetUpdateTuple(), &old_tuple, log_record->GetUpdateRID(), nullptr, nullptr,
+                            nullptr);
+        }
+        break;
+      case LogRecordType::DELTAUPDATE:
+        if (redo) {
+          page->UpdateTupleDelta(log_record->GetUpdateDelta(), log_record->GetUpdateRID(), nullptr, nullptr, nullptr);
+        }
+        break;
+      default:
+        break;
+    }
+    if (redo) {
+      page->SetLSN(lsn);
+    }
+    buffer_pool_manager_->UnpinPage(page_id, redo);
+    return true;
+  });
+}
+
+/*
+ * an index record carries the new bytes of every page of one tree operation,
+ * each page is brought up to date on its own like a table page
+ */
+void LogRecovery::RedoIndexPages(LogRecord *log_record) {
+  lsn_t lsn = log_record->GetLSN();
+  for (const auto &delta : log_record->GetPageDeltas()) {
+    page_id_t page_id = delta.first;
+    auto it = dirty_page_table_.find(page_id);
+    if (it == dirty_page_table_.end() || lsn < it->second) {
+      continue;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    // the header page keeps no lsn, replaying its changes in log order leaves it as the last one logged
+    bool redo = page_id == HEADER_PAGE_ID || page->GetLSN() < lsn ||
+                reinterpret_cast<BPlusTreePage *>(page->GetData())->GetPageId() != page_id;
+    if (redo) {
+      IndexPageLog::ApplyDelta(page->GetData(), delta.second);
+      if (page_id != HEADER_PAGE_ID) {
+        page->SetLSN(lsn);
+      }
+    }
+    buffer_pool_manager_->UnpinPage(page_id, redo);
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
+ *
+ *records of all losers are undone in one pass in descending lsn order, the
+ *same order in which they would have been rolled back at runtime
+ */
+void LogRecovery::Undo() {
+  std::set<lsn_t> to_undo;
+  for (const auto &entry : active_txn_) {
+    to_undo.insert(entry.second);
+  }
+
+  while (!to_undo.empty()) {
+    lsn_t lsn = *to_undo.rbegin();
+    to_undo.erase(lsn);
+    auto it = lsn_mapping_.find(lsn);
+    LogRecord log_record;
+    if (lsn == INVALID_LSN || it == lsn_mapping_.end() || !ReadLogRecord(it->second, &log_record)) {
+      continue;
+    }
+    if (log_record.GetPrevLSN() != INVALID_LSN) {
+      to_undo.insert(log_record.GetPrevLSN());
+    }
+
+    if (log_record.GetLogRecordType() == LogRecordType::INDEXINSERT ||
+        log_record.GetLogRecordType() == LogRecordType::INDEXDELETE) {
+      UndoIndexEntry(&log_record);
+      continue;
+    }
+
+    page_id_t page_id = GetRecordPageId(&log_record);
+    if (page_id == INVALID_PAGE_ID || log_record.GetLogRecordType() == LogRecordType::NEWPAGE) {
+      continue;
+    }
+    auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    switch (log_record.GetLogRecordType()) {
+      case LogRecordType::INSERT:
+        page->ApplyDelete(log_record.GetInsertRID(), nullptr, nullptr);
+        break;
+      case LogRecordType::MARKDELETE:
+        page->RollbackDelete(log_record.GetDeleteRID(), nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE: {
+        RID rid;
+        page->InsertTuple(log_record.GetDeleteTuple(), &rid, nullptr, nullptr, nullptr);
+        break;
+      }
+      case LogRecordType::ROLLBACKDELETE:
+        page->MarkDelete(log_record.GetDeleteRID(), nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE: {
+        Tuple new_tuple;
+        page->UpdateTuple(log_record.GetOriginalTuple(), &new_tuple, log_record.GetUpdateRID(), nullptr, nullptr,
+                          nullptr);
+        break;
+      }
+      case LogRecordType::DELTAUPDATE:
+        page->UpdateTupleDelta(Tuple::ReverseDelta(log_record.GetUpdateDelta()), log_record.GetUpdateRID(), nullptr,
+                               nullptr, nullptr);
+        break;
+      default:
+        break;
+    }
+    buffer_pool_manager_->UnpinPage(page_id, true);
+  }
+  active_txn_.clear();
+}
+
+/*
+ * the pages an index operation touched may have been split or merged again by
+ * later operations, so its entry is removed or put back through the index
  */
-void LogRecovery::Undo() {}
+void LogRecovery::UndoIndexEntry(LogRecord *log_record) {
+  auto it = indexes_.find(log_record->GetIndexName());
+  if (it == indexes_.end()) {
+    return;
+  }
+  // the log holds the key as the index stores it
+  Tuple key = it->second->KeyFromStoredKey(log_record->GetIndexKey().data());
+  if (log_record->GetLogRecordType() == LogRecordType::INDEXINSERT) {
+    it->second->DeleteEntry(key, log_record->GetIndexRID(), nullptr);
+  } else {
+    it->second->InsertEntry(key, log_record->GetIndexRID(), nullptr);
+  }
+}
 
 }  // namespace bustub
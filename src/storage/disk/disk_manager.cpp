@@ -11,10 +11,13 @@
 //===----------------------------------------------------------------------===//
 
 #include <sys/stat.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <mutex>  // NOLINT
+#include <random>
 #include <string>
 #include <thread>  // NOLINT
 
@@ -26,6 +29,17 @@ namespace bustub {
 
 static char *buffer_used;
 
+static constexpr uint32_t LOG_SEGMENT_MAGIC = 0x4c4f4753;
+
+/** The header at the start of every log segment file. */
+struct LogSegmentHeader {
+  uint32_t magic_;
+  uint32_t log_id_;
+  int32_t segment_;
+  lsn_t start_lsn_;
+};
+static_assert(sizeof(LogSegmentHeader) == DiskManager::LOG_SEGMENT_HEADER_SIZE);
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
@@ -38,19 +52,38 @@ DiskManager::DiskManager(const std::string &db_file)
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  master_name_ = file_name_.substr(0, n) + ".master";
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
+  // the log control file names the oldest live segment, live segments follow it without gaps
+  std::ifstream log_control(log_name_, std::ios::binary | std::ios::in);
+  if (log_control.is_open() && log_control.read(reinterpret_cast<char *>(&first_log_segment_), sizeof(int)) &&
+      log_control.read(reinterpret_cast<char *>(&log_id_), sizeof(uint32_t))) {
+    lsn_t start_lsn;
+    last_log_segment_ = first_log_segment_ - 1;
+    while (IsLiveLogSegment(last_log_segment_ + 1, &start_lsn)) {
+      last_log_segment_++;
     }
+  } else {
+    first_log_segment_ = 0;
+    last_log_segment_ = -1;
+    log_id_ = std::random_device()();
+    WriteLogControl();
+    // a checkpoint left over from an earlier log would point into the wrong file
+    remove(master_name_.c_str());
+  }
+  log_control.close();
+
+  if (last_log_segment_ < first_log_segment_) {
+    log_end_ = static_cast<log_offset_t>(first_log_segment_) * LOG_SEGMENT_SIZE;
+  } else {
+    // the log manager narrows this down to the last valid record, see SetLogEnd
+    int segment_size = GetFileSize(GetLogSegmentName(last_log_segment_)) - LOG_SEGMENT_HEADER_SIZE;
+    log_end_ = static_cast<log_offset_t>(last_log_segment_) * LOG_SEGMENT_SIZE +
+               std::clamp(segment_size, 0, LOG_SEGMENT_SIZE);
+  }
+  next_spare_segment_ = std::max(first_log_segment_, last_log_segment_ + 1);
+  while (GetFileSize(GetLogSegmentName(next_spare_segment_)) >= 0) {
+    next_spare_segment_++;
   }
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
@@ -78,7 +111,9 @@ void DiskManager::ShutDown() {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
   }
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
   log_io_.close();
+  log_read_io_.close();
 }
 
 /**
@@ -133,7 +168,7 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+void DiskManager::WriteLog(char *log_data, int size, lsn_t first_lsn) {
   // enforce swap log buffer
   assert(log_data != buffer_used);
   buffer_used = log_data;
@@ -141,6 +176,7 @@ void DiskManager::WriteLog(char *log_data, int size) {
   if (size == 0) {  // no effect on num_flushes_ if log buffer is empty
     return;
   }
+  assert(size <= LOG_SEGMENT_SIZE);
 
   flush_log_ = true;
 
@@ -149,8 +185,25 @@ void DiskManager::WriteLog(char *log_data, int size) {
     assert(flush_log_f_->wait_for(std::chrono::seconds(10)) == std::future_status::ready);
   }
 
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  auto segment = static_cast<int>(log_end_ / LOG_SEGMENT_SIZE);
+  auto pos = static_cast<int>(log_end_ % LOG_SEGMENT_SIZE);
+  if (pos + size > LOG_SEGMENT_SIZE) {
+    segment++;
+    pos = 0;
+  }
+  if (pos == 0) {
+    StartLogSegment(segment, first_lsn);
+  } else if (segment != log_write_segment_) {
+    // appending to the newest segment after a restart
+    log_io_.close();
+    log_io_.open(GetLogSegmentName(segment), std::ios::binary | std::ios::in | std::ios::out);
+    log_write_segment_ = segment;
+  }
+
   num_flushes_ += 1;
   // sequence write
+  log_io_.seekp(LOG_SEGMENT_HEADER_SIZE + pos);
   log_io_.write(log_data, size);
 
   // check for I/O error
@@ -160,6 +213,7 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
   // needs to flush to keep disk file in sync
   log_io_.flush();
+  log_end_ = static_cast<log_offset_t>(segment) * LOG_SEGMENT_SIZE + pos + size;
   flush_log_ = false;
 }
 
@@ -168,29 +222,179 @@ void DiskManager::WriteLog(char *log_data, int size) {
  * Always read from the beginning and perform sequence read
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+bool DiskManager::ReadLog(char *log_data, int size, log_offset_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  auto segment = static_cast<int>(offset / LOG_SEGMENT_SIZE);
+  if (offset >= log_end_ || segment < first_log_segment_) {
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
+  if (segment != log_read_segment_) {
+    log_read_io_.close();
+    log_read_io_.clear();
+    log_read_io_.open(GetLogSegmentName(segment), std::ios::binary | std::ios::in);
+    log_read_segment_ = log_read_io_.is_open() ? segment : -1;
+    if (log_read_segment_ == -1) {
+      LOG_DEBUG("missing log segment");
+      return false;
+    }
+  }
 
-  if (log_io_.bad()) {
+  // never read past the segment or past the end of the log, what follows may be left over from a recycled file
+  auto pos = static_cast<int>(offset % LOG_SEGMENT_SIZE);
+  auto count = static_cast<int>(std::min<log_offset_t>({size, LOG_SEGMENT_SIZE - pos, log_end_ - offset}));
+  log_read_io_.seekg(LOG_SEGMENT_HEADER_SIZE + pos);
+  log_read_io_.read(log_data, count);
+
+  if (log_read_io_.bad()) {
     LOG_DEBUG("I/O error while reading log");
     return false;
   }
   // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
+  int read_count = log_read_io_.gcount();
+  log_read_io_.clear();
   if (read_count < size) {
-    log_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
 
   return true;
 }
 
+bool DiskManager::GetLastLogSegment(log_offset_t *offset, lsn_t *start_lsn) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  if (last_log_segment_ < first_log_segment_) {
+    return false;
+  }
+  *offset = static_cast<log_offset_t>(last_log_segment_) * LOG_SEGMENT_SIZE;
+  return IsLiveLogSegment(last_log_segment_, start_lsn);
+}
+
+log_offset_t DiskManager::GetLogStart() {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return static_cast<log_offset_t>(first_log_segment_) * LOG_SEGMENT_SIZE;
+}
+
+log_offset_t DiskManager::GetLogEnd() {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  return log_end_;
+}
+
+void DiskManager::SetLogEnd(log_offset_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  log_end_ = offset;
+}
+
+/**
+ * Recycle every segment before the one holding offset, never the newest one
+ * The control file moves first, so a crash halfway leaves at worst a few
+ * unreferenced files behind rather than a log that starts at a missing segment
+ */
+void DiskManager::TruncateLog(log_offset_t offset) {
+  std::scoped_lock scoped_log_io_latch(log_io_latch_);
+  int keep = std::min(static_cast<int>(offset / LOG_SEGMENT_SIZE), last_log_segment_);
+  if (keep <= first_log_segment_) {
+    return;
+  }
+  int first = first_log_segment_;
+  first_log_segment_ = keep;
+  WriteLogControl();
+  for (int segment = first; segment < keep; segment++) {
+    if (log_read_segment_ == segment) {
+      log_read_io_.close();
+      log_read_segment_ = -1;
+    }
+    if (rename(GetLogSegmentName(segment).c_str(), GetLogSegmentName(next_spare_segment_).c_str()) == 0) {
+      next_spare_segment_++;
+    }
+  }
+}
+
+std::string DiskManager::GetLogSegmentName(int segment) const { return log_name_ + "." + std::to_string(segment); }
+
+bool DiskManager::IsLiveLogSegment(int segment, lsn_t *start_lsn) {
+  std::ifstream segment_io(GetLogSegmentName(segment), std::ios::binary | std::ios::in);
+  LogSegmentHeader header;
+  if (!segment_io.is_open() || !segment_io.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    return false;
+  }
+  *start_lsn = header.start_lsn_;
+  return header.magic_ == LOG_SEGMENT_MAGIC && header.log_id_ == log_id_ && header.segment_ == segment;
+}
+
+void DiskManager::StartLogSegment(int segment, lsn_t start_lsn) {
+  std::string segment_name = GetLogSegmentName(segment);
+  log_io_.close();
+  log_io_.clear();
+  // a spare left behind by TruncateLog is overwritten in place
+  log_io_.open(segment_name, std::ios::binary | std::ios::in | std::ios::out);
+  if (!log_io_.is_open()) {
+    log_io_.clear();
+    log_io_.open(segment_name, std::ios::binary | std::ios::trunc | std::ios::out);
+    log_io_.close();
+    log_io_.open(segment_name, std::ios::binary | std::ios::in | std::ios::out);
+    if (!log_io_.is_open()) {
+      throw Exception("can't open log segment file");
+    }
+  }
+  LogSegmentHeader header{LOG_SEGMENT_MAGIC, log_id_, segment, start_lsn};
+  log_io_.seekp(0);
+  log_io_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (log_read_segment_ == segment) {
+    log_read_io_.close();
+    log_read_segment_ = -1;
+  }
+  log_write_segment_ = segment;
+  last_log_segment_ = segment;
+  next_spare_segment_ = std::max(next_spare_segment_, segment + 1);
+}
+
+void DiskManager::WriteLogControl() {
+  // overwrite in place rather than truncating, so that a crash never leaves an empty control file
+  std::fstream log_control(log_name_, std::ios::binary | std::ios::in | std::ios::out);
+  if (!log_control.is_open()) {
+    log_control.clear();
+    log_control.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::out);
+    if (!log_control.is_open()) {
+      throw Exception("can't open dblog file");
+    }
+  }
+  log_control.write(reinterpret_cast<const char *>(&first_log_segment_), sizeof(int));
+  log_control.write(reinterpret_cast<const char *>(&log_id_), sizeof(uint32_t));
+  log_control.flush();
+  if (log_control.bad()) {
+    LOG_DEBUG("I/O error while writing log control file");
+  }
+}
+
+/**
+ * Write the offset of the last checkpoint into the master record file
+ * The write is flushed before returning so that recovery never sees a checkpoint that is not on disk
+ */
+void DiskManager::WriteMasterRecord(log_offset_t offset) {
+  std::ofstream master_io(master_name_, std::ios::binary | std::ios::trunc | std::ios::out);
+  if (!master_io.is_open()) {
+    LOG_DEBUG("can't open master record file");
+    return;
+  }
+  master_io.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  master_io.flush();
+  if (master_io.bad()) {
+    LOG_DEBUG("I/O error while writing master record");
+  }
+}
+
+/**
+ * Read the offset of the last checkpoint from the master record file
+ * @return: -1 means there is no checkpoint yet
+ */
+log_offset_t DiskManager::ReadMasterRecord() {
+  std::ifstream master_io(master_name_, std::ios::binary | std::ios::in);
+  log_offset_t offset = -1;
+  if (!master_io.is_open() || !master_io.read(reinterpret_cast<char *>(&offset), sizeof(offset))) {
+    return -1;
+  }
+  return offset;
+}
+
 /**
  * Returns number of flushes made so far
  */
@@ -209,6 +413,11 @@ bool DiskManager::GetFlushState() const { return flush_log_; }
 /**
  * Private helper function to get disk file size
  */
+int DiskManager::GetNumPages() {
+  std::scoped_lock scoped_db_io_latch(db_io_latch_);
+  return std::max(GetFileSize(file_name_), 0) / PAGE_SIZE;
+}
+
 int DiskManager::GetFileSize(const std::string &file_name) {
   struct stat stat_buf;
   int rc = stat(file_name.c_str(), &stat_buf);
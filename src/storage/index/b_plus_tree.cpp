@@ -9,11 +9,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <string>
 
 #include "common/exception.h"
 #include "common/rid.h"
 #include "storage/index/b_plus_tree.h"
+#include "storage/index/index_page_log.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 #include "storage/page/b_plus_tree_page.h"
@@ -23,13 +25,15 @@ namespace bustub {
 
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, LogManager *log_manager)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {}
+      internal_max_size_(internal_max_size),
+      log_manager_(log_manager),
+      root_loaded_(false) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -43,21 +47,34 @@ bool BPLUSTREE_TYPE::IsSafe(BPlusTreePage *node, OPTYPE op_type) const {
     case GET_VALUE:
       return true;
     case INSERT:
+      // a leaf splits once it fills up, an internal page when it is full before the insert
       if (node->IsLeafPage()) {
-        return node->GetSize() == leaf_max_size_ - 1;
+        return node->GetSize() < Capacity(node) - 1;
       }
-      return node->GetSize() == internal_max_size_;
+      return node->GetSize() < Capacity(node);
     case DELETE:
       if (node->IsLeafPage()) {
-        return node->GetSize() > leaf_max_size_ / 2;
+        return node->GetSize() > Capacity(node) / 2;
       }
-      return node->GetSize() > ((internal_max_size_ + 1) / 2);
+      return node->GetSize() > ((Capacity(node) + 1) / 2);
     default:
       BUSTUB_ASSERT(false, "invalid op type");
   }
   return false;
 }
 
+/*
+ * Number of entries the node holds with the prefix its keys share: a leaf splits once it has that many, an internal
+ * page when it has that many before an insert
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::Capacity(BPlusTreePage *node) const {
+  if (node->IsLeafPage()) {
+    return static_cast<LeafPage *>(node)->GetCapacity();
+  }
+  return static_cast<InternalPage *>(node)->GetCapacity();
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::PLatch(Page *page, OPTYPE op_type) {
   if (op_type == OPTYPE::GET_VALUE) {
@@ -92,6 +109,10 @@ void BPLUSTREE_TYPE::ReleaseParent(std::vector<Page *> *latches, OPTYPE op_type,
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::ReleaseAll(std::vector<Page *> *latches, OPTYPE op_type, bool is_dirty) {
+  if (is_dirty) {
+    // log the changes while the pages are still latched, so no other operation can log on top of them first
+    IndexPageLog::FlushCurrent();
+  }
   for (auto latch : *latches) {
     PUnlatch(latch, op_type);
     buffer_pool_manager_->UnpinPage(latch->GetPageId(), is_dirty);
@@ -109,16 +130,12 @@ void BPLUSTREE_TYPE::ReleaseAll(std::vector<Page *> *latches, OPTYPE op_type, bo
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) {
-  latch_.lock();
-  if (IsEmpty()) {
-    latch_.unlock();
+  Page *leaf_page = FindLeafPage(key);
+  if (leaf_page == nullptr) {
     return false;
   }
-  latch_.unlock();
-  std::vector<Page *> latches;
+  std::vector<Page *> latches{leaf_page};
   OPTYPE op_type = OPTYPE::GET_VALUE;
-  Page *root = buffer_pool_manager_->FetchPage(root_page_id_);
-  Page *leaf_page = Search(key, root, op_type, &latches);
   BPlusTreeLeafPage<KVC> *leaf_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(leaf_page->GetData());
   int key_idx = leaf_node->KeyIndex(key, comparator_);
   if (key_idx == -1) {
@@ -130,25 +147,163 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
   return !result->empty();
 }
 
-// todo: Concurrent
+/*
+ * Return the values of the entries in a batch of key ranges: the ranges are sorted and do not overlap, results[i] gets
+ * the values of the entries from ranges[i].first to ranges[i].second, both included, in key order.
+ * The batch shares one descent. The internal pages passed on the way to a leaf stay pinned, and the next range starts
+ * from the lowest of them whose keys still reach it rather than from the root; a range that starts in the leaf the
+ * one before ended in is found without leaving it. Pages are read latched one at a time as in FindLeafPage. A pinned
+ * page is not deleted, one merged away meanwhile is marked deleted, and keys only ever move right, so a page on the
+ * path to a smaller key is a safe place to resume from as long as the key is not past its high key.
+ */
 INDEX_TEMPLATE_ARGUMENTS
-Page *BPLUSTREE_TYPE::Search(const KeyType &key, Page *node, OPTYPE op_type, std::vector<Page *> *latches) {
-  char *data = node->GetData();
-  BPlusTreePage *b_node = reinterpret_cast<BPlusTreePage *>(data);
-  if (b_node->IsLeafPage()) {
-    return node;
+void BPLUSTREE_TYPE::ScanRanges(const std::vector<std::pair<KeyType, KeyType>> &ranges,
+                                std::vector<std::vector<ValueType>> *results, Transaction *transaction) {
+  results->assign(ranges.size(), std::vector<ValueType>());
+  std::vector<Page *> path;
+  Page *leaf_page = nullptr;
+  LeafPage *leaf_node = nullptr;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const KeyType &low_key = ranges[i].first;
+    const KeyType &high_key = ranges[i].second;
+    if (leaf_page == nullptr || leaf_node->IsPastHighKey(low_key, comparator_)) {
+      Page *page = nullptr;
+      if (leaf_page != nullptr) {
+        PUnlatch(leaf_page, OPTYPE::GET_VALUE);
+        buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+      }
+      while (!path.empty() && page == nullptr) {
+        page = path.back();
+        path.pop_back();
+        PLatch(page, OPTYPE::GET_VALUE);
+        auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+        if (node->IsDeletedPage() || static_cast<InternalPage *>(node)->IsPastHighKey(low_key, comparator_)) {
+          PUnlatch(page, OPTYPE::GET_VALUE);
+          buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+          page = nullptr;
+        }
+      }
+      leaf_page = DescendToLeaf(low_key, false, page != nullptr ? page : LatchRoot(OPTYPE::GET_VALUE, true), &path);
+      if (leaf_page == nullptr) {
+        break;
+      }
+      leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
+    }
+    for (int idx = leaf_node->LowerBound(low_key, comparator_);; idx++) {
+      if (idx < leaf_node->GetSize()) {
+        MappingType item = leaf_node->GetItem(idx);
+        if (comparator_(item.first, high_key) > 0) {
+          break;
+        }
+        (*results)[i].push_back(item.second);
+        continue;
+      }
+      // the range goes on in the next leaf, unless it ends before the high key of this one
+      page_id_t next_page_id = leaf_node->GetNextPageId();
+      if (next_page_id == INVALID_PAGE_ID || comparator_(high_key, leaf_node->GetHighKey()) < 0) {
+        break;
+      }
+      KeyType resume_key = leaf_node->GetHighKey();
+      Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
+      PUnlatch(leaf_page, OPTYPE::GET_VALUE);
+      buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+      PLatch(next_page, OPTYPE::GET_VALUE);
+      leaf_page = next_page;
+      leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
+      if (leaf_node->IsDeletedPage()) {
+        // merged into the leaf just left meanwhile, the rest of the range is looked for from the root
+        PUnlatch(leaf_page, OPTYPE::GET_VALUE);
+        buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+        UnpinPath(&path);
+        leaf_page = DescendToLeaf(resume_key, false, LatchRoot(OPTYPE::GET_VALUE, true), &path);
+        if (leaf_page == nullptr) {
+          break;
+        }
+        leaf_node = reinterpret_cast<LeafPage *>(leaf_page->GetData());
+      }
+      // the leaf just left may have lent the entries at its end to this one meanwhile, they were seen already
+      idx = leaf_node->LowerBound(resume_key, comparator_) - 1;
+    }
+  }
+  if (leaf_page != nullptr) {
+    PUnlatch(leaf_page, OPTYPE::GET_VALUE);
+    buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
   }
+  UnpinPath(&path);
+}
 
-  BPlusTreeInternalPage<INTERNAL_KVC> *in_node = static_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(b_node);
-  page_id_t child_id = in_node->Lookup(key, comparator_);
-  Page *child_page = buffer_pool_manager_->FetchPage(child_id);
-  BPlusTreePage *child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
+/*
+ * Latch the root page, or return nullptr if the tree is empty.
+ * An internal root is read latched when crabbing, a leaf root is latched the way the operation needs the leaf.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::LatchRoot(OPTYPE op_type, bool crab) {
+  while (true) {
+    latch_.lock();
+    LoadRootPageId();
+    page_id_t root_id = root_page_id_;
+    latch_.unlock();
+    if (root_id == INVALID_PAGE_ID) {
+      return nullptr;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(root_id);
+    bool is_leaf = reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage();
+    OPTYPE latch_type = crab && !is_leaf ? OPTYPE::GET_VALUE : op_type;
+    PLatch(page, latch_type);
+    // the root can only be replaced by someone holding its write latch, so once latched it stays the root
+    latch_.lock();
+    bool is_root = root_page_id_ == root_id;
+    latch_.unlock();
+    if (is_root && reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage() == is_leaf) {
+      return page;
+    }
+    PUnlatch(page, latch_type);
+    buffer_pool_manager_->UnpinPage(root_id, false);
+  }
+}
 
-  LatchPush(latches, child_page, op_type);
-  if (IsSafe(child_node, op_type)) {
-    ReleaseParent(latches, op_type, false);
+/*
+ * Find the leaf page a key belongs in for a writer, or return nullptr if the tree is empty. On return latches holds
+ * the pages still latched, the leaf last.
+ * Optimistic writers crab down with read latches, holding one page at a time, and latch only the leaf for writing.
+ * Pessimistic writers write latch the whole way down and keep every ancestor a split or merge could reach, that is
+ * all pages above the lowest safe one.
+ * Writers latch the child before letting go of its parent, so unlike readers they never see a split half done.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeaf(const KeyType &key, OPTYPE op_type, bool optimistic, std::vector<Page *> *latches) {
+  bool crab = op_type == OPTYPE::GET_VALUE || optimistic;
+  Page *page = LatchRoot(op_type, crab);
+  if (page == nullptr) {
+    return nullptr;
+  }
+  if (!crab) {
+    latches->push_back(page);
+  }
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  while (!node->IsLeafPage()) {
+    BPlusTreeInternalPage<INTERNAL_KVC> *in_node = static_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(node);
+    page_id_t child_id = in_node->Lookup(key, comparator_);
+    Page *child_page = buffer_pool_manager_->FetchPage(child_id);
+    BPlusTreePage *child_node = reinterpret_cast<BPlusTreePage *>(child_page->GetData());
+    if (crab) {
+      // the parent is latched, so the child cannot be merged away and reused as another kind of page meanwhile
+      PLatch(child_page, child_node->IsLeafPage() ? op_type : OPTYPE::GET_VALUE);
+      PUnlatch(page, OPTYPE::GET_VALUE);
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    } else {
+      LatchPush(latches, child_page, op_type);
+      if (IsSafe(child_node, op_type)) {
+        ReleaseParent(latches, op_type, false);
+      }
+    }
+    page = child_page;
+    node = child_node;
+  }
+  if (crab) {
+    latches->push_back(page);
   }
-  return Search(key, child_page, op_type, latches);
+  return page;
 }
 
 /*****************************************************************************
@@ -163,14 +318,18 @@ Page *BPLUSTREE_TYPE::Search(const KeyType &key, Page *node, OPTYPE op_type, std
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) {
+  IndexPageLog page_log(LogRecordType::INDEXINSERT, index_name_, buffer_pool_manager_, log_manager_, transaction);
+  page_log.SetEntry(&key, sizeof(KeyType), value);
   latch_.lock();
+  LoadRootPageId();
   if (IsEmpty()) {
     StartNewTree(key, value);
+    page_log.Flush();
     latch_.unlock();
     return true;
   }
   latch_.unlock();
-  return InsertIntoLeaf(key, value);
+  return InsertIntoLeaf(key, value, transaction);
 }
 /*
  * Insert constant key & value pair into leaf page
@@ -184,29 +343,61 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction) {
   std::vector<Page *> latches;
   OPTYPE op_type = OPTYPE::INSERT;
-  // 1, search which page should insert to
-  Page *root = buffer_pool_manager_->FetchPage(root_page_id_);
-  LatchPush(&latches, root, op_type);
-  Page *leaf_page = Search(key, root, op_type, &latches);
-  BPlusTreeLeafPage<KVC> *leaf_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(leaf_page->GetData());
-
-  // 2, check only support unique key
-  if (leaf_node->KeyIndex(key, comparator_) != -1) {
+  // 1, search which page should insert to, optimistically first; if the leaf has to split, search again holding on
+  //    to the ancestors the split goes up to
+  bool optimistic = true;
+  Page *leaf_page;
+  BPlusTreeLeafPage<KVC> *leaf_node;
+  while (true) {
+    leaf_page = FindLeaf(key, op_type, optimistic, &latches);
+    if (leaf_page == nullptr) {
+      // the tree has been emptied since Insert looked at it
+      return Insert(key, value, transaction);
+    }
+    leaf_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(leaf_page->GetData());
+    // 2, check only support unique key
+    if (leaf_node->KeyIndex(key, comparator_) != -1) {
+      ReleaseAll(&latches, op_type, false);
+      return false;
+    }
+    if (!optimistic || IsSafe(leaf_node, op_type)) {
+      break;
+    }
     ReleaseAll(&latches, op_type, false);
-    return false;
+    optimistic = false;
   }
   // 3, insert
+  IndexPageLog::TrackCurrent(leaf_node->GetPageId());
   int size = leaf_node->Insert(key, value, comparator_);
   // 4, check if need to split
-  if (size == leaf_max_size_) {
+  if (size >= leaf_node->GetCapacity()) {
     BPlusTreeLeafPage<KVC> *new_node = static_cast<BPlusTreeLeafPage<KVC> *>(Split<BPlusTreePage>(leaf_node));
     KeyType key = new_node->KeyAt(0);
     InsertIntoParent(leaf_node, key, new_node);
+    LinkNextLeafBack(new_node, &latches, op_type);
+    buffer_pool_manager_->UnpinPage(new_node->GetPageId(), true);
   }
   ReleaseAll(&latches, op_type, true);
   return true;
 }
 
+/*
+ * Point the left link of the leaf right of a leaf that was just split off or merged into at it. That leaf is latched
+ * until the changes are logged, after the leaves left of it: writers only latch a leaf left of one they hold while
+ * holding the parent of both, as the caller does here, so going right cannot wait on a writer that waits on us.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LinkNextLeafBack(BPlusTreeLeafPage<KVC> *leaf, std::vector<Page *> *latches, OPTYPE op_type) {
+  page_id_t next_page_id = leaf->GetNextPageId();
+  if (next_page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  LatchPush(latches, buffer_pool_manager_->FetchPage(next_page_id), op_type);
+  IndexPageLog::TrackCurrent(next_page_id);
+  auto *next_leaf = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(latches->back()->GetData());
+  next_leaf->SetPrevPageId(leaf->GetPageId());
+}
+
 /*
  * Insert constant key & value pair into an empty tree
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
@@ -218,6 +409,7 @@ INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
   Page *root = buffer_pool_manager_->NewPage(&root_page_id_);
   BUSTUB_ASSERT(root != nullptr, "out of memory when start new b plus tree");
+  IndexPageLog::TrackCurrent(root->GetPageId());
   BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(root->GetData());
   node->Init(root->GetPageId(), INVALID_PAGE_ID, leaf_max_size_);
   node->Insert(key, value, comparator_);
@@ -226,6 +418,156 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
   buffer_pool_manager_->UnpinPage(root->GetPageId(), true);
 }
 
+/*
+ * Build an empty tree bottom-up from a batch of entries instead of inserting them one by one. The entries are sorted,
+ * of equal keys the first one wins as it would with inserts. Leaves are filled left to right up to fill_factor of what
+ * they hold before splitting, then each level of internal pages is stacked on the one below until a single page is
+ * left as the root. What a page holds depends on the prefix its fence keys share, the last two pages of a level share
+ * what is left evenly, so no page ends up nearly empty.
+ * The pages are not logged one by one: with logging on they are forced to disk before the root is published, and the
+ * change of the root record is all recovery has to redo.
+ * @return false if the tree is not empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(std::vector<MappingType> *entries, double fill_factor, Transaction *transaction) {
+  std::lock_guard<std::mutex> guard(latch_);
+  LoadRootPageId();
+  if (!IsEmpty()) {
+    return false;
+  }
+  std::stable_sort(entries->begin(), entries->end(), [this](const MappingType &a, const MappingType &b) {
+    return comparator_(a.first, b.first) < 0;
+  });
+  entries->erase(std::unique(entries->begin(), entries->end(),
+                             [this](const MappingType &a, const MappingType &b) {
+                               return comparator_(a.first, b.first) == 0;
+                             }),
+                 entries->end());
+  if (entries->empty()) {
+    return true;
+  }
+
+  // 1, fill the leaves, remember the lowest key and the page id of each for the level above
+  std::vector<page_id_t> built_pages;
+  std::vector<std::pair<KeyType, page_id_t>> level;
+  int n = static_cast<int>(entries->size());
+  Page *last_page = nullptr;
+  for (int begin = 0, end; begin < n; begin = end) {
+    page_id_t page_id;
+    Page *page = buffer_pool_manager_->NewPage(&page_id);
+    BUSTUB_ASSERT(page != nullptr, "out of memory when bulk loading");
+    auto *leaf = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+    leaf->Init(page_id, INVALID_PAGE_ID, leaf_max_size_);
+    if (begin > 0) {
+      leaf->SetLowKey((*entries)[begin].first);
+    }
+    end = begin + BulkLoadPageEntries(leaf, *entries, begin, fill_factor);
+    if (end < n) {
+      leaf->SetHighKey((*entries)[end].first);
+    }
+    leaf->CopyNFrom(entries->data() + begin, end - begin);
+    if (last_page != nullptr) {
+      leaf->SetPrevPageId(last_page->GetPageId());
+    }
+    ChainBulkLoadPage<BPlusTreeLeafPage<KVC>>(&last_page, page);
+    level.emplace_back((*entries)[begin].first, page_id);
+    built_pages.push_back(page_id);
+  }
+  buffer_pool_manager_->UnpinPage(last_page->GetPageId(), true);
+
+  // 2, stack internal levels on top until one page covers all of the level below
+  while (level.size() > 1) {
+    std::vector<std::pair<KeyType, page_id_t>> upper_level;
+    n = static_cast<int>(level.size());
+    last_page = nullptr;
+    for (int begin = 0, end; begin < n; begin = end) {
+      page_id_t page_id;
+      Page *page = buffer_pool_manager_->NewPage(&page_id);
+      BUSTUB_ASSERT(page != nullptr, "out of memory when bulk loading");
+      auto *node = reinterpret_cast<InternalPage *>(page->GetData());
+      node->Init(page_id, INVALID_PAGE_ID, internal_max_size_);
+      if (begin > 0) {
+        node->SetLowKey(level[begin].first);
+      }
+      end = begin + BulkLoadPageEntries(node, level, begin, fill_factor);
+      if (end < n) {
+        node->SetHighKey(level[end].first);
+      }
+      for (int j = begin; j < end; j++) {
+        node->SetKeyAt(j - begin, level[j].first);
+        node->SetValueAt(j - begin, level[j].second);
+        BPlusTreePage::UpdateChildParentId(level[j].second, page_id, buffer_pool_manager_);
+      }
+      node->SetSize(end - begin);
+      ChainBulkLoadPage<InternalPage>(&last_page, page);
+      upper_level.emplace_back(level[begin].first, page_id);
+      built_pages.push_back(page_id);
+    }
+    buffer_pool_manager_->UnpinPage(last_page->GetPageId(), true);
+    level = std::move(upper_level);
+  }
+
+  // 3, publish the root
+  if (enable_logging && log_manager_ != nullptr) {
+    for (page_id_t page_id : built_pages) {
+      buffer_pool_manager_->FlushPage(page_id);
+    }
+  }
+  IndexPageLog page_log(LogRecordType::INDEXINSERT, index_name_, buffer_pool_manager_, log_manager_, transaction);
+  root_page_id_ = level[0].second;
+  UpdateRootPageId(0);
+  page_log.Flush();
+  return true;
+}
+
+/*
+ * Number of the items from begin on that the next page of a level the bulk load builds takes, its low key is set
+ * already. The first item of the next page becomes its high key, so the page takes items as long as they fit
+ * fill_factor of what it holds with the prefix that leaves, at least two each when there are that many.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N, typename T>
+int BPLUSTREE_TYPE::BulkLoadPageEntries(N *page, const std::vector<T> &items, int begin, double fill_factor) const {
+  int n = static_cast<int>(items.size());
+  int spare = page->IsLeafPage() ? 1 : 0;
+  // no high key is set yet, it is the largest key
+  KeyType last_high_key = page->GetHighKey();
+  auto page_entries = [&](const KeyType &low_key, int end) {
+    int capacity = page->CapacityFor(low_key, end < n ? items[end].first : last_high_key) - spare;
+    return std::max(2, std::min(capacity, static_cast<int>(capacity * fill_factor)));
+  };
+  KeyType low_key = page->GetLowKey();
+  if (n - begin <= page_entries(low_key, n)) {
+    return n - begin;
+  }
+  int count = 1;
+  while (count + 1 <= page_entries(low_key, begin + count + 1)) {
+    count++;
+  }
+  // rather than leave little for the last page of the level, split what is left with it
+  int rest = n - begin - count;
+  int balanced = count - (count - rest) / 2;
+  if (rest < count && n - begin - balanced <= page_entries(items[begin + balanced].first, n)) {
+    return balanced;
+  }
+  return count;
+}
+
+/*
+ * Append a page to the level the bulk load is building: the page before it is linked to it and unpinned. The last
+ * page of a level is left pinned for the caller.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+void BPLUSTREE_TYPE::ChainBulkLoadPage(Page **last_page, Page *page) {
+  if (*last_page != nullptr) {
+    N *last = reinterpret_cast<N *>((*last_page)->GetData());
+    last->SetNextPageId(page->GetPageId());
+    buffer_pool_manager_->UnpinPage((*last_page)->GetPageId(), true);
+  }
+  *last_page = page;
+}
+
 /*
  * Split input page and return newly created page.
  * Using template N to represent either internal page or leaf page.
@@ -239,14 +581,15 @@ N *BPLUSTREE_TYPE::Split(N *node) {
   page_id_t page_id;
   Page *new_page = buffer_pool_manager_->NewPage(&page_id);
   BUSTUB_ASSERT(new_page != nullptr, "out of memory when split and new page");
+  // the caller unpins the new page once it is linked into the tree
+  IndexPageLog::TrackCurrent(page_id);
   BPlusTreePage *bplus_page = static_cast<BPlusTreePage *>(node);
+  IndexPageLog::TrackCurrent(bplus_page->GetPageId());
   if (bplus_page->IsLeafPage()) {
     BPlusTreeLeafPage<KVC> *leaf_node = static_cast<BPlusTreeLeafPage<KVC> *>(bplus_page);
     BPlusTreeLeafPage<KVC> *new_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(new_page->GetData());
     new_node->Init(page_id, INVALID_PAGE_ID, leaf_max_size_);
     leaf_node->MoveHalfTo(new_node);
-    new_node->SetNextPageId(leaf_node->GetNextPageId());
-    leaf_node->SetNextPageId(new_node->GetPageId());
     return static_cast<N *>(new_node);
   }
   BPlusTreeInternalPage<INTERNAL_KVC> *internal_node = static_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(bplus_page);
@@ -273,14 +616,18 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
   page_id_t parent_id = old_node->GetParentPageId();
   Page *parent_page;
   BPlusTreeInternalPage<INTERNAL_KVC> *parent_node;
+  IndexPageLog::TrackCurrent(old_node->GetPageId());
+  IndexPageLog::TrackCurrent(new_node->GetPageId());
   if (parent_id == INVALID_PAGE_ID) {
     parent_page = buffer_pool_manager_->NewPage(&parent_id);
+    IndexPageLog::TrackCurrent(parent_id);
     parent_node = reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(parent_page->GetData());
     parent_node->Init(parent_id, INVALID_PAGE_ID, internal_max_size_);
     old_node->SetParentPageId(parent_id);
   } else {
     parent_page = buffer_pool_manager_->FetchPage(parent_id);
     parent_node = reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(parent_page->GetData());
+    IndexPageLog::TrackCurrent(parent_id);
   }
   new_node->SetParentPageId(parent_id);
   // 2, deal insert into parent
@@ -293,8 +640,8 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
     UpdateRootPageId(0);
     latch_.unlock();
   } else {
-    // 2) if size > internal_max_size_ , split
-    if (parent_node->GetSize() == internal_max_size_) {
+    // 2) if the parent is full, split
+    if (parent_node->GetSize() >= parent_node->GetCapacity()) {
 #define KPSIZE sizeof(std::pair<KeyType, page_id_t>)
       char *tmp = new char[KPSIZE + PAGE_SIZE];
       memcpy(tmp, parent_page->GetData(), PAGE_SIZE);
@@ -307,60 +654,89 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
       memcpy(parent_page->GetData(), tmp, PAGE_SIZE);
       delete[] tmp;
       InsertIntoParent(parent_node, key, new_internal_node);
+      buffer_pool_manager_->UnpinPage(new_internal_node->GetPageId(), true);
     } else {
       parent_node->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
     }
   }
+  // the caller's latch keeps the parent pinned
+  buffer_pool_manager_->UnpinPage(parent_id, true);
 }
 
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
 
-// find sibling's node
+// find sibling's node to borrow from; only the left sibling lends, as readers following right links find entries
+// that moved right but not entries that moved left into a page they may have passed already
 INDEX_TEMPLATE_ARGUMENTS
-Page *BPLUSTREE_TYPE::FindSiblingRedistribute(BPlusTreePage *node, int max_size, bool *is_right) {
+Page *BPLUSTREE_TYPE::FindSiblingRedistribute(BPlusTreePage *node) {
   if (node->IsRootPage()) {
     return nullptr;
   }
+  // the parent stays pinned by the caller's latch
   Page *parent_page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
   BPlusTreeInternalPage<INTERNAL_KVC> *parent_node =
       reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(parent_page->GetData());
+  buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
   int middle_val_index = parent_node->ValueIndex(node->GetPageId());
-  page_id_t sib_page_id;
-  Page *sib_page = nullptr;
-  BPlusTreePage *sib_node = nullptr;
-
-  // find sibling node
-  // find left first
-  if (middle_val_index > 0) {
-    sib_page_id = static_cast<page_id_t>(parent_node->ValueAt(middle_val_index - 1));
-    sib_page = buffer_pool_manager_->FetchPage(sib_page_id);
-    sib_node = reinterpret_cast<BPlusTreePage *>(sib_page->GetData());
-  }
-  // then find right
-  if (sib_node == nullptr || sib_node->GetSize() + node->GetSize() <= max_size) {
-    sib_page_id = static_cast<page_id_t>(parent_node->ValueAt(middle_val_index + 1));
-    sib_page = buffer_pool_manager_->FetchPage(sib_page_id);
-    sib_node = reinterpret_cast<BPlusTreePage *>(sib_page->GetData());
-    *is_right = true;
+  if (middle_val_index == 0) {
+    return nullptr;
   }
-  // std::cout << "size: " << node->GetSize() << ", sib size = " << sib_node->GetSize() << std::endl;
-  if (sib_node->GetSize() + node->GetSize() <= max_size) {
+  auto sib_page_id = static_cast<page_id_t>(parent_node->ValueAt(middle_val_index - 1));
+  Page *sib_page = buffer_pool_manager_->FetchPage(sib_page_id);
+  BPlusTreePage *sib_node = reinterpret_cast<BPlusTreePage *>(sib_page->GetData());
+  if (sib_node->GetSize() + node->GetSize() <= MergedCapacity(sib_node, node) || !CanBorrow(sib_node, node)) {
     buffer_pool_manager_->UnpinPage(sib_page_id, false);
     return nullptr;
   }
   return sib_page;
 }
 
+/*
+ * Number of entries two neighbouring pages may hold together to merge, the merged page has the prefix the low key of
+ * left and the high key of right share
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::MergedCapacity(BPlusTreePage *left, BPlusTreePage *right) const {
+  if (left->IsLeafPage()) {
+    auto *left_leaf = static_cast<LeafPage *>(left);
+    return left_leaf->CapacityFor(left_leaf->GetLowKey(), static_cast<LeafPage *>(right)->GetHighKey()) - 1;
+  }
+  auto *left_internal = static_cast<InternalPage *>(left);
+  return left_internal->CapacityFor(left_internal->GetLowKey(), static_cast<InternalPage *>(right)->GetHighKey());
+}
+
+/*
+ * Whether right still fits once it takes the last entry of left and the low key moves down to it
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::CanBorrow(BPlusTreePage *left, BPlusTreePage *right) const {
+  if (left->GetSize() < 2) {
+    return false;
+  }
+  if (left->IsLeafPage()) {
+    auto *left_leaf = static_cast<LeafPage *>(left);
+    auto *right_leaf = static_cast<LeafPage *>(right);
+    KeyType low_key = left_leaf->KeyAt(left_leaf->GetSize() - 1);
+    return right_leaf->GetSize() + 1 < right_leaf->CapacityFor(low_key, right_leaf->GetHighKey());
+  }
+  auto *left_internal = static_cast<InternalPage *>(left);
+  auto *right_internal = static_cast<InternalPage *>(right);
+  KeyType low_key = left_internal->KeyAt(left_internal->GetSize() - 1);
+  return right_internal->GetSize() + 1 <= right_internal->CapacityFor(low_key, right_internal->GetHighKey());
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 Page *BPLUSTREE_TYPE::FindSiblingCoalesce(BPlusTreePage *node, BPlusTreeInternalPage<INTERNAL_KVC> **parent,
                                           bool *is_right) {
   if (node->IsRootPage()) {
     return nullptr;
   }
+  // the parent stays pinned by the caller's latch
   Page *parent_page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
   *parent = reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(parent_page->GetData());
+  buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
 
   int middle_val_index = (*parent)->ValueIndex(node->GetPageId());
   page_id_t sib_page_id;
@@ -369,7 +745,7 @@ Page *BPLUSTREE_TYPE::FindSiblingCoalesce(BPlusTreePage *node, BPlusTreeInternal
   if (middle_val_index > 0) {
     sib_page_id = static_cast<page_id_t>((*parent)->ValueAt(middle_val_index - 1));
     sib_page = buffer_pool_manager_->FetchPage(sib_page_id);
-  } else {
+  } else if ((*parent)->GetSize() > 1) {
     sib_page_id = static_cast<page_id_t>((*parent)->ValueAt(middle_val_index + 1));
     sib_page = buffer_pool_manager_->FetchPage(sib_page_id);
     *is_right = true;
@@ -386,21 +762,35 @@ Page *BPLUSTREE_TYPE::FindSiblingCoalesce(BPlusTreePage *node, BPlusTreeInternal
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
-  // 1, if tree is empty, return
-  latch_.lock();
-  if (IsEmpty()) {
-    latch_.unlock();
-    return;
-  }
-  latch_.unlock();
+  IndexPageLog page_log(LogRecordType::INDEXDELETE, index_name_, buffer_pool_manager_, log_manager_, transaction);
   std::vector<Page *> latches;
   OPTYPE op_type = OPTYPE::DELETE;
-  // 2, find the leaf page and remove the item
-  Page *root = buffer_pool_manager_->FetchPage(root_page_id_);
-  Page *leaf_page = Search(key, root, op_type, &latches);
-  BPlusTreeLeafPage<KVC> *leaf_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(leaf_page->GetData());
-
-  int idx = leaf_node->KeyIndex(key, comparator_);
+  // 1, find the leaf page, there is none if the tree is empty; optimistically first, and if the leaf may have to
+  //    merge or borrow, again holding on to the ancestors that can change with it
+  bool optimistic = true;
+  BPlusTreeLeafPage<KVC> *leaf_node;
+  int idx;
+  while (true) {
+    Page *leaf_page = FindLeaf(key, op_type, optimistic, &latches);
+    if (leaf_page == nullptr) {
+      return;
+    }
+    leaf_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(leaf_page->GetData());
+    idx = leaf_node->KeyIndex(key, comparator_);
+    if (idx == -1) {
+      ReleaseAll(&latches, op_type, false);
+      return;
+    }
+    if (!optimistic || IsSafe(leaf_node, op_type)) {
+      break;
+    }
+    ReleaseAll(&latches, op_type, false);
+    optimistic = false;
+  }
+  // 2, remove the item
+  // undo puts back the value that is removed here
+  page_log.SetEntry(&key, sizeof(KeyType), leaf_node->GetItem(idx).second);
+  IndexPageLog::TrackCurrent(leaf_node->GetPageId());
   leaf_node->RemoveAndDeleteRecord(key, comparator_);
   // 3, The smallest key is deleted, should update parent node
   if (idx == 0 && leaf_node->GetParentPageId() != INVALID_PAGE_ID) {
@@ -423,36 +813,30 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(BPlusTreePage *node, std::vector<Pag
                                             Transaction *transaction) {
   // std::cout << "-------  node_type = " << node->IsLeafPage() << ", size = ";
   // std::cout << node->GetSize() << "---------------" << std::endl;
-  // 0, leaf node : at least ceil((max_size - 1)/ 2)
-  //    internal node: at least ceil(max_size / 2) pointers
-  if ((node->IsLeafPage() && node->GetSize() >= leaf_max_size_ / 2) ||
-      (node->GetSize() >= (internal_max_size_ + 1) / 2)) {
+  // 0, leaf node : at least ceil((capacity - 1)/ 2)
+  //    internal node: at least ceil(capacity / 2) pointers
+  int capacity = Capacity(node);
+  if ((node->IsLeafPage() && node->GetSize() >= capacity / 2) ||
+      (!node->IsLeafPage() && node->GetSize() >= (capacity + 1) / 2)) {
     ReleaseAll(latches, OPTYPE::DELETE, true);
     return;
   }
 
-  // 1, if the size of sibling's node + node's size > max_size, sibling's node have surplus
-  int max_size = node->IsLeafPage() ? leaf_max_size_ : internal_max_size_;
-  bool is_right = false;  // sibling's node is right on node
-  Page *sib_page = FindSiblingRedistribute(node, max_size, &is_right);
+  // 1, if the pages do not fit into one together, sibling's node have surplus
+  Page *sib_page = FindSiblingRedistribute(node);
   if (sib_page != nullptr) {
     LatchPush(latches, sib_page, OPTYPE::DELETE);
     BPlusTreePage *sib_node = reinterpret_cast<BPlusTreePage *>(sib_page->GetData());
-    if (is_right) {
-      // if index == 0, move right_node's first item into end of left_node
-      Redistribute(node, sib_node, 0);
-    } else {
-      // else move left_node's last item into head of right_node
-      Redistribute(sib_node, node, 1);
-    }
-    buffer_pool_manager_->UnpinPage(sib_node->GetPageId(), true);
+    IndexPageLog::TrackCurrent(sib_node->GetPageId());
+    // move left_node's last item into head of right_node
+    Redistribute(sib_node, node, 1);
     ReleaseAll(latches, OPTYPE::DELETE, true);
     return;
   }
 
   // 2, sibling's node don't have surplus , find sibling's node to coalesce
   BPlusTreeInternalPage<INTERNAL_KVC> *parent = nullptr;
-  is_right = false;
+  bool is_right = false;  // sibling's node is right on node
   sib_page = FindSiblingCoalesce(node, &parent, &is_right);
   // std::cout << "parent: page = " <<parent->GetPageId() << ", size =  " << parent->GetSize() << std::endl;
   // std::cout << "sibling: page = " <<sib_node->GetPageId();
@@ -461,6 +845,16 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(BPlusTreePage *node, std::vector<Pag
   if (sib_page != nullptr) {
     LatchPush(latches, sib_page, OPTYPE::DELETE);
     BPlusTreePage *sib_node = reinterpret_cast<BPlusTreePage *>(sib_page->GetData());
+    BPlusTreePage *left_node = is_right ? node : sib_node;
+    BPlusTreePage *right_node = is_right ? sib_node : node;
+    if (sib_node->GetSize() + node->GetSize() > MergedCapacity(left_node, right_node)) {
+      // the first child cannot borrow from the right, nor can a page whose keys the left sibling's entry would make
+      // share less; it stays underfull until it can merge
+      ReleaseAll(latches, OPTYPE::DELETE, true);
+      return;
+    }
+    IndexPageLog::TrackCurrent(sib_node->GetPageId());
+    IndexPageLog::TrackCurrent(parent->GetPageId());
     if (is_right) {
       // std::cout << "sib is right" << std::endl;
       delete_parent = Coalesce(node, sib_node, parent, 0);
@@ -470,6 +864,9 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(BPlusTreePage *node, std::vector<Pag
       delete_parent = Coalesce(sib_node, node, parent, 0);
       buffer_pool_manager_->DeletePage(node->GetPageId());
     }
+    if (left_node->IsLeafPage()) {
+      LinkNextLeafBack(static_cast<BPlusTreeLeafPage<KVC> *>(left_node), latches, OPTYPE::DELETE);
+    }
   }
   // remove last key from b plus tree
   if (node->IsRootPage()) {
@@ -502,6 +899,9 @@ bool BPLUSTREE_TYPE::Coalesce(BPlusTreePage *left_node, BPlusTreePage *right_nod
                               BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent, int index,
                               Transaction *transaction) {
   int val_idx = parent->ValueIndex(right_node->GetPageId());
+  IndexPageLog::TrackCurrent(left_node->GetPageId());
+  IndexPageLog::TrackCurrent(right_node->GetPageId());
+  IndexPageLog::TrackCurrent(parent->GetPageId());
   // leaf node
   if (left_node->IsLeafPage()) {
     BPlusTreeLeafPage<KVC> *left_leaf = static_cast<BPlusTreeLeafPage<KVC> *>(left_node);
@@ -514,6 +914,8 @@ bool BPLUSTREE_TYPE::Coalesce(BPlusTreePage *left_node, BPlusTreePage *right_nod
     KeyType middle_key = parent->KeyAt(val_idx);
     right_internal->MoveAllTo(left_internal, middle_key, buffer_pool_manager_);
   }
+  // readers that were headed for the right page find it deleted and start over
+  right_node->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
   parent->Remove(val_idx);  // if parent size = 1 and is root page , should be delete;
   return parent->GetSize() == 1 && parent->IsRootPage();
 }
@@ -536,6 +938,9 @@ void BPLUSTREE_TYPE::Redistribute(BPlusTreePage *left_node, BPlusTreePage *right
   Page *parent = buffer_pool_manager_->FetchPage(parent_page_id);
   BPlusTreeInternalPage<INTERNAL_KVC> *parent_node =
       reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(parent->GetData());
+  IndexPageLog::TrackCurrent(parent_page_id);
+  IndexPageLog::TrackCurrent(left_node->GetPageId());
+  IndexPageLog::TrackCurrent(right_node->GetPageId());
 
   int middle_key_idx = parent_node->ValueIndex(right_node->GetPageId());
   KeyType new_middle_key;
@@ -567,6 +972,7 @@ void BPLUSTREE_TYPE::Redistribute(BPlusTreePage *left_node, BPlusTreePage *right
     }
   }
 
+  // the pages moved their fences already
   parent_node->SetKeyAt(middle_key_idx, new_middle_key);
   buffer_pool_manager_->UnpinPage(parent_page_id, true);
 }
@@ -582,8 +988,10 @@ void BPLUSTREE_TYPE::Redistribute(BPlusTreePage *left_node, BPlusTreePage *right
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
+  IndexPageLog::TrackCurrent(old_root_node->GetPageId());
   // root node is leaf node
   if (old_root_node->IsLeafPage() && old_root_node->GetSize() == 0) {
+    old_root_node->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
     buffer_pool_manager_->DeletePage(old_root_node->GetPageId());
     latch_.lock();
     root_page_id_ = INVALID_PAGE_ID;
@@ -598,12 +1006,15 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
         reinterpret_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(old_root_node);
     page_id_t child = internal_node->RemoveAndReturnOnlyChild();
     Page *new_root_page = buffer_pool_manager_->FetchPage(child);
+    IndexPageLog::TrackCurrent(child);
     BPlusTreePage *new_root_node = reinterpret_cast<BPlusTreePage *>(new_root_page->GetData());
     new_root_node->SetParentPageId(INVALID_PAGE_ID);
+    buffer_pool_manager_->UnpinPage(child, true);
     latch_.lock();
     root_page_id_ = child;
     UpdateRootPageId();
     latch_.unlock();
+    old_root_node->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
     buffer_pool_manager_->DeletePage(old_root_node->GetPageId());
     return true;
   }
@@ -620,21 +1031,11 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() {
-  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
-  PLatch(page, OPTYPE::GET_VALUE);
-  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
-  while (!node->IsLeafPage()) {
-    BPlusTreeInternalPage<INTERNAL_KVC> *internal_node = static_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(node);
-    page_id_t next_page_id = internal_node->ValueAt(0);
-    PUnlatch(page, OPTYPE::GET_VALUE);
-
-    buffer_pool_manager_->UnpinPage(node->GetPageId(), false);
-    Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
-    page = next_page;
-    PLatch(page, OPTYPE::GET_VALUE);
-    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  Page *page = FindLeafPage(KeyType{}, true);
+  if (page == nullptr) {
+    return End();
   }
-  return INDEXITERATOR_TYPE(page, 0, buffer_pool_manager_);
+  return INDEXITERATOR_TYPE(this, page, 0);
 }
 
 /*
@@ -644,13 +1045,107 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() {
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
-  Page *root_page = buffer_pool_manager_->FetchPage(root_page_id_);
-  std::vector<Page *> latches;
-  OPTYPE op_type = OPTYPE::GET_VALUE;
-  LatchPush(&latches, root_page, op_type);
-  Page *page = Search(key, root_page, op_type, &latches);
+  Page *page = FindLeafPage(key);
+  if (page == nullptr) {
+    return End();
+  }
   BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
-  return INDEXITERATOR_TYPE(page, node->KeyIndex(key, comparator_), buffer_pool_manager_);
+  return INDEXITERATOR_TYPE(this, page, node->LowerBound(key, comparator_));
+}
+
+/*
+ * Input parameters are low key and end key, construct an index iterator over the entries from the low key up to but
+ * not including the end key
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key, const KeyType &end_key) {
+  Page *page = FindLeafPage(key);
+  if (page == nullptr) {
+    return End();
+  }
+  BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+  return INDEXITERATOR_TYPE(this, page, node->LowerBound(key, comparator_), &end_key);
+}
+
+/*
+ * Split the keys from key on into at most parts ranges for scans that run in parallel. The result holds the first
+ * key of each range in order, key first; range i ends where range i + 1 begins and the last one at the end of the
+ * tree, so each thread scans its own with Begin(bounds[i], bounds[i + 1]) or Begin(bounds[i]). An iterator holds the
+ * latch of its leaf, so the iterators are to be opened by the threads that drive them rather than all by one.
+ * The bounds are the separator keys of the highest level of internal pages that has enough of them past key, spread
+ * evenly, so the ranges cover about as many subtrees each. Internal pages are read latched one at a time, the children
+ * of a page pinned before it is let go of as in FindLeafPage. The bounds are only a snapshot of the tree: entries
+ * inserted or removed meanwhile still fall into exactly one range, the ranges just get less even.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<KeyType> BPLUSTREE_TYPE::SplitRange(const KeyType &key, int parts) {
+  std::vector<KeyType> bounds{key};
+  Page *root = LatchRoot(OPTYPE::GET_VALUE, true);
+  if (root == nullptr) {
+    return bounds;
+  }
+  PUnlatch(root, OPTYPE::GET_VALUE);
+  std::vector<Page *> level{root};
+  std::vector<KeyType> separators;
+  while (!level.empty()) {
+    // the keys past key that begin a page of the level or a child of one
+    std::vector<KeyType> level_separators;
+    for (Page *page : level) {
+      PLatch(page, OPTYPE::GET_VALUE);
+      auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+      if (!node->IsLeafPage() && !node->IsDeletedPage()) {
+        auto *internal_node = static_cast<InternalPage *>(node);
+        if (comparator_(internal_node->GetLowKey(), key) > 0) {
+          level_separators.push_back(internal_node->GetLowKey());
+        }
+        for (int i = 1; i < internal_node->GetSize(); i++) {
+          if (comparator_(internal_node->KeyAt(i), key) > 0) {
+            level_separators.push_back(internal_node->KeyAt(i));
+          }
+        }
+      }
+      PUnlatch(page, OPTYPE::GET_VALUE);
+    }
+    if (!level_separators.empty()) {
+      separators = std::move(level_separators);
+    }
+    if (static_cast<int>(separators.size()) + 1 >= parts) {
+      break;
+    }
+    // too few, go down to the children that hold keys past key
+    std::vector<Page *> children;
+    for (Page *page : level) {
+      PLatch(page, OPTYPE::GET_VALUE);
+      auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+      if (!node->IsLeafPage() && !node->IsDeletedPage()) {
+        auto *internal_node = static_cast<InternalPage *>(node);
+        for (int i = 0; i < internal_node->GetSize(); i++) {
+          if (i + 1 == internal_node->GetSize() || comparator_(internal_node->KeyAt(i + 1), key) > 0) {
+            children.push_back(buffer_pool_manager_->FetchPage(internal_node->ValueAt(i)));
+          }
+        }
+      }
+      PUnlatch(page, OPTYPE::GET_VALUE);
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    }
+    level = std::move(children);
+  }
+  for (Page *page : level) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+  // pages read at different times may disagree on a separator or two
+  std::sort(separators.begin(), separators.end(),
+            [this](const KeyType &a, const KeyType &b) { return comparator_(a, b) < 0; });
+  separators.erase(std::unique(separators.begin(), separators.end(),
+                               [this](const KeyType &a, const KeyType &b) { return comparator_(a, b) == 0; }),
+                   separators.end());
+  int n = static_cast<int>(separators.size());
+  int ranges = std::min(parts, n + 1);
+  for (int i = 1; i < ranges; i++) {
+    bounds.push_back(separators[static_cast<int64_t>(i) * (n + 1) / ranges - 1]);
+  }
+  return bounds;
 }
 
 /*
@@ -659,9 +1154,55 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() {
-  static INDEXITERATOR_TYPE *end = new INDEXITERATOR_TYPE(nullptr, -1, nullptr);
-  return *end;
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() { return INDEXITERATOR_TYPE(); }
+
+/*
+ * Input parameter is void, construct an index iterator that goes from the
+ * last entry of the tree back to the first one
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin() {
+  KeyType last_key;
+  memset(&last_key, 0xff, sizeof(KeyType));
+  Page *page = FindLeafPage(last_key);
+  if (page == nullptr) {
+    return End();
+  }
+  BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+  return INDEXITERATOR_TYPE(this, page, node->GetSize() - 1, nullptr, true);
+}
+
+/*
+ * Input parameter is high key, construct an index iterator that goes back
+ * from the last entry smaller than it, so that RBegin(key) visits what
+ * Begin() visits before Begin(key), in reverse
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin(const KeyType &key) {
+  Page *page = FindLeafBefore(key);
+  if (page == nullptr) {
+    return End();
+  }
+  BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+  return INDEXITERATOR_TYPE(this, page, node->LowerBound(key, comparator_) - 1, nullptr, true);
+}
+
+/*
+ * Input parameters are high key and end key, construct an index iterator over
+ * the entries Begin(end_key, key) visits, in reverse: from the last entry
+ * smaller than the high key back to the end key
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin(const KeyType &key, const KeyType &end_key) {
+  Page *page = FindLeafBefore(key);
+  if (page == nullptr) {
+    return End();
+  }
+  BPlusTreeLeafPage<KVC> *node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+  return INDEXITERATOR_TYPE(this, page, node->LowerBound(key, comparator_) - 1, &end_key, true);
 }
 
 /*****************************************************************************
@@ -669,11 +1210,88 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::End() {
  *****************************************************************************/
 /*
  * Find leaf page containing particular key, if leftMost flag == true, find
- * the left most leaf page
+ * the left most leaf page. The leaf is returned pinned and read latched, nullptr if the tree is empty.
+ * Readers hold one latch at a time: a page is pinned before the latch on the page pointing to it is released, and a
+ * reader that arrives after a split moved its key to the right follows the right link, so readers never wait for a
+ * split to reach the parent. A page merged away meanwhile is marked deleted and the reader starts over at the root.
  */
 INDEX_TEMPLATE_ARGUMENTS
 Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
-  throw Exception(ExceptionType::NOT_IMPLEMENTED, "Implement this for test");
+  return DescendToLeaf(key, leftMost, LatchRoot(OPTYPE::GET_VALUE, true), nullptr);
+}
+
+/*
+ * Find the leaf holding the keys right before key, the one whose low key is smaller and whose high key is not.
+ * Keys compare by their bytes, so it is the leaf of the key one less than key, read as a number; the smallest key has
+ * nothing before it and gets the first leaf. The leaf is returned as by FindLeafPage.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeafBefore(const KeyType &key) {
+  KeyType key_before = key;
+  auto *data = reinterpret_cast<unsigned char *>(&key_before);
+  int i = static_cast<int>(sizeof(KeyType)) - 1;
+  for (; i >= 0 && data[i] == 0; i--) {
+    data[i] = 0xff;
+  }
+  if (i < 0) {
+    return FindLeafPage(key, true);
+  }
+  data[i]--;
+  return FindLeafPage(key_before);
+}
+
+/*
+ * Go down from a read latched internal page, or leaf, to the leaf of a key the way FindLeafPage does. With a path,
+ * the pages the descent goes down from are left pinned in it, the lowest last; they are let go of if the descent has
+ * to start over at the root.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::DescendToLeaf(const KeyType &key, bool left_most, Page *page, std::vector<Page *> *path) {
+  while (page != nullptr) {
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t next_page_id = INVALID_PAGE_ID;
+    bool is_child = false;
+    if (node->IsLeafPage()) {
+      BPlusTreeLeafPage<KVC> *leaf_node = static_cast<BPlusTreeLeafPage<KVC> *>(node);
+      if (left_most || !leaf_node->IsPastHighKey(key, comparator_)) {
+        return page;
+      }
+      next_page_id = leaf_node->GetNextPageId();
+    } else if (!node->IsDeletedPage()) {
+      BPlusTreeInternalPage<INTERNAL_KVC> *internal_node = static_cast<BPlusTreeInternalPage<INTERNAL_KVC> *>(node);
+      if (!left_most && internal_node->IsPastHighKey(key, comparator_)) {
+        next_page_id = internal_node->GetNextPageId();
+      } else {
+        next_page_id = left_most ? internal_node->ValueAt(0) : internal_node->Lookup(key, comparator_);
+        is_child = true;
+      }
+    }
+    Page *next_page = next_page_id == INVALID_PAGE_ID ? nullptr : buffer_pool_manager_->FetchPage(next_page_id);
+    PUnlatch(page, OPTYPE::GET_VALUE);
+    if (is_child && path != nullptr) {
+      path->push_back(page);
+    } else {
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    }
+    if (next_page == nullptr) {
+      if (path != nullptr) {
+        UnpinPath(path);
+      }
+      page = LatchRoot(OPTYPE::GET_VALUE, true);
+    } else {
+      PLatch(next_page, OPTYPE::GET_VALUE);
+      page = next_page;
+    }
+  }
+  return nullptr;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UnpinPath(std::vector<Page *> *path) {
+  for (Page *page : *path) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  }
+  path->clear();
 }
 
 /*
@@ -687,6 +1305,7 @@ Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  IndexPageLog::TrackCurrent(HEADER_PAGE_ID);
   if (insert_record != 0) {
     // create a new record<index_name + root_page_id> in header_page
     header_page->InsertRecord(index_name_, root_page_id_);
@@ -697,6 +1316,27 @@ void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
+/*
+ * Pick up the root page id of an existing index from its record in the header page. The record is created by
+ * whoever registers the index name, a tree without one starts out empty.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LoadRootPageId() {
+  if (root_loaded_) {
+    return;
+  }
+  root_loaded_ = true;
+  if (root_page_id_ != INVALID_PAGE_ID) {
+    return;
+  }
+  HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  if (header_page == nullptr) {
+    return;
+  }
+  header_page->GetRootId(index_name_, &root_page_id_);
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false);
+}
+
 /*
  * This method is used for test only
  * Read data from file and insert one by one
@@ -835,7 +1475,7 @@ void BPLUSTREE_TYPE::ToString(BPlusTreePage *page, BufferPoolManager *bpm) const
   if (page->IsLeafPage()) {
     LeafPage *leaf = reinterpret_cast<LeafPage *>(page);
     std::cout << "Leaf Page: " << leaf->GetPageId() << " parent: " << leaf->GetParentPageId()
-              << " next: " << leaf->GetNextPageId() << std::endl;
+              << " next: " << leaf->GetNextPageId() << " prev: " << leaf->GetPrevPageId() << std::endl;
     for (int i = 0; i < leaf->GetSize(); i++) {
       std::cout << leaf->KeyAt(i) << ",";
     }
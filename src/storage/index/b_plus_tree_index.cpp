@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+
 #include "storage/index/b_plus_tree_index.h"
 
 namespace bustub {
@@ -16,16 +18,18 @@ namespace bustub {
  * Constructor
  */
 INDEX_TEMPLATE_ARGUMENTS
-BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager)
+BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
+                                     LogManager *log_manager)
     : Index(std::move(metadata)),
+      is_unique_(GetMetadata()->IsUnique()),
       comparator_(GetMetadata()->GetKeySchema()),
-      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_) {}
+      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_, LEAF_PAGE_SIZE, INTERNAL_PAGE_SIZE,
+                 log_manager) {}
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct insert index key
-  KeyType index_key;
-  index_key.SetFromKey(key);
+  KeyType index_key = IndexKey(key, rid);
 
   container_.Insert(index_key, rid, transaction);
 }
@@ -33,19 +37,92 @@ void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *t
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct delete index key
-  KeyType index_key;
-  index_key.SetFromKey(key);
+  KeyType index_key = IndexKey(key, rid);
 
   container_.Remove(index_key, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
-  // construct scan index key
+  if (is_unique_) {
+    // construct scan index key
+    KeyType index_key;
+    index_key.SetFromKey(key, GetKeySchema());
+
+    container_.GetValue(index_key, result, transaction);
+    return;
+  }
+  std::vector<std::vector<RID>> results;
+  container_.ScanRanges({KeyRange(key)}, &results, transaction);
+  result->insert(result->end(), results[0].begin(), results[0].end());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanKeys(const std::vector<Tuple> &keys, std::vector<std::vector<RID>> *results,
+                                    Transaction *transaction) {
+  std::vector<std::pair<KeyType, KeyType>> ranges;
+  ranges.reserve(keys.size());
+  for (const auto &key : keys) {
+    ranges.push_back(KeyRange(key));
+  }
+  // look up each distinct key once, in key order
+  std::vector<size_t> order(keys.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return comparator_(ranges[a].first, ranges[b].first) < 0; });
+  std::vector<std::pair<KeyType, KeyType>> sorted_ranges;
+  std::vector<size_t> range_of(keys.size());
+  for (size_t i : order) {
+    if (sorted_ranges.empty() || comparator_(sorted_ranges.back().first, ranges[i].first) != 0) {
+      sorted_ranges.push_back(ranges[i]);
+    }
+    range_of[i] = sorted_ranges.size() - 1;
+  }
+  std::vector<std::vector<RID>> range_results;
+  container_.ScanRanges(sorted_ranges, &range_results, transaction);
+  results->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    (*results)[i] = range_results[range_of[i]];
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Tuple BPLUSTREE_INDEX_TYPE::KeyFromStoredKey(const char *key_data) const {
+  KeyType index_key;
+  memcpy(&index_key, key_data, sizeof(KeyType));
+  return index_key.ToKeyTuple(GetKeySchema(), !is_unique_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType BPLUSTREE_INDEX_TYPE::IndexKey(const Tuple &key, RID rid) const {
   KeyType index_key;
-  index_key.SetFromKey(key);
+  if (is_unique_) {
+    index_key.SetFromKey(key, GetKeySchema());
+  } else {
+    index_key.SetFromKey(key, GetKeySchema(), rid);
+  }
+  return index_key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::pair<KeyType, KeyType> BPLUSTREE_INDEX_TYPE::KeyRange(const Tuple &key) const {
+  std::pair<KeyType, KeyType> range;
+  if (is_unique_) {
+    range.first.SetFromKey(key, GetKeySchema());
+    range.second = range.first;
+  } else {
+    // stored rids are of valid pages, these two sort before and after all of them
+    range.first.SetFromKey(key, GetKeySchema(), RID(0, 0));
+    range.second.SetFromKey(key, GetKeySchema(), RID(INVALID_PAGE_ID, UINT32_MAX));
+  }
+  return range;
+}
 
-  container_.GetValue(index_key, result, transaction);
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::BulkLoad(std::vector<MappingType> *entries, Transaction *transaction) {
+  return container_.BulkLoad(entries, BULK_LOAD_FILL_FACTOR, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -54,9 +131,30 @@ INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator() { return container_.
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator(const KeyType &key) { return container_.Begin(key); }
 
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator(const KeyType &key, const KeyType &end_key) {
+  return container_.Begin(key, end_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<KeyType> BPLUSTREE_INDEX_TYPE::SplitRange(const KeyType &key, int parts) {
+  return container_.SplitRange(key, parts);
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetEndIterator() { return container_.End(); }
 
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetReverseBeginIterator() { return container_.RBegin(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetReverseBeginIterator(const KeyType &key) { return container_.RBegin(key); }
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetReverseBeginIterator(const KeyType &key, const KeyType &end_key) {
+  return container_.RBegin(key, end_key);
+}
+
 template class BPlusTreeIndex<GenericKey<4>, RID, GenericComparator<4>>;
 template class BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
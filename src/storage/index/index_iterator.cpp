@@ -3,6 +3,7 @@
  */
 #include <cassert>
 
+#include "storage/index/b_plus_tree.h"
 #include "storage/index/index_iterator.h"
 
 namespace bustub {
@@ -12,16 +13,86 @@ namespace bustub {
  * set your own input parameters
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator() = default;
+INDEXITERATOR_TYPE::IndexIterator()
+    : page_(nullptr),
+      cur_node_(nullptr),
+      cur_idx_(-1),
+      tree_(nullptr),
+      buffer_pool_manager_(nullptr),
+      comparator_(nullptr),
+      has_end_key_(false),
+      reverse_(false) {}
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::~IndexIterator() = default;
+INDEXITERATOR_TYPE::~IndexIterator() { Release(); }
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator(Page *page, int start, BufferPoolManager *buffer_pool_manager)
-    : page_(page), cur_node_(nullptr), cur_idx_(start), buffer_pool_manager_(buffer_pool_manager) {
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&other) noexcept
+    : page_(other.page_),
+      cur_node_(other.cur_node_),
+      cur_idx_(other.cur_idx_),
+      tree_(other.tree_),
+      buffer_pool_manager_(other.buffer_pool_manager_),
+      comparator_(other.comparator_),
+      has_end_key_(other.has_end_key_),
+      end_key_(other.end_key_),
+      reverse_(other.reverse_) {
+  other.page_ = nullptr;
+  other.cur_node_ = nullptr;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator=(IndexIterator &&other) noexcept {
+  if (this != &other) {
+    Release();
+    page_ = other.page_;
+    cur_node_ = other.cur_node_;
+    cur_idx_ = other.cur_idx_;
+    tree_ = other.tree_;
+    buffer_pool_manager_ = other.buffer_pool_manager_;
+    comparator_ = other.comparator_;
+    has_end_key_ = other.has_end_key_;
+    end_key_ = other.end_key_;
+    reverse_ = other.reverse_;
+    other.page_ = nullptr;
+    other.cur_node_ = nullptr;
+  }
+  return *this;
+}
+
+/*
+ * Let go of the leaf the iterator stands on, if any, so that a scan may stop before it reaches the end.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Release() {
+  if (page_ != nullptr) {
+    page_->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+    page_ = nullptr;
+    cur_node_ = nullptr;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(BPlusTree<KVC> *tree, Page *page, int start, const KeyType *end_key, bool reverse)
+    : page_(page),
+      cur_node_(nullptr),
+      cur_idx_(start),
+      tree_(tree),
+      buffer_pool_manager_(tree->buffer_pool_manager_),
+      comparator_(&tree->comparator_),
+      has_end_key_(end_key != nullptr),
+      reverse_(reverse) {
+  if (end_key != nullptr) {
+    end_key_ = *end_key;
+  }
   if (page != nullptr) {
     cur_node_ = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page->GetData());
+    if (reverse_) {
+      SkipFinishedLeavesReverse();
+    } else {
+      SkipFinishedLeaves();
+    }
   }
 }
 
@@ -29,27 +100,109 @@ INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::isEnd() const { return cur_node_ == nullptr; }
 
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &INDEXITERATOR_TYPE::operator*() { return cur_node_->GetItem(cur_idx_); }
+const MappingType &INDEXITERATOR_TYPE::operator*() {
+  // entries are stored without the prefix of their page, the iterator holds on to the one it puts together
+  item_ = cur_node_->GetItem(cur_idx_);
+  return item_;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() {
-  cur_idx_++;
-  if (cur_idx_ == cur_node_->GetSize()) {
+  if (reverse_) {
+    cur_idx_--;
+    SkipFinishedLeavesReverse();
+  } else {
+    cur_idx_++;
+    SkipFinishedLeaves();
+  }
+  return *this;
+}
+
+/*
+ * Move on until the iterator stands on an entry, or past the end key. Underfull leaves are tolerated until they can be
+ * merged, so a leaf on the way may be empty.
+ * The leaf left is latched again only after the next one is, so writers may change both in between: the next leaf
+ * may have taken entries from the end of the one left by a split or a loan, which are skipped as seen already, or it
+ * may have been merged into the one left, which then holds the rest of the entries. Should the leaf left have been
+ * merged away as well by then, the leaf of the rest of the entries is looked up from the root.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SkipFinishedLeaves() {
+  while (cur_node_ != nullptr && cur_idx_ >= cur_node_->GetSize()) {
     page_id_t next_page_id = cur_node_->GetNextPageId();
+    if (next_page_id == INVALID_PAGE_ID ||
+        (has_end_key_ && (*comparator_)(end_key_, cur_node_->GetHighKey()) <= 0)) {
+      Release();
+      return;
+    }
+    KeyType resume_key = cur_node_->GetHighKey();
+    Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
     page_->RUnlatch();
-    buffer_pool_manager_->UnpinPage(cur_node_->GetPageId(), false);
-    if (next_page_id != INVALID_PAGE_ID) {
-      Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
-      next_page->RLatch();
-      page_ = next_page;
-      cur_node_ = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(next_page->GetData());
-      cur_idx_ = 0;
+    next_page->RLatch();
+    auto *next_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(next_page->GetData());
+    if (next_node->IsDeletedPage()) {
+      next_page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(next_page_id, false);
+      // still pinned, so merged away itself it would be marked deleted rather than reused
+      page_->RLatch();
+      if (cur_node_->IsDeletedPage()) {
+        Release();
+        page_ = tree_->FindLeafPage(resume_key);
+        if (page_ == nullptr) {
+          return;
+        }
+        cur_node_ = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(page_->GetData());
+      }
     } else {
-      page_ = nullptr;
-      cur_node_ = nullptr;
+      buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+      page_ = next_page;
+      cur_node_ = next_node;
     }
+    cur_idx_ = cur_node_->LowerBound(resume_key, *comparator_);
+  }
+  if (cur_node_ != nullptr && has_end_key_ && (*comparator_)(cur_node_->KeyAt(cur_idx_), end_key_) >= 0) {
+    Release();
+  }
+}
+
+/*
+ * Move back until the iterator stands on an entry, or before the end key, the way SkipFinishedLeaves moves on.
+ * Writers only move entries to the right, so while the iterator goes from one leaf to the one left of it, entries not
+ * seen yet may move into the leaf it just left. The leaf it goes to must hold the keys right below the low key of the
+ * leaf left, so its left link is only followed if that leaf is still there and ends at that key; otherwise, after a
+ * split, a merge, or a loan, the leaf is looked up from the root.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SkipFinishedLeavesReverse() {
+  while (cur_node_ != nullptr && cur_idx_ < 0) {
+    page_id_t prev_page_id = cur_node_->GetPrevPageId();
+    KeyType resume_key = cur_node_->GetLowKey();
+    if (prev_page_id == INVALID_PAGE_ID || (has_end_key_ && (*comparator_)(resume_key, end_key_) <= 0)) {
+      Release();
+      return;
+    }
+    // pinned before the leaf pointing to it is let go of, so merged away meanwhile it is marked deleted, not reused
+    Page *prev_page = buffer_pool_manager_->FetchPage(prev_page_id);
+    Release();
+    prev_page->RLatch();
+    auto *prev_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(prev_page->GetData());
+    if (prev_node->IsDeletedPage() || (*comparator_)(prev_node->GetLowKey(), resume_key) >= 0 ||
+        (*comparator_)(prev_node->GetHighKey(), resume_key) != 0) {
+      prev_page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(prev_page_id, false);
+      prev_page = tree_->FindLeafBefore(resume_key);
+      if (prev_page == nullptr) {
+        return;
+      }
+      prev_node = reinterpret_cast<BPlusTreeLeafPage<KVC> *>(prev_page->GetData());
+    }
+    page_ = prev_page;
+    cur_node_ = prev_node;
+    cur_idx_ = cur_node_->LowerBound(resume_key, *comparator_) - 1;
+  }
+  if (cur_node_ != nullptr && has_end_key_ && (*comparator_)(cur_node_->KeyAt(cur_idx_), end_key_) < 0) {
+    Release();
   }
-  return *this;
 }
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_page_log.cpp
+//
+// Identification: src/storage/index/index_page_log.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/index_page_log.h"
+
+#include <cstring>
+
+namespace bustub {
+
+thread_local IndexPageLog *IndexPageLog::current = nullptr;
+
+// a range header costs 4 bytes, so equal bytes up to that many apart are cheaper to log than a new range
+static constexpr int DELTA_RANGE_HEADER_SIZE = 2 * sizeof(uint16_t);
+
+IndexPageLog::IndexPageLog(LogRecordType log_record_type, std::string index_name,
+                           BufferPoolManager *buffer_pool_manager, LogManager *log_manager, Transaction *transaction)
+    : log_record_type_(log_record_type),
+      index_name_(std::move(index_name)),
+      buffer_pool_manager_(buffer_pool_manager),
+      log_manager_(log_manager),
+      transaction_(transaction),
+      outer_(current) {
+  if (enable_logging && log_manager_ != nullptr) {
+    current = this;
+  }
+}
+
+IndexPageLog::~IndexPageLog() {
+  for (const auto &tracked : pages_) {
+    buffer_pool_manager_->UnpinPage(tracked.page_->GetPageId(), tracked.is_dirty_);
+  }
+  if (current == this) {
+    current = outer_;
+  }
+}
+
+void IndexPageLog::SetEntry(const void *key, size_t key_size, const RID &rid) {
+  key_.assign(static_cast<const char *>(key), static_cast<const char *>(key) + key_size);
+  rid_ = rid;
+}
+
+void IndexPageLog::Track(page_id_t page_id) {
+  if (current != this || page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  for (const auto &tracked : pages_) {
+    if (tracked.page_->GetPageId() == page_id) {
+      return;
+    }
+  }
+  // the caller has the page pinned already, this pin keeps it around until the changes are logged
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  BUSTUB_ASSERT(page != nullptr, "tracked index page must be resident");
+  auto image = std::make_unique<char[]>(PAGE_SIZE);
+  memcpy(image.get(), page->GetData(), PAGE_SIZE);
+  pages_.push_back({page, std::move(image), false});
+}
+
+void IndexPageLog::Flush() {
+  if (current != this) {
+    return;
+  }
+  std::vector<std::pair<page_id_t, std::vector<char>>> page_deltas;
+  for (auto &tracked : pages_) {
+    std::vector<char> delta;
+    EncodeDelta(tracked.image_.get(), tracked.page_->GetData(), &delta);
+    if (!delta.empty()) {
+      page_deltas.emplace_back(tracked.page_->GetPageId(), std::move(delta));
+      tracked.is_dirty_ = true;
+    }
+  }
+  if (page_deltas.empty()) {
+    return;
+  }
+
+  txn_id_t txn_id = transaction_ == nullptr ? INVALID_TXN_ID : transaction_->GetTransactionId();
+  lsn_t prev_lsn = transaction_ == nullptr ? INVALID_LSN : transaction_->GetPrevLSN();
+  LogRecord log_record(txn_id, prev_lsn, log_record_type_, index_name_, key_, rid_, std::move(page_deltas));
+  lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+  if (transaction_ != nullptr) {
+    transaction_->SetPrevLSN(lsn);
+  }
+  for (const auto &tracked : pages_) {
+    // the header page has no lsn field, its record directory starts right after the record count
+    if (tracked.page_->GetPageId() != HEADER_PAGE_ID) {
+      tracked.page_->SetLSN(lsn);
+    }
+    memcpy(tracked.image_.get(), tracked.page_->GetData(), PAGE_SIZE);
+  }
+}
+
+void IndexPageLog::TrackCurrent(page_id_t page_id) {
+  if (current != nullptr) {
+    current->Track(page_id);
+  }
+}
+
+void IndexPageLog::FlushCurrent() {
+  if (current != nullptr) {
+    current->Flush();
+  }
+}
+
+void IndexPageLog::EncodeDelta(const char *before, const char *after, std::vector<char> *delta) {
+  int pos = 0;
+  while (pos < PAGE_SIZE) {
+    if (before[pos] == after[pos]) {
+      pos++;
+      continue;
+    }
+    int begin = pos;
+    int end = pos + 1;
+    for (int i = end; i < PAGE_SIZE && i <= end + DELTA_RANGE_HEADER_SIZE; i++) {
+      if (before[i] != after[i]) {
+        end = i + 1;
+      }
+    }
+    auto offset = static_cast<uint16_t>(begin);
+    auto length = static_cast<uint16_t>(end - begin);
+    size_t at = delta->size();
+    delta->resize(at + DELTA_RANGE_HEADER_SIZE + length);
+    memcpy(delta->data() + at, &offset, sizeof(uint16_t));
+    memcpy(delta->data() + at + sizeof(uint16_t), &length, sizeof(uint16_t));
+    memcpy(delta->data() + at + DELTA_RANGE_HEADER_SIZE, after + begin, length);
+    pos = end;
+  }
+}
+
+void IndexPageLog::ApplyDelta(char *page_data, const std::vector<char> &delta) {
+  size_t at = 0;
+  while (at < delta.size()) {
+    uint16_t offset;
+    uint16_t length;
+    memcpy(&offset, delta.data() + at, sizeof(uint16_t));
+    memcpy(&length, delta.data() + at + sizeof(uint16_t), sizeof(uint16_t));
+    memcpy(page_data + offset, delta.data() + at + DELTA_RANGE_HEADER_SIZE, length);
+    at += DELTA_RANGE_HEADER_SIZE + length;
+  }
+}
+
+}  // namespace bustub
@@ -18,7 +18,7 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct insert index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
   container_.Insert(transaction, index_key, rid);
 }
@@ -27,7 +27,7 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) {
   // construct delete index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
   container_.Remove(transaction, index_key, rid);
 }
@@ -36,10 +36,18 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
   // construct scan index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
   container_.GetValue(transaction, index_key, result);
 }
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Tuple HASH_TABLE_INDEX_TYPE::KeyFromStoredKey(const char *key_data) const {
+  KeyType index_key;
+  memcpy(&index_key, key_data, sizeof(KeyType));
+  return index_key.ToKeyTuple(GetKeySchema());
+}
+
 template class LinearProbeHashTableIndex<GenericKey<4>, RID, GenericComparator<4>>;
 template class LinearProbeHashTableIndex<GenericKey<8>, RID, GenericComparator<8>>;
 template class LinearProbeHashTableIndex<GenericKey<16>, RID, GenericComparator<16>>;
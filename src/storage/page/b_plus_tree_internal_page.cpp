@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -23,7 +25,7 @@ namespace bustub {
 /*
  * Init method after creating a new internal page
  * Including set page type, set current size, set page id, set parent id and set
- * max page size
+ * max page size. The fences start out as the smallest and the largest key.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
@@ -35,19 +37,92 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id
   SetMaxSize(max_size);
   SetParentPageId(parent_id);
   SetPageId(page_id);
+  SetNextPageId(INVALID_PAGE_ID);
+  prefix_size_ = 0;
+  memset(&low_key_, 0, sizeof(KeyType));
+  memset(&high_key_, 0xff, sizeof(KeyType));
 }
+
+/*
+ * Helper methods to set/get the right sibling and the fence keys. Setting a
+ * fence re-encodes the keys if the prefix the fences share changes, all of them
+ * must lie within the new fences, and fit the page.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetLowKey() const { return low_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetLowKey(const KeyType &low_key) {
+  KeyType old_low_key = low_key_;
+  low_key_ = low_key;
+  UpdatePrefix(old_low_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const { return high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetHighKey(const KeyType &high_key) {
+  KeyType old_high_key = high_key_;
+  high_key_ = high_key;
+  UpdatePrefix(old_high_key);
+}
+
+/*
+ * @return whether key belongs to a page right of this one
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::IsPastHighKey(const KeyType &key, const KeyComparator &comparator) const {
+  return next_page_id_ != INVALID_PAGE_ID && comparator(key, high_key_) >= 0;
+}
+
+/*
+ * Helper methods to get the number of key bytes all keys share, and the number
+ * of children the page holds with its fences, or with other fences
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetPrefixSize() const { return prefix_size_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetCapacity() const { return CapacityFor(low_key_, high_key_); }
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::CapacityFor(const KeyType &low_key, const KeyType &high_key) const {
+  int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key),
+                                     reinterpret_cast<const char *>(&high_key), sizeof(KeyType));
+  int slot_size = static_cast<int>(sizeof(KeyType) + sizeof(ValueType)) - prefix_size;
+  int free_space = PAGE_SIZE - static_cast<int>(slots_ - reinterpret_cast<const char *>(this));
+  return std::min(GetMaxSize(), free_space / slot_size);
+}
+
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
  * array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const { return array_[index].first; }
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
+  KeyType key;
+  char *key_data = reinterpret_cast<char *>(&key);
+  memcpy(key_data, &low_key_, prefix_size_);
+  memcpy(key_data + prefix_size_, SlotAt(index), sizeof(KeyType) - prefix_size_);
+  return key;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) { array_[index].first = key; }
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
+  memcpy(SlotAt(index), reinterpret_cast<const char *>(&key) + prefix_size_, sizeof(KeyType) - prefix_size_);
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetValueAt(int index, const ValueType &value) { array_[index].second = value; }
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetValueAt(int index, const ValueType &value) {
+  memcpy(SlotAt(index) + sizeof(KeyType) - prefix_size_, &value, sizeof(ValueType));
+}
 
 /*
  * Helper method to find and return array index(or offset), so that its value
@@ -56,7 +131,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetValueAt(int index, const ValueType &valu
 INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
   for (int i = 0; i < GetSize(); i++) {
-    if (value == array_[i].second) {
+    if (value == ValueAt(i)) {
       return i;
     }
   }
@@ -68,7 +143,45 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
  * offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const { return array_[index].second; }
+ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
+  ValueType value;
+  memcpy(&value, SlotAt(index) + sizeof(KeyType) - prefix_size_, sizeof(ValueType));
+  return value;
+}
+
+/*
+ * Helper methods to address the slots and to read an entry from one
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::SlotSize() const {
+  return static_cast<int>(sizeof(KeyType) + sizeof(ValueType)) - prefix_size_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+char *B_PLUS_TREE_INTERNAL_PAGE_TYPE::SlotAt(int index) { return slots_ + index * SlotSize(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+const char *B_PLUS_TREE_INTERNAL_PAGE_TYPE::SlotAt(int index) const { return slots_ + index * SlotSize(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+MappingType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ItemAt(int index) const { return {KeyAt(index), ValueAt(index)}; }
+
+/*
+ * Helper method to re-encode the keys after a fence moved, old_fence is the key
+ * it moved from
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::UpdatePrefix(const KeyType &old_fence) {
+  int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key_),
+                                     reinterpret_cast<const char *>(&high_key_), sizeof(KeyType));
+  if (prefix_size == prefix_size_) {
+    return;
+  }
+  BUSTUB_ASSERT(prefix_size > prefix_size_ || GetSize() <= GetCapacity(), "children do not fit the widened page");
+  ResizeSlots(slots_, GetSize(), sizeof(KeyType), sizeof(ValueType), reinterpret_cast<const char *>(&old_fence),
+              prefix_size_, prefix_size);
+  prefix_size_ = prefix_size;
+}
 
 /*****************************************************************************
  * LOOKUP
@@ -80,14 +193,25 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const { return arra
  */
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyComparator &comparator) const {
-  // 1, find a key that more than input key ;
-  for (int i = 0; i < GetSize() - 1; ++i) {
-    if (comparator(key, KeyAt(i + 1)) < 0) {
-      return ValueAt(i);
+  // a key outside of the prefix is left or right of all keys, past it only the rest of the keys is compared
+  const char *key_data = reinterpret_cast<const char *>(&key);
+  int cmp = memcmp(key_data, &low_key_, prefix_size_);
+  if (cmp != 0) {
+    return ValueAt(cmp < 0 ? 0 : GetSize() - 1);
+  }
+  // binary search for the first key more than input key, the child left of it covers input key
+  int suffix_size = static_cast<int>(sizeof(KeyType)) - prefix_size_;
+  int low = 1;
+  int high = GetSize();
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (memcmp(SlotAt(mid), key_data + prefix_size_, suffix_size) <= 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
   }
-  // 2, all key less than input key
-  return ValueAt(GetSize() - 1);
+  return ValueAt(low - 1);
 }
 
 /*****************************************************************************
@@ -102,10 +226,13 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyCo
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                                                      const ValueType &new_value) {
-  array_[0].second = old_value;
-  array_[1] = {new_key, new_value};
+  SetKeyAt(0, new_key);
+  SetValueAt(0, old_value);
+  SetKeyAt(1, new_key);
+  SetValueAt(1, new_value);
   IncreaseSize(2);
 }
+
 /*
  * Insert new_key & new_value pair right after the pair with its value ==
  * old_value
@@ -114,13 +241,11 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(const ValueType &old_value,
 INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value, const KeyType &new_key,
                                                     const ValueType &new_value) {
-  int old_value_idx = ValueIndex(old_value);
+  int idx = ValueIndex(old_value) + 1;
   int size = GetSize();
-  int idx = old_value_idx + 1;
-  for (int i = size; i > idx; --i) {
-    array_[i] = array_[i - 1];
-  }
-  array_[idx] = {new_key, new_value};
+  memmove(SlotAt(idx + 1), SlotAt(idx), (size - idx) * SlotSize());
+  SetKeyAt(idx, new_key);
+  SetValueAt(idx, new_value);
   IncreaseSize(1);
   return size + 1;
 }
@@ -129,29 +254,25 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page, a new
+ * page that takes over the right half of the key range and is linked in after
+ * this one. Its first key is the one to push up.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient,
                                                 BufferPoolManager *buffer_pool_manager) {
   int size = GetSize();
   int half = size >> 1;
-  recipient->CopyNFrom(&array_[half], size - half, buffer_pool_manager);
-  SetSize(half);
-}
-
-/* Copy entries into me, starting from {items} and copy {size} entries.
- * Since it is an internal page, for all entries (pages) moved, their parents page now changes to me.
- * So I need to 'adopt' them by changing their parent page id, which needs to be persisted with BufferPoolManger
- */
-INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {
-  int cur_size = GetSize();
-  for (int i = 0; i < size; ++i) {
-    array_[cur_size + i] = *(items + i);
-    BPlusTreePage::UpdateChildParentId(array_[cur_size + i].second, GetPageId(), buffer_pool_manager);
+  KeyType middle_key = KeyAt(half);
+  recipient->SetHighKey(high_key_);
+  recipient->SetLowKey(middle_key);
+  recipient->SetNextPageId(next_page_id_);
+  for (int i = half; i < size; i++) {
+    recipient->CopyLastFrom(ItemAt(i), buffer_pool_manager);
   }
-  IncreaseSize(size);
+  SetSize(half);
+  SetHighKey(middle_key);
+  SetNextPageId(recipient->GetPageId());
 }
 
 /*****************************************************************************
@@ -164,10 +285,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, Buf
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
-  int size = GetSize();
-  for (int idx = index; idx < size - 1; idx++) {
-    array_[idx] = array_[idx + 1];
-  }
+  memmove(SlotAt(index), SlotAt(index + 1), (GetSize() - index - 1) * SlotSize());
   IncreaseSize(-1);
 }
 
@@ -178,23 +296,30 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
   SetSize(0);
-  return array_[0].second;
+  return ValueAt(0);
 }
+
 /*****************************************************************************
  * MERGE
  *****************************************************************************/
 /*
- * Remove all of key & value pairs from this page to "recipient" page.
+ * Remove all of key & value pairs from this page to "recipient" page, its left
+ * sibling, which takes over the key range and the right link of this page.
  * The middle_key is the separation key you should get from the parent. You need
  * to make sure the middle key is added to the recipient to maintain the invariant.
  * You also need to use BufferPoolManager to persist changes to the parent page id for those
- * pages that are moved to the recipient
+ * pages that are moved to the recipient. The caller makes sure they fit the
+ * widened recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                BufferPoolManager *buffer_pool_manager) {
-  array_[0].first = middle_key;
-  recipient->CopyNFrom(&array_[0], GetSize(), buffer_pool_manager);
+  recipient->SetHighKey(high_key_);
+  recipient->CopyLastFrom({middle_key, ValueAt(0)}, buffer_pool_manager);
+  for (int i = 1; i < GetSize(); i++) {
+    recipient->CopyLastFrom(ItemAt(i), buffer_pool_manager);
+  }
+  recipient->SetNextPageId(next_page_id_);
   SetSize(0);
 }
 
@@ -207,19 +332,17 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient,
  * The middle_key is the separation key you should get from the parent. You need
  * to make sure the middle key is added to the recipient to maintain the invariant.
  * You also need to use BufferPoolManager to persist changes to the parent page id for those
- * pages that are moved to the recipient
+ * pages that are moved to the recipient. The second key becomes the fence
+ * between the pages.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                       BufferPoolManager *buffer_pool_manager) {
-  array_[0].first = middle_key;
-  recipient->CopyNFrom(&array_[0], 1, buffer_pool_manager);
-
-  int size = GetSize();
-  for (int i = 0; i < size - 1; ++i) {
-    array_[i] = array_[i + 1];
-  }
-  IncreaseSize(-1);
+  KeyType new_middle_key = KeyAt(1);
+  recipient->SetHighKey(new_middle_key);
+  recipient->CopyLastFrom({middle_key, ValueAt(0)}, buffer_pool_manager);
+  Remove(0);
+  SetLowKey(new_middle_key);
 }
 
 /* Append an entry at the end.
@@ -228,8 +351,11 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
-  MappingType item = pair;
-  CopyNFrom(&item, 1, buffer_pool_manager);
+  int size = GetSize();
+  SetKeyAt(size, pair.first);
+  SetValueAt(size, pair.second);
+  IncreaseSize(1);
+  BPlusTreePage::UpdateChildParentId(pair.second, GetPageId(), buffer_pool_manager);
 }
 
 /*
@@ -237,26 +363,19 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, Buffe
  * You need to handle the original dummy key properly, e.g. updating recipient’s array to position the middle_key at the
  * right place.
  * You also need to use BufferPoolManager to persist changes to the parent page id for those pages that are
- * moved to the recipient
+ * moved to the recipient. The moved key becomes the fence between the pages.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                        BufferPoolManager *buffer_pool_manager) {
-  // consider if the end of value is empty ?
-  // new pair(mid_key, the end of value) and append to rec beginning
-  int size = GetSize();
-  if (size == 1) {
-    // cur node should be delete and remian only one key and value
-    // set key_0 = middle_key and move fastly
-    MappingType pair = {middle_key, ValueAt(0)};
-    recipient->CopyFirstFrom(pair, buffer_pool_manager);
-    IncreaseSize(-1);
-  } else {
-    recipient->SetKeyAt(0, middle_key);
-    // new pair(the end of key and prev value)
-    recipient->CopyFirstFrom(array_[size - 1], buffer_pool_manager);
-    IncreaseSize(-1);
-  }
+  // the recipient's first child moves up one place and gets the middle key as its separator
+  MappingType pair = ItemAt(GetSize() - 1);
+  recipient->SetKeyAt(0, middle_key);
+  recipient->SetLowKey(pair.first);
+  // new pair(the end of key and prev value)
+  recipient->CopyFirstFrom(pair, buffer_pool_manager);
+  IncreaseSize(-1);
+  SetHighKey(pair.first);
 }
 
 /* Append an entry at the beginning.
@@ -265,14 +384,10 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *re
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
-  array_[0].first = pair.first;
-  int size = GetSize();
-  for (int i = size; i > 0; --i) {
-    array_[i] = array_[i - 1];
-  }
-  array_[0].second = pair.second;
+  memmove(SlotAt(1), SlotAt(0), GetSize() * SlotSize());
+  SetKeyAt(0, pair.first);
+  SetValueAt(0, pair.second);
   IncreaseSize(1);
-
   // update child's parent id
   BPlusTreePage::UpdateChildParentId(pair.second, GetPageId(), buffer_pool_manager);
 }
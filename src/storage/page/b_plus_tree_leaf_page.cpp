@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include "common/exception.h"
@@ -25,7 +27,8 @@ namespace bustub {
 /**
  * Init method after creating a new leaf page
  * Including set page type, set current size to zero, set page id/parent id, set
- * next page id and set max size
+ * next/prev page id and set max size. The fences start out as the smallest and the
+ * largest key, nothing to share.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
@@ -38,10 +41,14 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, in
   SetParentPageId(parent_id);
   SetPageId(page_id);
   SetNextPageId(INVALID_PAGE_ID);
+  SetPrevPageId(INVALID_PAGE_ID);
+  prefix_size_ = 0;
+  memset(&low_key_, 0, sizeof(KeyType));
+  memset(&high_key_, 0xff, sizeof(KeyType));
 }
 
 /**
- * Helper methods to set/get next page id
+ * Helper methods to set/get next/prev page id
  */
 INDEX_TEMPLATE_ARGUMENTS
 page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
@@ -49,17 +56,99 @@ page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { return next_page_i
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
 
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const { return prev_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) { prev_page_id_ = prev_page_id; }
+
 /**
- * Helper method to find the first index i so that array[i].first >= key
- * NOTE: This method is only used when generating index iterator
+ * Helper methods to set/get the fence keys. Setting one re-encodes the entries
+ * if the prefix the fences share changes, all of them must lie within the new
+ * fences, and fit the page.
  */
 INDEX_TEMPLATE_ARGUMENTS
-int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const {
-  for (int i = 0; i < GetSize(); i++) {
-    if (comparator(array_[i].first, key) == 0) {
-      return i;
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetLowKey() const { return low_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetLowKey(const KeyType &low_key) {
+  KeyType old_low_key = low_key_;
+  low_key_ = low_key;
+  UpdatePrefix(old_low_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const { return high_key_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetHighKey(const KeyType &high_key) {
+  KeyType old_high_key = high_key_;
+  high_key_ = high_key;
+  UpdatePrefix(old_high_key);
+}
+
+/**
+ * @return whether key belongs to a page right of this one
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::IsPastHighKey(const KeyType &key, const KeyComparator &comparator) const {
+  return next_page_id_ != INVALID_PAGE_ID && comparator(key, high_key_) >= 0;
+}
+
+/**
+ * Helper methods to get the number of key bytes all entries share, and the
+ * number of entries the page holds with its fences, or with other fences
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrefixSize() const { return prefix_size_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetCapacity() const { return CapacityFor(low_key_, high_key_); }
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::CapacityFor(const KeyType &low_key, const KeyType &high_key) const {
+  int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key),
+                                     reinterpret_cast<const char *>(&high_key), sizeof(KeyType));
+  int slot_size = static_cast<int>(sizeof(KeyType) + sizeof(ValueType)) - prefix_size;
+  int free_space = PAGE_SIZE - static_cast<int>(slots_ - reinterpret_cast<const char *>(this));
+  return std::min(GetMaxSize(), free_space / slot_size);
+}
+
+/**
+ * Helper method to find the first index i so that KeyAt(i) >= key, GetSize() if there is none. Past the prefix only
+ * the rest of the keys is compared.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::LowerBound(const KeyType &key, const KeyComparator &comparator) const {
+  const char *key_data = reinterpret_cast<const char *>(&key);
+  int cmp = memcmp(key_data, &low_key_, prefix_size_);
+  if (cmp != 0) {
+    return cmp < 0 ? 0 : GetSize();
+  }
+  int suffix_size = static_cast<int>(sizeof(KeyType)) - prefix_size_;
+  int low = 0;
+  int high = GetSize();
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (memcmp(SlotAt(mid), key_data + prefix_size_, suffix_size) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
   }
+  return low;
+}
+
+/**
+ * Helper method to find the index of key
+ * @return -1 if the key is not in the page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const {
+  int idx = LowerBound(key, comparator);
+  if (idx < GetSize() && comparator(KeyAt(idx), key) == 0) {
+    return idx;
+  }
   return -1;
 }
 
@@ -68,16 +157,61 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator
  * array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const { return array_[index].first; }
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
+  KeyType key;
+  char *key_data = reinterpret_cast<char *>(&key);
+  memcpy(key_data, &low_key_, prefix_size_);
+  memcpy(key_data + prefix_size_, SlotAt(index), sizeof(KeyType) - prefix_size_);
+  return key;
+}
 
 /*
  * Helper method to find and return the key & value pair associated with input
  * "index"(a.k.a array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
-  // replace with your own code
-  return array_[index];
+MappingType B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) const {
+  ValueType value;
+  memcpy(&value, SlotAt(index) + sizeof(KeyType) - prefix_size_, sizeof(ValueType));
+  return {KeyAt(index), value};
+}
+
+/*
+ * Helper methods to address the slots and to write an entry into one
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::SlotSize() const {
+  return static_cast<int>(sizeof(KeyType) + sizeof(ValueType)) - prefix_size_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+char *B_PLUS_TREE_LEAF_PAGE_TYPE::SlotAt(int index) { return slots_ + index * SlotSize(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+const char *B_PLUS_TREE_LEAF_PAGE_TYPE::SlotAt(int index) const { return slots_ + index * SlotSize(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetItemAt(int index, const KeyType &key, const ValueType &value) {
+  char *slot = SlotAt(index);
+  memcpy(slot, reinterpret_cast<const char *>(&key) + prefix_size_, sizeof(KeyType) - prefix_size_);
+  memcpy(slot + sizeof(KeyType) - prefix_size_, &value, sizeof(ValueType));
+}
+
+/*
+ * Helper method to re-encode the entries after a fence moved, old_fence is the
+ * key it moved from
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::UpdatePrefix(const KeyType &old_fence) {
+  int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key_),
+                                     reinterpret_cast<const char *>(&high_key_), sizeof(KeyType));
+  if (prefix_size == prefix_size_) {
+    return;
+  }
+  BUSTUB_ASSERT(prefix_size > prefix_size_ || GetSize() <= GetCapacity(), "entries do not fit the widened page");
+  ResizeSlots(slots_, GetSize(), sizeof(KeyType), sizeof(ValueType), reinterpret_cast<const char *>(&old_fence),
+              prefix_size_, prefix_size);
+  prefix_size_ = prefix_size;
 }
 
 /*****************************************************************************
@@ -89,17 +223,10 @@ const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator) {
-  int idx = 0;
+  int idx = LowerBound(key, comparator);
   int size = GetSize();
-  for (; idx < size; ++idx) {
-    if (comparator(key, array_[idx].first) < 0) {
-      break;
-    }
-  }
-  for (int i = size; i > idx; --i) {
-    array_[i] = array_[i - 1];
-  }
-  array_[idx] = {key, value};
+  memmove(SlotAt(idx + 1), SlotAt(idx), (size - idx) * SlotSize());
+  SetItemAt(idx, key, value);
   IncreaseSize(1);
   return size + 1;
 }
@@ -108,24 +235,35 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &valu
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page, a new
+ * page that takes over the right half of the key range and is linked in after
+ * this one. The caller links the page right of it back to the recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient) {
   int size = GetSize();
   int half = size >> 1;
-  recipient->CopyNFrom(&array_[half], size - half);
+  KeyType middle_key = KeyAt(half);
+  recipient->SetHighKey(high_key_);
+  recipient->SetLowKey(middle_key);
+  recipient->SetNextPageId(next_page_id_);
+  recipient->SetPrevPageId(GetPageId());
+  for (int i = half; i < size; i++) {
+    recipient->CopyLastFrom(GetItem(i));
+  }
   SetSize(half);
+  SetHighKey(middle_key);
+  SetNextPageId(recipient->GetPageId());
 }
 
 /*
  * Copy starting from items, and copy {size} number of elements into me.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(const MappingType *items, int size) {
   int cur_size = GetSize();
   for (int i = 0; i < size; i++) {
-    array_[cur_size + i] = *(items + i);
+    SetItemAt(cur_size + i, items[i].first, items[i].second);
   }
   IncreaseSize(size);
 }
@@ -140,13 +278,12 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType *value, const KeyComparator &comparator) const {
-  for (int i = 0; i < GetSize(); i++) {
-    if (comparator(key, array_[i].first) == 0) {
-      *value = array_[i].second;
-      return true;
-    }
+  int idx = KeyIndex(key, comparator);
+  if (idx == -1) {
+    return false;
   }
-  return false;
+  *value = GetItem(idx).second;
+  return true;
 }
 
 /*****************************************************************************
@@ -166,9 +303,7 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
     return size;
   }
   // remove
-  for (int i = idx; i < size - 1; ++i) {
-    array_[i] = array_[i + 1];
-  }
+  memmove(SlotAt(idx), SlotAt(idx + 1), (size - idx - 1) * SlotSize());
   IncreaseSize(-1);
   return size - 1;
 }
@@ -177,29 +312,37 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
  * MERGE
  *****************************************************************************/
 /*
- * Remove all of key & value pairs from this page to "recipient" page. Don't forget
- * to update the next_page id in the sibling page
+ * Remove all of key & value pairs from this page to "recipient" page, its left
+ * sibling, which takes over the key range and the right link of this page.
+ * The caller makes sure they fit the widened recipient, and links the page
+ * right of it back to the recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient) {
-  recipient->CopyNFrom(&array_[0], GetSize());
+  recipient->SetHighKey(high_key_);
+  for (int i = 0; i < GetSize(); i++) {
+    recipient->CopyLastFrom(GetItem(i));
+  }
   recipient->SetNextPageId(GetNextPageId());
+  SetSize(0);
 }
 
 /*****************************************************************************
  * REDISTRIBUTE
  *****************************************************************************/
 /*
- * Remove the first key & value pair from this page to "recipient" page.
+ * Remove the first key & value pair from this page to "recipient" page, the
+ * left sibling. The second key becomes the fence between them, so this page
+ * must hold two entries at least.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient) {
-  recipient->CopyNFrom(&array_[0], 1);
-  int size = GetSize();
-  for (int i = 0; i < size - 1; ++i) {
-    array_[i] = array_[i + 1];
-  }
+  KeyType middle_key = KeyAt(1);
+  recipient->SetHighKey(middle_key);
+  recipient->CopyLastFrom(GetItem(0));
+  memmove(SlotAt(0), SlotAt(1), (GetSize() - 1) * SlotSize());
   IncreaseSize(-1);
+  SetLowKey(middle_key);
 }
 
 /*
@@ -207,19 +350,21 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient)
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
-  int size = GetSize();
-  array_[size] = item;
+  SetItemAt(GetSize(), item.first, item.second);
   IncreaseSize(1);
 }
 
 /*
- * Remove the last key & value pair from this page to "recipient" page.
+ * Remove the last key & value pair from this page to "recipient" page, the
+ * right sibling. The moved key becomes the fence between them.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient) {
-  int size = GetSize();
-  recipient->CopyNFrom(&array_[size - 1], 1);
+  MappingType item = GetItem(GetSize() - 1);
+  recipient->SetLowKey(item.first);
+  recipient->CopyFirstFrom(item);
   IncreaseSize(-1);
+  SetHighKey(item.first);
 }
 
 /*
@@ -227,11 +372,8 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient)
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(const MappingType &item) {
-  int size = GetSize();
-  for (int i = size; i > 0; --i) {
-    array_[i] = array_[i - 1];
-  }
-  array_[0] = item;
+  memmove(SlotAt(1), SlotAt(0), GetSize() * SlotSize());
+  SetItemAt(0, item.first, item.second);
   IncreaseSize(1);
 }
 
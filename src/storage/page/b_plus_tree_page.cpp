@@ -11,6 +11,10 @@
 
 #include "storage/page/b_plus_tree_page.h"
 
+#include <cstring>
+
+#include "storage/index/index_page_log.h"
+
 namespace bustub {
 
 /*
@@ -19,6 +23,8 @@ namespace bustub {
  */
 bool BPlusTreePage::IsLeafPage() const { return page_type_ == IndexPageType::LEAF_PAGE; }
 bool BPlusTreePage::IsRootPage() const { return parent_page_id_ == INVALID_PAGE_ID; }
+// a page merged into its left sibling, or a replaced root, is left with no page type for readers still on their way
+bool BPlusTreePage::IsDeletedPage() const { return page_type_ == IndexPageType::INVALID_INDEX_PAGE; }
 void BPlusTreePage::SetPageType(IndexPageType page_type) { page_type_ = page_type; }
 
 /*
@@ -62,8 +68,42 @@ void BPlusTreePage::UpdateChildParentId(page_id_t page_id, page_id_t parent_id,
                                         BufferPoolManager *buffer_pool_manager) {
   Page *page = buffer_pool_manager->FetchPage(page_id);
   BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  IndexPageLog::TrackCurrent(page_id);
   node->SetParentPageId(parent_id);
   buffer_pool_manager->UnpinPage(page_id, true);
 }
 
+/*
+ * Helper method to count the leading bytes two keys have in common
+ */
+int BPlusTreePage::CommonPrefixSize(const char *lhs, const char *rhs, int key_size) {
+  int size = 0;
+  while (size < key_size && lhs[size] == rhs[size]) {
+    size++;
+  }
+  return size;
+}
+
+/*
+ * Re-encode count slots, each the key bytes after the prefix followed by the value, for a new prefix size. The slots
+ * shrink in place front to back, or grow back to front taking the bytes the prefix loses from prefix, which holds at
+ * least the old prefix.
+ */
+void BPlusTreePage::ResizeSlots(char *slots, int count, int key_size, int value_size, const char *prefix,
+                                int old_prefix_size, int new_prefix_size) {
+  int old_slot_size = key_size - old_prefix_size + value_size;
+  int new_slot_size = key_size - new_prefix_size + value_size;
+  if (new_prefix_size > old_prefix_size) {
+    for (int i = 0; i < count; i++) {
+      memmove(slots + i * new_slot_size, slots + i * old_slot_size + new_prefix_size - old_prefix_size, new_slot_size);
+    }
+  } else if (new_prefix_size < old_prefix_size) {
+    for (int i = count - 1; i >= 0; i--) {
+      char *slot = slots + i * new_slot_size;
+      memmove(slot + old_prefix_size - new_prefix_size, slots + i * old_slot_size, old_slot_size);
+      memcpy(slot, prefix + new_prefix_size, old_prefix_size - new_prefix_size);
+    }
+  }
+}
+
 }  // namespace bustub
@@ -13,6 +13,8 @@
 #include "storage/page/table_page.h"
 
 #include <cassert>
+#include <utility>
+#include <vector>
 
 namespace bustub {
 
@@ -171,8 +173,19 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
     } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+    lsn_t lsn;
+    if (tuple_size == new_tuple.size_) {
+      // the tuple is overwritten in place, so only the bytes that change are needed for redo and undo
+      std::vector<char> delta;
+      Tuple::EncodeDelta(*old_tuple, new_tuple, &delta);
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::DELTAUPDATE, rid,
+                           std::move(delta));
+      lsn = log_manager->AppendLogRecord(&log_record);
+    } else {
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple,
+                           new_tuple);
+      lsn = log_manager->AppendLogRecord(&log_record);
+    }
     SetLSN(lsn);
     txn->SetPrevLSN(lsn);
   }
@@ -197,6 +210,43 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   return true;
 }
 
+bool TablePage::UpdateTupleDelta(const std::vector<char> &delta, const RID &rid, Transaction *txn,
+                                 LockManager *lock_manager, LogManager *log_manager) {
+  uint32_t slot_num = rid.GetSlotNum();
+  // If the slot number is invalid, abort the transaction.
+  if (slot_num >= GetTupleCount()) {
+    if (enable_logging) {
+      txn->SetState(TransactionState::ABORTED);
+    }
+    return false;
+  }
+  // If the tuple is deleted, abort the transaction.
+  if (IsDeleted(GetTupleSize(slot_num))) {
+    if (enable_logging) {
+      txn->SetState(TransactionState::ABORTED);
+    }
+    return false;
+  }
+
+  if (enable_logging) {
+    // Acquire an exclusive lock, upgrading from shared if necessary.
+    if (txn->IsSharedLocked(rid)) {
+      if (!lock_manager->LockUpgrade(txn, rid)) {
+        return false;
+      }
+    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
+      return false;
+    }
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::DELTAUPDATE, rid, delta);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+    SetLSN(lsn);
+    txn->SetPrevLSN(lsn);
+  }
+
+  Tuple::ApplyDelta(GetData() + GetTupleOffsetAtSlot(slot_num), delta);
+  return true;
+}
+
 void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
   uint32_t slot_num = rid.GetSlotNum();
   BUSTUB_ASSERT(slot_num < GetTupleCount(), "Cannot have more slots than tuples.");
@@ -305,10 +355,27 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   return true;
 }
 
-bool TablePage::GetFirstTupleRid(RID *first_rid) {
+bool TablePage::ReadTuple(const RID &rid, Tuple *tuple) {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount() || IsDeleted(GetTupleSize(slot_num))) {
+    return false;
+  }
+  uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
+  tuple->size_ = GetTupleSize(slot_num);
+  if (tuple->allocated_) {
+    delete[] tuple->data_;
+  }
+  tuple->data_ = new char[tuple->size_];
+  memcpy(tuple->data_, GetData() + tuple_offset, tuple->size_);
+  tuple->rid_ = rid;
+  tuple->allocated_ = true;
+  return true;
+}
+
+bool TablePage::GetFirstTupleRid(RID *first_rid, bool include_empty) {
   // Find and return the first valid tuple.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (include_empty || !IsDeleted(GetTupleSize(i))) {
       first_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -317,11 +384,11 @@ bool TablePage::GetFirstTupleRid(RID *first_rid) {
   return false;
 }
 
-bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
+bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool include_empty) {
   BUSTUB_ASSERT(cur_rid.GetPageId() == GetTablePageId(), "Wrong table!");
   // Find and return the first valid tuple after our current slot number.
   for (auto i = cur_rid.GetSlotNum() + 1; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (include_empty || !IsDeleted(GetTupleSize(i))) {
       next_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -11,6 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include <cassert>
+#include <cstring>
+#include <utility>
+#include <vector>
 
 #include "common/logger.h"
 #include "storage/table/table_heap.h"
@@ -37,6 +40,11 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
+  // A read-only transaction has no write set to undo the write with.
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
@@ -81,6 +89,8 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  // The slot held no tuple before, older snapshots must not see it.
+  versions_.RecordWrite(*rid, txn, nullptr);
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
@@ -90,7 +100,37 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   return true;
 }
 
+bool TableHeap::BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn, bool *result) {
+  // The transaction manager moves an optimistic transaction out of growing once it writes the buffered tuples.
+  if (!txn->IsOptimistic() || txn->GetState() != TransactionState::GROWING) {
+    return false;
+  }
+  auto buffered = txn->GetBufferedWriteSet();
+  auto it = buffered->find(rid);
+  if (it == buffered->end()) {
+    buffered->emplace(rid, TableWriteRecord(rid, wtype, tuple, this));
+    *result = true;
+  } else if (it->second.wtype_ == WType::DELETE) {
+    // the tuple is gone for the transaction already
+    *result = false;
+  } else {
+    it->second.wtype_ = wtype;
+    it->second.tuple_ = tuple;
+    *result = true;
+  }
+  return true;
+}
+
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
+  // A read-only transaction has no write set to undo the write with.
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  bool buffered;
+  if (BufferWrite(rid, WType::DELETE, Tuple{}, txn, &buffered)) {
+    return buffered;
+  }
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -99,9 +139,24 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  // Otherwise, mark the tuple as deleted.
+  // Otherwise, mark the tuple as deleted; but first save the old version for snapshots.
+  Tuple old_tuple;
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  bool has_old = page->ReadTuple(rid, &old_tuple);
+  if (!versions_.CanWrite(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (!page->MarkDelete(rid, txn, lock_manager_, log_manager_)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    return false;
+  }
+  if (has_old) {
+    versions_.RecordWrite(rid, txn, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +165,15 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  // A read-only transaction has no write set to undo the write with.
+  if (txn->IsReadOnly()) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  bool buffered;
+  if (BufferWrite(rid, WType::UPDATE, tuple, txn, &buffered)) {
+    return buffered;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,12 +184,30 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
+  if (!versions_.CanWrite(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  // An update that wrote the same bytes again needs neither an older version nor an undo record.
+  bool is_changed = is_updated && (old_tuple.GetLength() != tuple.GetLength() ||
+                                   memcmp(old_tuple.GetData(), tuple.GetData(), tuple.GetLength()) != 0);
+  if (is_changed) {
+    versions_.RecordWrite(rid, txn, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
-  // Update the transaction's write set.
-  if (is_updated && txn->GetState() != TransactionState::ABORTED) {
-    txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
+  // Update the transaction's write set, an update in place only needs the bytes it changed.
+  if (is_changed && txn->GetState() != TransactionState::ABORTED) {
+    if (old_tuple.GetLength() != tuple.GetLength()) {
+      txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
+    } else {
+      TableWriteRecord write_record(rid, WType::UPDATE, Tuple{}, this);
+      Tuple::EncodeDelta(old_tuple, tuple, &write_record.delta_);
+      txn->GetWriteSet()->push_back(std::move(write_record));
+    }
   }
   return is_updated;
 }
@@ -142,6 +224,19 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+void TableHeap::RollbackInsert(const RID &rid, Transaction *txn) {
+  // Find the page which contains the tuple.
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  // The slot can be reused as soon as the latch is released, so the version goes with the tuple.
+  page->WLatch();
+  page->ApplyDelete(rid, txn, log_manager_);
+  versions_.Abort(rid, txn);
+  lock_manager_->Unlock(txn, rid);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+}
+
 void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -153,6 +248,17 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+void TableHeap::RollbackUpdate(const std::vector<char> &delta, const RID &rid, Transaction *txn) {
+  // Find the page which contains the tuple.
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  // Write the old bytes back.
+  page->WLatch();
+  page->UpdateTupleDelta(Tuple::ReverseDelta(delta), rid, txn, lock_manager_, log_manager_);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+}
+
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -161,9 +267,32 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  // Read the tuple from the page.
+  // An optimistic transaction reads its own buffered writes first.
+  if (txn->IsOptimistic()) {
+    auto buffered = txn->GetBufferedWriteSet();
+    auto it = buffered->find(rid);
+    if (it != buffered->end()) {
+      buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+      if (it->second.wtype_ == WType::DELETE) {
+        return false;
+      }
+      *tuple = it->second.tuple_;
+      tuple->rid_ = rid;
+      return true;
+    }
+  }
+  // Read the tuple from the page, snapshot and optimistic reads take no lock and fall back to an older version.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (txn->IsOptimistic()) {
+    timestamp_t ts;
+    res = versions_.ReadLatest(rid, txn, page->ReadTuple(rid, tuple), tuple, &ts);
+    txn->GetReadSet()->emplace(rid, TableReadRecord(this, ts));
+  } else if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    res = versions_.Resolve(rid, txn, page->ReadTuple(rid, tuple), tuple);
+  } else {
+    res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
@@ -178,7 +307,8 @@ TableIterator TableHeap::Begin(Transaction *txn) {
     auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-    auto found_tuple = page->GetFirstTupleRid(&rid);
+    // A snapshot may still see a tuple in a slot that is empty by now.
+    auto found_tuple = page->GetFirstTupleRid(&rid, txn->ReadsVersions());
     page->RUnlatch();
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (found_tuple) {
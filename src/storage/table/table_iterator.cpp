@@ -19,7 +19,9 @@ namespace bustub {
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
     : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_) && ReadsVersions()) {
+      ++(*this);
+    }
   }
 }
 
@@ -34,33 +36,42 @@ Tuple *TableIterator::operator->() {
 }
 
 TableIterator &TableIterator::operator++() {
+  bool reads_versions = ReadsVersions();
+  bool found;
+  do {
+    found = Step(reads_versions);
+  } while (reads_versions && !found && *this != table_heap_->End());
+  return *this;
+}
+
+bool TableIterator::Step(bool include_empty) {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
   auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
   cur_page->RLatch();
   assert(cur_page != nullptr);  // all pages are pinned
   RID next_tuple_rid;
 
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 &next_tuple_rid)) {  // end of this page
+  if (!cur_page->GetNextTupleRid(tuple_->rid_, &next_tuple_rid, include_empty)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
       auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
+      if (cur_page->GetFirstTupleRid(&next_tuple_rid, include_empty)) {
         break;
       }
     }
   }
   tuple_->rid_ = next_tuple_rid;
+  bool found = false;
   if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    found = table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
   }
   // release until copy the tuple
   cur_page->RUnlatch();
   buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-  return *this;
+  return found;
 }
 
 TableIterator TableIterator::operator++(int) {
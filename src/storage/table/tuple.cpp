@@ -162,4 +162,64 @@ void Tuple::DeserializeFrom(const char *storage) {
   this->allocated_ = true;
 }
 
+// a range header costs 4 bytes, a gap inside a merged range costs twice its length
+static constexpr uint32_t DELTA_RANGE_HEADER_SIZE = 2 * sizeof(uint16_t);
+static constexpr uint32_t DELTA_MAX_MERGED_GAP = DELTA_RANGE_HEADER_SIZE / 2;
+
+void Tuple::EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::vector<char> *delta) {
+  assert(old_tuple.size_ == new_tuple.size_);
+  uint32_t size = old_tuple.size_;
+  uint32_t pos = 0;
+  while (pos < size) {
+    if (old_tuple.data_[pos] == new_tuple.data_[pos]) {
+      pos++;
+      continue;
+    }
+    // extend the range over every difference that is at most DELTA_MAX_MERGED_GAP equal bytes away
+    uint32_t begin = pos;
+    uint32_t end = pos + 1;
+    for (uint32_t i = end; i < size && i <= end + DELTA_MAX_MERGED_GAP; i++) {
+      if (old_tuple.data_[i] != new_tuple.data_[i]) {
+        end = i + 1;
+      }
+    }
+    auto offset = static_cast<uint16_t>(begin);
+    auto length = static_cast<uint16_t>(end - begin);
+    size_t at = delta->size();
+    delta->resize(at + DELTA_RANGE_HEADER_SIZE + 2 * length);
+    memcpy(delta->data() + at, &offset, sizeof(uint16_t));
+    memcpy(delta->data() + at + sizeof(uint16_t), &length, sizeof(uint16_t));
+    memcpy(delta->data() + at + DELTA_RANGE_HEADER_SIZE, old_tuple.data_ + begin, length);
+    memcpy(delta->data() + at + DELTA_RANGE_HEADER_SIZE + length, new_tuple.data_ + begin, length);
+    pos = end;
+  }
+}
+
+std::vector<char> Tuple::ReverseDelta(const std::vector<char> &delta) {
+  std::vector<char> reversed(delta.size());
+  size_t at = 0;
+  while (at < delta.size()) {
+    uint16_t length;
+    memcpy(&length, delta.data() + at + sizeof(uint16_t), sizeof(uint16_t));
+    const char *bytes = delta.data() + at + DELTA_RANGE_HEADER_SIZE;
+    memcpy(reversed.data() + at, delta.data() + at, DELTA_RANGE_HEADER_SIZE);
+    memcpy(reversed.data() + at + DELTA_RANGE_HEADER_SIZE, bytes + length, length);
+    memcpy(reversed.data() + at + DELTA_RANGE_HEADER_SIZE + length, bytes, length);
+    at += DELTA_RANGE_HEADER_SIZE + 2 * length;
+  }
+  return reversed;
+}
+
+void Tuple::ApplyDelta(char *tuple_data, const std::vector<char> &delta) {
+  size_t at = 0;
+  while (at < delta.size()) {
+    uint16_t offset;
+    uint16_t length;
+    memcpy(&offset, delta.data() + at, sizeof(uint16_t));
+    memcpy(&length, delta.data() + at + sizeof(uint16_t), sizeof(uint16_t));
+    memcpy(tuple_data + offset, delta.data() + at + DELTA_RANGE_HEADER_SIZE + length, length);
+    at += DELTA_RANGE_HEADER_SIZE + 2 * length;
+  }
+}
+
 }  // namespace bustub
@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -688,4 +689,136 @@ TEST(CatalogTest, DISABLED_IndexInteraction3) {
   remove("catalog_test.log");
 }
 
+// A non-unique index returns the tuples of a key in rid order, each one once, however many tuples share the key
+TEST(CatalogTest, NonUniqueIndex) {
+  auto disk_manager = std::make_unique<DiskManager>("catalog_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(64, disk_manager.get());
+  auto catalog = std::make_unique<Catalog>(bpm.get(), nullptr, nullptr);
+  auto txn = std::make_unique<Transaction>(0);
+
+  const std::string table_name{"foobar"};
+  const std::string index_name{"index1"};
+
+  // Construct a new table of a low cardinality column A and fill it before the index exists
+  std::vector<Column> columns{{"A", TypeId::INTEGER}, {"B", TypeId::INTEGER}};
+  Schema table_schema{columns};
+  auto *table_info = catalog->CreateTable(txn.get(), table_name, table_schema);
+  EXPECT_NE(Catalog::NULL_TABLE_INFO, table_info);
+  const int groups = 4;
+  std::vector<std::vector<RID>> group_rids(groups);
+  auto insert_tuple = [&](int i) {
+    Tuple tuple{std::vector<Value>{ValueFactory::GetIntegerValue(i % groups), ValueFactory::GetIntegerValue(i)},
+                &table_schema};
+    RID rid;
+    EXPECT_TRUE(table_info->table_->InsertTuple(tuple, &rid, txn.get()));
+    group_rids[i % groups].push_back(rid);
+    return tuple;
+  };
+  for (int i = 0; i < 2000; i++) {
+    insert_tuple(i);
+  }
+
+  // Construct a non-unique index on A, built from the table
+  std::vector<Column> key_columns{{"A", TypeId::INTEGER}};
+  std::vector<uint32_t> key_attrs{0};
+  Schema key_schema{key_columns};
+  // An 8 byte key would leave no room for A next to the rid
+  EXPECT_EQ(Catalog::NULL_INDEX_INFO, (catalog->CreateIndex<GenericKey<8>, RID, GenericComparator<8>>(
+                                          txn.get(), index_name, table_name, table_schema, key_schema, key_attrs, 8,
+                                          HashFunction<GenericKey<8>>{}, false)));
+  auto *index_info = catalog->CreateIndex<GenericKey<16>, RID, GenericComparator<16>>(
+      txn.get(), index_name, table_name, table_schema, key_schema, key_attrs, 16, HashFunction<GenericKey<16>>{},
+      false);
+  EXPECT_NE(Catalog::NULL_INDEX_INFO, index_info);
+  auto *index = index_info->index_.get();
+  EXPECT_FALSE(index->IsUnique());
+
+  auto check = [&]() {
+    for (int group = 0; group < groups; group++) {
+      Tuple key{std::vector<Value>{ValueFactory::GetIntegerValue(group)}, &key_schema};
+      std::vector<RID> results;
+      index->ScanKey(key, &results, txn.get());
+      std::vector<RID> expected = group_rids[group];
+      std::sort(expected.begin(), expected.end(), [](const RID &a, const RID &b) { return a.Get() < b.Get(); });
+      EXPECT_EQ(expected, results);
+    }
+    Tuple missing{std::vector<Value>{ValueFactory::GetIntegerValue(groups)}, &key_schema};
+    std::vector<RID> results;
+    index->ScanKey(missing, &results, txn.get());
+    EXPECT_TRUE(results.empty());
+
+    // a batch in any order, with repeats, gets the same answers
+    std::vector<Tuple> keys;
+    for (int group : {3, groups, 0, 3, 1, 2}) {
+      keys.emplace_back(std::vector<Value>{ValueFactory::GetIntegerValue(group)}, &key_schema);
+    }
+    std::vector<std::vector<RID>> batch_results;
+    index->ScanKeys(keys, &batch_results, txn.get());
+    ASSERT_EQ(batch_results.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      results.clear();
+      index->ScanKey(keys[i], &results, txn.get());
+      EXPECT_EQ(batch_results[i], results);
+    }
+  };
+  check();
+
+  // Entries inserted and deleted one by one keep the others of their key
+  for (int i = 2000; i < 3000; i++) {
+    Tuple tuple = insert_tuple(i);
+    index->InsertEntry(tuple.KeyFromTuple(table_schema, key_schema, key_attrs), group_rids[i % groups].back(),
+                       txn.get());
+  }
+  check();
+  std::vector<RID> &first_group = group_rids[0];
+  for (size_t i = 0; i < first_group.size(); i += 2) {
+    Tuple key{std::vector<Value>{ValueFactory::GetIntegerValue(0)}, &key_schema};
+    index->DeleteEntry(key, first_group[i], txn.get());
+    first_group[i] = RID();
+  }
+  first_group.erase(std::remove(first_group.begin(), first_group.end(), RID()), first_group.end());
+  check();
+
+  // The key logged for undo is found again without its rid
+  GenericKey<16> stored_key;
+  stored_key.SetFromKey(Tuple{std::vector<Value>{ValueFactory::GetIntegerValue(3)}, &key_schema}, &key_schema,
+                        group_rids[3][0]);
+  EXPECT_EQ(group_rids[3][0], stored_key.GetRid());
+  Tuple key = index->KeyFromStoredKey(stored_key.data_);
+  EXPECT_EQ(key.GetValue(&key_schema, 0).CompareEquals(ValueFactory::GetIntegerValue(3)), CmpBool::CmpTrue);
+
+  remove("catalog_test.db");
+  remove("catalog_test.log");
+}
+
+// NOLINTNEXTLINE
+TEST(CatalogTest, VarcharKeyIndex) {
+  auto disk_manager = std::make_unique<DiskManager>("catalog_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(32, disk_manager.get());
+  auto catalog = std::make_unique<Catalog>(bpm.get(), nullptr, nullptr);
+  auto txn = std::make_unique<Transaction>(0);
+
+  const std::string table_name{"foobar"};
+  std::vector<Column> columns{{"A", TypeId::INTEGER}, {"B", TypeId::VARCHAR, 20}};
+  Schema table_schema{columns};
+  EXPECT_NE(Catalog::NULL_TABLE_INFO, catalog->CreateTable(txn.get(), table_name, table_schema));
+  std::vector<Column> key_columns{{"B", TypeId::VARCHAR, 20}};
+  std::vector<uint32_t> key_attrs{1};
+  Schema key_schema{key_columns};
+
+  // strings longer than the key would be cut off and compare equal
+  EXPECT_EQ(Catalog::NULL_INDEX_INFO, (catalog->CreateIndex<GenericKey<16>, RID, GenericComparator<16>>(
+                                          txn.get(), "index1", table_name, table_schema, key_schema, key_attrs, 16,
+                                          HashFunction<GenericKey<16>>{})));
+  EXPECT_EQ(Catalog::NULL_INDEX_INFO, (catalog->CreateIndex<GenericKey<16>, RID, GenericComparator<16>>(
+                                          txn.get(), "index1", table_name, table_schema, key_schema, key_attrs, 16,
+                                          HashFunction<GenericKey<16>>{}, false)));
+  EXPECT_NE(Catalog::NULL_INDEX_INFO, (catalog->CreateIndex<GenericKey<32>, RID, GenericComparator<32>>(
+                                          txn.get(), "index1", table_name, table_schema, key_schema, key_attrs, 32,
+                                          HashFunction<GenericKey<32>>{}, false)));
+
+  remove("catalog_test.db");
+  remove("catalog_test.log");
+}
+
 }  // namespace bustub
@@ -10,6 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <shared_mutex>
 #include <thread>  // NOLINT
 #include <vector>
 
@@ -57,4 +61,70 @@ TEST(RWLatchTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// NOLINTNEXTLINE
+TEST(RWLatchTest, MixedStressTest) {
+  ReaderWriterLatch latch;
+  int first = 0;
+  int second = 0;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 8; tid++) {
+    threads.emplace_back([&, tid] {
+      for (int i = 0; i < 2000; i++) {
+        if (tid % 4 == 0) {
+          latch.WLock();
+          first++;
+          std::this_thread::yield();
+          second++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          // a reader never sees a write half done
+          EXPECT_EQ(first, second);
+          latch.RUnlock();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(first, 4000);
+  EXPECT_EQ(second, 4000);
+}
+
+// NOLINTNEXTLINE
+TEST(RWLatchTest, DISABLED_HotLatchReadBenchmark) {
+  const int reads_per_thread = 1000000;
+  for (int num_threads : {1, 2, 4, 8}) {
+    auto measure = [&](auto read) {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&] {
+          for (int j = 0; j < reads_per_thread; j++) {
+            read();
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      return num_threads * reads_per_thread / elapsed.count() / 1e6;
+    };
+    std::shared_mutex shared_mutex;
+    ReaderWriterLatch latch;
+    double mutex_rate = measure([&] {
+      shared_mutex.lock_shared();
+      shared_mutex.unlock_shared();
+    });
+    double latch_rate = measure([&] {
+      latch.RLock();
+      latch.RUnlock();
+    });
+    std::cout << num_threads << " threads: shared_mutex " << mutex_rate << "M, latch " << latch_rate
+              << "M reads per second" << std::endl;
+  }
+}
 }  // namespace bustub
@@ -2,6 +2,9 @@
  * lock_manager_test.cpp
  */
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
 #include <random>
 #include <thread>  // NOLINT
 
@@ -149,6 +152,25 @@ void UpgradeTest() {
 
   txn_mgr.Commit(&txn);
   CheckCommitted(&txn);
+
+  // a second upgrade of the row while one is waiting is a conflict, even for an older transaction
+  Transaction *txn_old = txn_mgr.Begin();
+  Transaction *txn_young = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(txn_old, rid));
+  EXPECT_TRUE(lock_mgr.LockShared(txn_young, rid));
+  std::thread upgrade_thread([&] {
+    EXPECT_TRUE(lock_mgr.LockUpgrade(txn_young, rid));
+    CheckTxnLockSize(txn_young, 0, 1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_THROW(lock_mgr.LockUpgrade(txn_old, rid), TransactionAbortException);
+  CheckAborted(txn_old);
+  txn_mgr.Abort(txn_old);
+  upgrade_thread.join();
+  CheckGrowing(txn_young);
+  txn_mgr.Commit(txn_young);
+  delete txn_old;
+  delete txn_young;
 }
 TEST(LockManagerTest, UpgradeLockTest) { UpgradeTest(); }
 
@@ -204,4 +226,391 @@ void WoundWaitBasicTest() {
 }
 TEST(LockManagerTest, WoundWaitBasicTest) { WoundWaitBasicTest(); }
 
+// A transaction wounded through one rid while it waits on another is woken there, or the two would deadlock
+void WoundWhileWaitingTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid_a{0, 0};
+  RID rid_b{0, 1};
+  Transaction *txn_old = txn_mgr.Begin();
+  Transaction *txn_young = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn_old, rid_b));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn_young, rid_a));
+
+  std::thread young_thread([&] {
+    EXPECT_THROW(lock_mgr.LockExclusive(txn_young, rid_b), TransactionAbortException);
+    CheckAborted(txn_young);
+    txn_mgr.Abort(txn_young);
+  });
+  // let the younger transaction start waiting on rid_b before it is wounded through rid_a
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn_old, rid_a));
+  young_thread.join();
+
+  CheckGrowing(txn_old);
+  txn_mgr.Commit(txn_old);
+  delete txn_old;
+  delete txn_young;
+}
+TEST(LockManagerTest, WoundWhileWaitingTest) { WoundWhileWaitingTest(); }
+
+// A release grants all leading shared requests together, the exclusive request behind them keeps waiting
+void GrantOrderTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < 5; i++) {
+    txns.push_back(txn_mgr.Begin());
+  }
+  EXPECT_TRUE(lock_mgr.LockExclusive(txns[0], rid));
+
+  std::atomic<int> shared_granted{0};
+  std::atomic<bool> exclusive_granted{false};
+  std::vector<std::thread> threads;
+  for (int i = 1; i <= 3; i++) {
+    threads.emplace_back([&, i] {
+      EXPECT_TRUE(lock_mgr.LockShared(txns[i], rid));
+      shared_granted++;
+      // hold the lock until the exclusive waiter is known to still be blocked
+      while (shared_granted < 3) {
+        std::this_thread::yield();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      EXPECT_FALSE(exclusive_granted);
+      EXPECT_TRUE(lock_mgr.Unlock(txns[i], rid));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  threads.emplace_back([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txns[4], rid));
+    exclusive_granted = true;
+    EXPECT_EQ(3, shared_granted);
+    EXPECT_TRUE(lock_mgr.Unlock(txns[4], rid));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, shared_granted);
+
+  EXPECT_TRUE(lock_mgr.Unlock(txns[0], rid));
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(exclusive_granted);
+  for (auto *txn : txns) {
+    CheckShrinking(txn);
+    txn_mgr.Commit(txn);
+    delete txn;
+  }
+}
+TEST(LockManagerTest, GrantOrderTest) { GrantOrderTest(); }
+
+void TableLockTest() {
+  using LockMode = LockManager::LockMode;
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+  RID rid{0, 0};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  auto *txn2 = txn_mgr.Begin();
+
+  // a shared table lock covers reading the rows, no row locks are taken
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockMode::SHARED, oid));
+  EXPECT_TRUE(lock_mgr.Lock(txn0, oid, rid));
+  CheckTxnLockSize(txn0, 0, 0);
+
+  // a row reader only announces itself with an intention shared lock, which the table reader lets through
+  EXPECT_TRUE(lock_mgr.Lock(txn2, oid, RID{0, 1}));
+  EXPECT_EQ(1, txn2->GetIntentionSharedTableLockSet()->count(oid));
+  CheckTxnLockSize(txn2, 1, 0);
+
+  // a row writer needs an intention exclusive lock, which waits for the table reader
+  std::atomic<bool> granted{false};
+  std::thread writer([&] {
+    EXPECT_TRUE(lock_mgr.Lock(txn1, oid, rid, false));
+    granted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(txn0);
+  writer.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(1, txn1->GetIntentionExclusiveTableLockSet()->count(oid));
+  CheckTxnLockSize(txn1, 0, 1);
+
+  // writing under a shared table lock combines both into a shared intention exclusive lock
+  auto *txn3 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn3, LockMode::SHARED, oid + 1));
+  EXPECT_TRUE(lock_mgr.Lock(txn3, oid + 1, RID{1, 0}, false));
+  EXPECT_EQ(0, txn3->GetSharedTableLockSet()->count(oid + 1));
+  EXPECT_EQ(1, txn3->GetSharedIntentionExclusiveTableLockSet()->count(oid + 1));
+  CheckTxnLockSize(txn3, 0, 1);
+
+  for (auto *txn : {txn1, txn2, txn3}) {
+    txn_mgr.Commit(txn);
+    EXPECT_EQ(0, txn->GetIntentionSharedTableLockSet()->size());
+    EXPECT_EQ(0, txn->GetIntentionExclusiveTableLockSet()->size());
+    EXPECT_EQ(0, txn->GetSharedIntentionExclusiveTableLockSet()->size());
+  }
+  for (auto *txn : {txn0, txn1, txn2, txn3}) {
+    CheckCommitted(txn);
+    delete txn;
+  }
+}
+TEST(LockManagerTest, TableLockTest) { TableLockTest(); }
+
+void EscalationTest() {
+  const size_t threshold = 4;
+  using LockMode = LockManager::LockMode;
+  LockManager lock_mgr{DeadlockMode::PREVENTION, threshold};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  auto *txn2 = txn_mgr.Begin();
+
+  // a reader trades its row locks for a shared table lock once it reaches the threshold
+  for (uint32_t i = 0; i < threshold - 1; i++) {
+    EXPECT_TRUE(lock_mgr.Lock(txn0, oid, RID{0, i}));
+  }
+  CheckTxnLockSize(txn0, threshold - 1, 0);
+  EXPECT_TRUE(lock_mgr.Lock(txn0, oid, RID{0, threshold - 1}));
+  CheckTxnLockSize(txn0, 0, 0);
+  EXPECT_EQ(1, txn0->GetSharedTableLockSet()->count(oid));
+  CheckGrowing(txn0);
+
+  // next to another writer the shared table lock would have to wait, so the reader keeps its row locks
+  EXPECT_TRUE(lock_mgr.Lock(txn1, oid + 1, RID{1, 0}, false));
+  for (uint32_t i = 0; i < threshold; i++) {
+    EXPECT_TRUE(lock_mgr.Lock(txn2, oid + 1, RID{2, i}));
+  }
+  CheckTxnLockSize(txn2, threshold, 0);
+  EXPECT_EQ(1, txn2->GetIntentionSharedTableLockSet()->count(oid + 1));
+  CheckGrowing(txn2);
+
+  // a writer escalates to an exclusive table lock
+  for (uint32_t i = 0; i < threshold; i++) {
+    EXPECT_TRUE(lock_mgr.Lock(txn0, oid + 2, RID{3, i}, false));
+  }
+  CheckTxnLockSize(txn0, 0, 0);
+  EXPECT_EQ(1, txn0->GetExclusiveTableLockSet()->count(oid + 2));
+
+  // rows locked before Lock() sees them, as new rows are when they are inserted, count towards the threshold too
+  EXPECT_TRUE(lock_mgr.LockTable(txn2, LockMode::INTENTION_EXCLUSIVE, oid + 4));
+  for (uint32_t i = 0; i < threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn2, RID{5, i}));
+    EXPECT_TRUE(lock_mgr.Lock(txn2, oid + 4, RID{5, i}, false));
+  }
+  EXPECT_EQ(1, txn2->GetExclusiveTableLockSet()->count(oid + 4));
+  EXPECT_EQ(0, (*txn2->GetTableRowLockSet())[oid + 4].size());
+
+  // behind another transaction's pending table upgrade the escalation gives up too, instead of aborting the reader
+  auto *txn3 = txn_mgr.Begin();
+  for (uint32_t i = 0; i < threshold - 1; i++) {
+    EXPECT_TRUE(lock_mgr.Lock(txn0, oid + 3, RID{4, i}));
+  }
+  EXPECT_TRUE(lock_mgr.LockTable(txn3, LockMode::INTENTION_SHARED, oid + 3));
+  // the younger transaction waits for the reader's intention lock without wounding it
+  std::thread upgrade_thread([&] { EXPECT_TRUE(lock_mgr.LockTable(txn3, LockMode::EXCLUSIVE, oid + 3)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(lock_mgr.Lock(txn0, oid + 3, RID{4, threshold - 1}));
+  CheckTxnLockSize(txn0, threshold, 0);
+  EXPECT_EQ(1, txn0->GetIntentionSharedTableLockSet()->count(oid + 3));
+  CheckGrowing(txn0);
+
+  txn_mgr.Commit(txn0);
+  CheckCommitted(txn0);
+  delete txn0;
+  upgrade_thread.join();
+  EXPECT_EQ(1, txn3->GetExclusiveTableLockSet()->count(oid + 3));
+  for (auto *txn : {txn1, txn2, txn3}) {
+    txn_mgr.Commit(txn);
+    CheckCommitted(txn);
+    delete txn;
+  }
+
+  // a threshold of 0 turns escalation off
+  LockManager no_escalation_mgr{DeadlockMode::PREVENTION, 0};
+  TransactionManager no_escalation_txn_mgr{&no_escalation_mgr};
+  auto *txn4 = no_escalation_txn_mgr.Begin();
+  for (uint32_t i = 0; i < threshold; i++) {
+    EXPECT_TRUE(no_escalation_mgr.Lock(txn4, oid, RID{6, i}));
+  }
+  CheckTxnLockSize(txn4, threshold, 0);
+  EXPECT_TRUE(txn4->GetSharedTableLockSet()->empty());
+  no_escalation_txn_mgr.Commit(txn4);
+  delete txn4;
+}
+TEST(LockManagerTest, EscalationTest) { EscalationTest(); }
+
+TEST(LockManagerTest, GraphTest) {
+  LockManager lock_mgr{};
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  lock_mgr.AddEdge(2, 0);
+  lock_mgr.AddEdge(3, 4);
+  EXPECT_EQ(4, lock_mgr.GetEdgeList().size());
+
+  txn_id_t victim = INVALID_TXN_ID;
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(2, victim);
+
+  lock_mgr.RemoveEdge(2, 0);
+  EXPECT_EQ(3, lock_mgr.GetEdgeList().size());
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+}
+
+void DeadlockDetectionTest() {
+  LockManager lock_mgr{DeadlockMode::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{0, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+
+  std::thread older([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid1));
+    txn_mgr.Commit(txn0);
+  });
+  // waiting alone is no deadlock, the younger holder is left alone
+  std::this_thread::sleep_for(cycle_detection_interval * 3);
+  CheckGrowing(txn1);
+
+  // closing the cycle aborts its youngest transaction
+  try {
+    lock_mgr.LockExclusive(txn1, rid0);
+    FAIL() << "the younger transaction should have been aborted";
+  } catch (TransactionAbortException &e) {
+    EXPECT_EQ(AbortReason::DEADLOCK, e.GetAbortReason());
+  }
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  older.join();
+
+  CheckCommitted(txn0);
+  delete txn0;
+  delete txn1;
+}
+TEST(LockManagerTest, DeadlockDetectionTest) { DeadlockDetectionTest(); }
+
+// A cycle through a victim that was granted its lock since the graph was built is out of date, the victim is kept
+void StaleCycleTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid));
+  std::thread younger([&] { EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // the graph as built while txn1 waited, with an edge back that makes txn1 the victim
+  lock_mgr.AddEdge(txn1->GetTransactionId(), txn0->GetTransactionId());
+  lock_mgr.AddEdge(txn0->GetTransactionId(), txn1->GetTransactionId());
+  EXPECT_TRUE(lock_mgr.Unlock(txn0, rid));
+  younger.join();
+  txn_mgr.Commit(txn1);
+
+  EXPECT_FALSE(lock_mgr.BreakCycles());
+  CheckCommitted(txn1);
+  CheckShrinking(txn0);
+  txn_mgr.Commit(txn0);
+  delete txn0;
+  delete txn1;
+}
+TEST(LockManagerTest, StaleCycleTest) { StaleCycleTest(); }
+
+// Lock and unlock throughput on disjoint rids, where threads only meet in the lock table itself
+TEST(LockManagerTest, DISABLED_LockUnlockThroughputBenchmark) {
+  const int ops_per_thread = 200000;
+  for (int num_threads : {1, 2, 4, 8, 16}) {
+    LockManager lock_mgr{};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::vector<Transaction *> txns;
+    for (int i = 0; i < num_threads; i++) {
+      txns.push_back(txn_mgr.Begin());
+    }
+
+    auto task = [&](int thread_id) {
+      Transaction *txn = txns[thread_id];
+      for (int i = 0; i < ops_per_thread; i++) {
+        RID rid{thread_id, static_cast<uint32_t>(i % 1024)};
+        if (i % 2 == 0) {
+          lock_mgr.LockShared(txn, rid);
+        } else {
+          lock_mgr.LockExclusive(txn, rid);
+        }
+        lock_mgr.Unlock(txn, rid);
+        // stay in the growing phase, this measures the lock table rather than two phase locking
+        txn->SetState(TransactionState::GROWING);
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << num_threads << " threads: " << num_threads * ops_per_thread / elapsed.count() << " lock/unlock per second"
+              << std::endl;
+
+    for (auto *txn : txns) {
+      txn_mgr.Commit(txn);
+      delete txn;
+    }
+  }
+}
+
+// Transactions locking two random rows out of a few, in random order, under each deadlock policy
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const int num_threads = 8;
+  const int txns_per_thread = 200;
+  const uint32_t num_rids = 16;
+  for (DeadlockMode mode : {DeadlockMode::PREVENTION, DeadlockMode::DETECTION}) {
+    LockManager lock_mgr{mode};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::atomic<int> commits{0};
+    std::atomic<int> aborts{0};
+
+    auto task = [&](int thread_id) {
+      std::mt19937 gen(thread_id);
+      std::uniform_int_distribution<uint32_t> slot(0, num_rids - 1);
+      for (int i = 0; i < txns_per_thread; i++) {
+        auto *txn = txn_mgr.Begin();
+        try {
+          uint32_t first = slot(gen);
+          uint32_t second = (first + 1 + slot(gen) % (num_rids - 1)) % num_rids;
+          for (uint32_t slot_num : {first, second}) {
+            lock_mgr.LockExclusive(txn, RID{0, slot_num});
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+          }
+          txn_mgr.Commit(txn);
+          commits++;
+        } catch (TransactionAbortException &e) {
+          txn_mgr.Abort(txn);
+          aborts++;
+        }
+        delete txn;
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (mode == DeadlockMode::PREVENTION ? "wound-wait" : "detection") << ": " << commits / elapsed.count()
+              << " commits per second, " << aborts << " of " << num_threads * txns_per_thread << " aborted"
+              << std::endl;
+  }
+}
+
 }  // namespace bustub
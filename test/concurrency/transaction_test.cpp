@@ -11,10 +11,13 @@
 //===----------------------------------------------------------------------===//
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <iostream>
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -32,6 +35,7 @@
 #include "execution/plans/limit_plan.h"
 #include "execution/plans/nested_index_join_plan.h"
 #include "execution/plans/seq_scan_plan.h"
+#include "storage/table/table_heap.h"
 #include "gtest/gtest.h"
 #include "test_util.h"  // NOLINT
 #include "type/value_factory.h"
@@ -254,4 +258,459 @@ TEST_F(TransactionTest, DirtyReadsTest) {
   delete txn2;
 }
 
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotReadsTest) {
+  // txn1: INSERT INTO empty_table2 VALUES (200, 20), (201, 21)
+  // txn1: commit
+  // txn2: BEGIN (snapshot)
+  // txn3: UPDATE (200, 20) TO (200, 99), DELETE (201, 21), INSERT (202, 22)
+  // txn3: commit
+  // txn2: SELECT * FROM empty_table2; sees the table as it was before txn3
+  // txn4: SELECT * FROM empty_table2; sees the writes of txn3
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto make_tuple = [&](int a, int b) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, &schema};
+  };
+
+  auto txn1 = GetTxnManager()->Begin();
+  RID rid0;
+  RID rid1;
+  ASSERT_TRUE(table_info->table_->InsertTuple(make_tuple(200, 20), &rid0, txn1));
+  ASSERT_TRUE(table_info->table_->InsertTuple(make_tuple(201, 21), &rid1, txn1));
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+
+  auto txn3 = GetTxnManager()->Begin();
+  RID rid2;
+  ASSERT_TRUE(table_info->table_->UpdateTuple(make_tuple(200, 99), rid0, txn3));
+  ASSERT_TRUE(table_info->table_->MarkDelete(rid1, txn3));
+  ASSERT_TRUE(table_info->table_->InsertTuple(make_tuple(202, 22), &rid2, txn3));
+  GetTxnManager()->Commit(txn3);
+  delete txn3;
+
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<Tuple> result_set;
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, txn2, exec_ctx2.get());
+  ASSERT_EQ(result_set.size(), 2);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 0).GetAs<int32_t>(), 200);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), 20);
+  ASSERT_EQ(result_set[1].GetValue(out_schema, 0).GetAs<int32_t>(), 201);
+  ASSERT_EQ(result_set[1].GetValue(out_schema, 1).GetAs<int32_t>(), 21);
+  // no read locks are taken
+  CheckTxnLockSize(txn2, 0, 0);
+  EXPECT_TRUE(txn2->GetSharedTableLockSet()->empty());
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+
+  auto txn4 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx4 = std::make_unique<ExecutorContext>(txn4, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  result_set.clear();
+  GetExecutionEngine()->Execute(&scan_plan, &result_set, txn4, exec_ctx4.get());
+  ASSERT_EQ(result_set.size(), 2);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 0).GetAs<int32_t>(), 200);
+  ASSERT_EQ(result_set[0].GetValue(out_schema, 1).GetAs<int32_t>(), 99);
+  ASSERT_EQ(result_set[1].GetValue(out_schema, 0).GetAs<int32_t>(), 202);
+  ASSERT_EQ(result_set[1].GetValue(out_schema, 1).GetAs<int32_t>(), 22);
+  GetTxnManager()->Commit(txn4);
+  delete txn4;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, ScanLocksTest) {
+  // txn1: INSERT INTO empty_table2 VALUES (200, 20), (201, 21)
+  // txn1: commit
+  // txn2: SELECT * FROM empty_table2; locks the rows it read under an intention lock on the table
+  // txn3: SELECT * FROM empty_table2 at READ_COMMITTED; lets go of each row once it is read
+  auto table_info = GetCatalog()->GetTable("empty_table2");
+  auto &schema = table_info->schema_;
+  auto txn1 = GetTxnManager()->Begin();
+  RID rid;
+  ASSERT_TRUE(table_info->table_->InsertTuple(
+      Tuple{{ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)}, &schema}, &rid, txn1));
+  ASSERT_TRUE(table_info->table_->InsertTuple(
+      Tuple{{ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)}, &schema}, &rid, txn1));
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::READ_COMMITTED}) {
+    auto txn = GetTxnManager()->Begin(nullptr, isolation_level);
+    auto exec_ctx = std::make_unique<ExecutorContext>(txn, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx.get());
+    ASSERT_EQ(result_set.size(), 2);
+    CheckTxnLockSize(txn, isolation_level == IsolationLevel::REPEATABLE_READ ? 2 : 0, 0);
+    EXPECT_EQ(1, txn->GetIntentionSharedTableLockSet()->count(table_info->oid_));
+    EXPECT_TRUE(txn->GetSharedTableLockSet()->empty());
+    EXPECT_EQ(TransactionState::GROWING, txn->GetState());
+    GetTxnManager()->Commit(txn);
+    delete txn;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, WriteConflictAndCollectTest) {
+  auto disk_manager = std::make_unique<DiskManager>("snapshot_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(50, disk_manager.get());
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  Schema schema({Column("a", TypeId::INTEGER)});
+  auto make_tuple = [&](int a) { return Tuple{{ValueFactory::GetIntegerValue(a)}, &schema}; };
+
+  auto txn0 = txn_mgr.Begin();
+  TableHeap table(bpm.get(), &lock_manager, nullptr, txn0);
+  RID rid;
+  ASSERT_TRUE(table.InsertTuple(make_tuple(1), &rid, txn0));
+  txn_mgr.Commit(txn0);
+  delete txn0;
+  // nobody can see the version before the insert anymore
+  EXPECT_EQ(table.VersionCount(), 0);
+
+  auto txn1 = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto txn2 = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ASSERT_TRUE(table.UpdateTuple(make_tuple(2), rid, txn2));
+  // the write of txn2 is not committed, txn1 has to back off
+  EXPECT_FALSE(table.UpdateTuple(make_tuple(3), rid, txn1));
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  delete txn1;
+
+  auto txn3 = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  txn_mgr.Commit(txn2);
+  delete txn2;
+  // txn3 still reads the version from before txn2, which is kept for it
+  Tuple tuple;
+  ASSERT_TRUE(table.GetTuple(rid, &tuple, txn3));
+  EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), 1);
+  EXPECT_EQ(table.VersionCount(), 1);
+  // first updater wins: txn2 committed after the snapshot of txn3 was taken
+  EXPECT_FALSE(table.MarkDelete(rid, txn3));
+  CheckAborted(txn3);
+  txn_mgr.Abort(txn3);
+  delete txn3;
+  EXPECT_EQ(table.VersionCount(), 0);
+
+  auto txn4 = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  ASSERT_TRUE(table.GetTuple(rid, &tuple, txn4));
+  EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), 2);
+  txn_mgr.Commit(txn4);
+  delete txn4;
+
+  disk_manager->ShutDown();
+  remove("snapshot_test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticTest, ValidationTest) {
+  auto disk_manager = std::make_unique<DiskManager>("optimistic_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(50, disk_manager.get());
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  Schema schema({Column("a", TypeId::INTEGER)});
+  auto make_tuple = [&](int a) { return Tuple{{ValueFactory::GetIntegerValue(a)}, &schema}; };
+  auto read = [&](TableHeap *table, const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    EXPECT_TRUE(table->GetTuple(rid, &tuple, txn));
+    return tuple.GetValue(&schema, 0).GetAs<int32_t>();
+  };
+
+  auto txn0 = txn_mgr.Begin();
+  TableHeap table(bpm.get(), &lock_manager, nullptr, txn0);
+  RID rid0;
+  RID rid1;
+  ASSERT_TRUE(table.InsertTuple(make_tuple(0), &rid0, txn0));
+  ASSERT_TRUE(table.InsertTuple(make_tuple(10), &rid1, txn0));
+  ASSERT_TRUE(txn_mgr.Commit(txn0));
+  delete txn0;
+
+  // txn1 reads rid0 and updates rid1, txn2 updates rid0 and commits first: txn1 read a stale version
+  auto txn1 = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  auto txn2 = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_EQ(read(&table, rid0, txn1), 0);
+  ASSERT_TRUE(table.UpdateTuple(make_tuple(11), rid1, txn1));
+  // the update is buffered, txn1 reads its own write and nobody else sees it
+  EXPECT_EQ(read(&table, rid1, txn1), 11);
+  EXPECT_EQ(read(&table, rid1, txn2), 10);
+  EXPECT_TRUE(txn1->GetExclusiveLockSet()->empty());
+  ASSERT_TRUE(table.UpdateTuple(make_tuple(1), rid0, txn2));
+  EXPECT_TRUE(txn_mgr.Commit(txn2));
+  CheckCommitted(txn2);
+  delete txn2;
+  EXPECT_FALSE(txn_mgr.Commit(txn1));
+  CheckAborted(txn1);
+  delete txn1;
+
+  // the write of txn2 is in, the one of txn1 is not
+  auto txn3 = txn_mgr.Begin();
+  EXPECT_EQ(read(&table, rid0, txn3), 1);
+  EXPECT_EQ(read(&table, rid1, txn3), 10);
+  ASSERT_TRUE(txn_mgr.Commit(txn3));
+  delete txn3;
+
+  // txn4 reads rid0 and deletes rid1, txn5 reads rid1 and updates rid0: whoever commits second has read a version the
+  // first one wrote
+  auto txn4 = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  auto txn5 = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_EQ(read(&table, rid0, txn4), 1);
+  EXPECT_EQ(read(&table, rid1, txn5), 10);
+  ASSERT_TRUE(table.MarkDelete(rid1, txn4));
+  Tuple tuple;
+  EXPECT_FALSE(table.GetTuple(rid1, &tuple, txn4));
+  ASSERT_TRUE(table.UpdateTuple(make_tuple(2), rid0, txn5));
+  EXPECT_TRUE(txn_mgr.Commit(txn4));
+  EXPECT_FALSE(txn_mgr.Commit(txn5));
+  delete txn4;
+  delete txn5;
+
+  auto txn6 = txn_mgr.Begin();
+  EXPECT_EQ(read(&table, rid0, txn6), 1);
+  EXPECT_FALSE(table.GetTuple(rid1, &tuple, txn6));
+  ASSERT_TRUE(txn_mgr.Commit(txn6));
+  delete txn6;
+
+  disk_manager->ShutDown();
+  remove("optimistic_test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticTest, DISABLED_OptimisticVersusLockingBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 2000;
+  const int num_rows = 1000;
+  const int reads_per_txn = 8;
+  const int write_percent = 10;
+  Schema schema({Column("a", TypeId::INTEGER)});
+  for (auto concurrency_control : {ConcurrencyControl::TWO_PHASE_LOCKING, ConcurrencyControl::OPTIMISTIC}) {
+    auto disk_manager = std::make_unique<DiskManager>("optimistic_test.db");
+    auto bpm = std::make_unique<BufferPoolManagerInstance>(50, disk_manager.get());
+    LockManager lock_mgr;
+    TransactionManager txn_mgr{&lock_mgr};
+    auto *txn0 = txn_mgr.Begin();
+    TableHeap table(bpm.get(), &lock_mgr, nullptr, txn0);
+    std::vector<RID> rids(num_rows);
+    for (int i = 0; i < num_rows; i++) {
+      table.InsertTuple(Tuple{{ValueFactory::GetIntegerValue(i)}, &schema}, &rids[i], txn0);
+    }
+    txn_mgr.Commit(txn0);
+    delete txn0;
+    std::atomic<int> commits{0};
+    std::atomic<int> aborts{0};
+    bool locking = concurrency_control == ConcurrencyControl::TWO_PHASE_LOCKING;
+
+    auto task = [&](int thread_id) {
+      std::mt19937 gen(thread_id);
+      std::uniform_int_distribution<int> row(0, num_rows - 1);
+      std::uniform_int_distribution<int> percent(0, 99);
+      for (int i = 0; i < txns_per_thread; i++) {
+        auto *txn = txn_mgr.Begin(nullptr, IsolationLevel::REPEATABLE_READ, concurrency_control);
+        try {
+          Tuple tuple;
+          RID rid;
+          for (int j = 0; j < reads_per_txn; j++) {
+            rid = rids[row(gen)];
+            lock_mgr.Lock(txn, 0, rid, true);
+            table.GetTuple(rid, &tuple, txn);
+          }
+          if (percent(gen) < write_percent) {
+            // like the executors, an optimistic write is buffered first and then not locked
+            if (locking) {
+              lock_mgr.Lock(txn, 0, rid, false);
+            }
+            int value = tuple.GetValue(&schema, 0).GetAs<int32_t>();
+            table.UpdateTuple(Tuple{{ValueFactory::GetIntegerValue(value + 1)}, &schema}, rid, txn);
+            lock_mgr.Lock(txn, 0, rid, false);
+          }
+          if (txn->GetState() == TransactionState::ABORTED) {
+            txn_mgr.Abort(txn);
+            aborts++;
+          } else if (txn_mgr.Commit(txn)) {
+            commits++;
+          } else {
+            aborts++;
+          }
+        } catch (TransactionAbortException &e) {
+          txn_mgr.Abort(txn);
+          aborts++;
+        }
+        delete txn;
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (locking ? "2pl" : "occ") << ": " << commits / elapsed.count() << " commits per second, " << aborts
+              << " of " << num_threads * txns_per_thread << " aborted" << std::endl;
+    disk_manager->ShutDown();
+    remove("optimistic_test.db");
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionRegistryTest, RegistryTest) {
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  size_t running = TransactionManager::txn_registry.Size();
+
+  auto txn0 = txn_mgr.Begin();
+  auto txn1 = txn_mgr.Begin();
+  EXPECT_EQ(TransactionManager::GetTransaction(txn0->GetTransactionId()), txn0);
+  EXPECT_EQ(TransactionManager::GetTransaction(txn1->GetTransactionId()), txn1);
+  txn_id_t txn0_id = txn0->GetTransactionId();
+  txn_mgr.Commit(txn0);
+  delete txn0;
+  EXPECT_EQ(TransactionManager::GetTransaction(txn0_id), nullptr);
+  txn_mgr.Abort(txn1);
+  delete txn1;
+
+  // finished transactions are forgotten while others look them up, and none is freed under a reader
+  const int num_threads = 2;
+  const int txns_per_thread = 2000;
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    txn_id_t txn_id = 0;
+    while (!done) {
+      TransactionRegistry::Guard guard(&TransactionManager::txn_registry);
+      Transaction *txn = TransactionManager::GetTransaction(txn_id);
+      if (txn != nullptr) {
+        EXPECT_EQ(txn->GetTransactionId(), txn_id);
+      }
+      txn_id = (txn_id + 1) % (num_threads * txns_per_thread);
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < txns_per_thread; j++) {
+        auto txn = txn_mgr.Begin();
+        txn_mgr.Commit(txn);
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(TransactionManager::txn_registry.Size(), running);
+}
+
+// NOLINTNEXTLINE
+TEST(ReadOnlyTest, ReadOnlyTransactionTest) {
+  auto disk_manager = std::make_unique<DiskManager>("read_only_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(50, disk_manager.get());
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  Schema schema({Column("a", TypeId::INTEGER)});
+  auto make_tuple = [&](int a) { return Tuple{{ValueFactory::GetIntegerValue(a)}, &schema}; };
+
+  auto txn0 = txn_mgr.Begin();
+  TableHeap table(bpm.get(), &lock_manager, nullptr, txn0);
+  RID rid;
+  ASSERT_TRUE(table.InsertTuple(make_tuple(1), &rid, txn0));
+  txn_mgr.Commit(txn0);
+  delete txn0;
+
+  auto txn1 = txn_mgr.BeginReadOnly();
+  EXPECT_TRUE(txn1->IsReadOnly());
+  EXPECT_EQ(txn1->GetWriteSet(), nullptr);
+  EXPECT_EQ(txn1->GetSharedLockSet(), nullptr);
+  EXPECT_EQ(TransactionManager::GetTransaction(txn1->GetTransactionId()), nullptr);
+
+  auto txn2 = txn_mgr.Begin();
+  ASSERT_TRUE(table.UpdateTuple(make_tuple(2), rid, txn2));
+  txn_mgr.Commit(txn2);
+  delete txn2;
+
+  // the read-only transaction reads its snapshot without locking
+  Tuple tuple;
+  ASSERT_TRUE(table.GetTuple(rid, &tuple, txn1));
+  EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), 1);
+  EXPECT_TRUE(lock_manager.Lock(txn1, 0, rid, true));
+  EXPECT_TRUE(txn_mgr.Commit(txn1));
+  CheckCommitted(txn1);
+  delete txn1;
+
+  // and may not write
+  auto txn3 = txn_mgr.BeginReadOnly();
+  EXPECT_FALSE(table.UpdateTuple(make_tuple(3), rid, txn3));
+  CheckAborted(txn3);
+  txn_mgr.Abort(txn3);
+  delete txn3;
+  auto txn4 = txn_mgr.BeginReadOnly();
+  EXPECT_THROW(lock_manager.LockShared(txn4, rid), TransactionAbortException);
+  CheckAborted(txn4);
+  txn_mgr.Abort(txn4);
+  delete txn4;
+  EXPECT_EQ(table.VersionCount(), 0);
+
+  disk_manager->ShutDown();
+  remove("read_only_test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(ReadOnlyTest, DISABLED_ReadOnlyPointLookupBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 20000;
+  const int num_rows = 1000;
+  auto disk_manager = std::make_unique<DiskManager>("read_only_test.db");
+  auto bpm = std::make_unique<BufferPoolManagerInstance>(50, disk_manager.get());
+  LockManager lock_mgr;
+  TransactionManager txn_mgr{&lock_mgr};
+  Schema schema({Column("a", TypeId::INTEGER)});
+  auto *txn0 = txn_mgr.Begin();
+  TableHeap table(bpm.get(), &lock_mgr, nullptr, txn0);
+  std::vector<RID> rids(num_rows);
+  for (int i = 0; i < num_rows; i++) {
+    table.InsertTuple(Tuple{{ValueFactory::GetIntegerValue(i)}, &schema}, &rids[i], txn0);
+  }
+  txn_mgr.Commit(txn0);
+  delete txn0;
+
+  for (bool read_only : {false, true}) {
+    auto task = [&](int thread_id) {
+      std::mt19937 gen(thread_id);
+      std::uniform_int_distribution<int> row(0, num_rows - 1);
+      for (int i = 0; i < txns_per_thread; i++) {
+        auto *txn = read_only ? txn_mgr.BeginReadOnly() : txn_mgr.Begin();
+        Tuple tuple;
+        RID rid = rids[row(gen)];
+        lock_mgr.Lock(txn, 0, rid, true);
+        table.GetTuple(rid, &tuple, txn);
+        txn_mgr.Commit(txn);
+        delete txn;
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(task, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (read_only ? "read-only" : "repeatable read") << ": "
+              << num_threads * txns_per_thread / elapsed.count() << " lookups per second" << std::endl;
+  }
+  disk_manager->ShutDown();
+  remove("read_only_test.db");
+}
+
 }  // namespace bustub
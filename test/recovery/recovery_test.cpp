@@ -10,7 +10,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -20,9 +26,12 @@
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "recovery/log_recovery.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "storage/page/header_page.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -32,6 +41,10 @@ class RecoveryTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.master");
+    for (int i = 0; i < 16; i++) {
+      remove(("test.log." + std::to_string(i)).c_str());
+    }
   }
 
   // This function is called after every test.
@@ -39,11 +52,15 @@ class RecoveryTest : public ::testing::Test {
     LOG_INFO("Tearing down the system..");
     remove("test.db");
     remove("test.log");
+    remove("test.master");
+    for (int i = 0; i < 16; i++) {
+      remove(("test.log." + std::to_string(i)).c_str());
+    }
   };
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -132,7 +149,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -211,7 +228,69 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, LogPastInt32Test) {
+  // a log recycled for long enough that all of its live records lie past INT32_MAX
+  const int first_segment = INT32_MAX / LOG_SEGMENT_SIZE + 1;
+  {
+    std::ofstream log_control("test.log", std::ios::binary | std::ios::trunc | std::ios::out);
+    uint32_t log_id = 15445;
+    log_control.write(reinterpret_cast<const char *>(&first_segment), sizeof(int));
+    log_control.write(reinterpret_cast<const char *>(&log_id), sizeof(uint32_t));
+  }
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+  RID winner_rid;
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &winner_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &loser_rid, txn));
+  bustub_instance->log_manager_->Flush(true);
+  EXPECT_GT(bustub_instance->disk_manager_->GetLogEnd(), INT32_MAX);
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash before the second txn commits");
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+  // the log manager finds the end of the log again, past INT32_MAX
+  EXPECT_GT(bustub_instance->log_manager_->GetNextLSN(), 0);
+
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple old_tuple;
+  EXPECT_TRUE(test_table->GetTuple(winner_rid, &old_tuple, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, &old_tuple, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+
+  for (int i = first_segment; i < first_segment + 4; i++) {
+    remove(("test.log." + std::to_string(i)).c_str());
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -314,4 +393,335 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   LOG_INFO("Shutdown System");
   delete bustub_instance;
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointRestartTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid_before;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid_before, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // the first checkpoint writes back the dirty pages, so the second one starts redo at itself
+  for (int i = 0; i < 2; i++) {
+    bustub_instance->checkpoint_manager_->BeginCheckpoint();
+    bustub_instance->checkpoint_manager_->EndCheckpoint();
+  }
+
+  // one loser that is still running at the crash, one winner that committed after the checkpoint
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &loser_rid, loser));
+  Transaction *winner = bustub_instance->transaction_manager_->Begin();
+  RID winner_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &winner_rid, winner));
+  bustub_instance->transaction_manager_->Commit(winner);
+
+  delete loser;
+  delete winner;
+  delete test_table;
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  // Everything before the checkpoint is already reflected on disk, so recovery must not need it. Wipe the head of
+  // the log to make sure analysis and redo start at the checkpoint.
+  {
+    std::fstream log_file("test.log.0", std::ios::binary | std::ios::in | std::ios::out);
+    char zeros[32] = {0};
+    log_file.seekp(DiskManager::LOG_SEGMENT_HEADER_SIZE);
+    log_file.write(zeros, sizeof(zeros));
+  }
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  EXPECT_TRUE(test_table->GetTuple(rid_before, &result, txn));
+  EXPECT_TRUE(test_table->GetTuple(winner_rid, &result, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, &result, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, TornTupleRecordTest) {
+  std::vector<Column> cols{Column{"colA", TypeId::INTEGER}};
+  Schema schema{cols};
+  Tuple tuple({ValueFactory::GetIntegerValue(15445)}, &schema);
+  LogRecord record(0, 0, LogRecordType::INSERT, RID(1, 0), tuple);
+  int size = record.GetSize();
+  // the record as LogManager serializes it, with lsn, txn id and prev lsn left at 0
+  const int header_size = 20;
+  std::vector<char> data(size);
+  memcpy(data.data(), &size, sizeof(int32_t));
+  LogRecordType type = LogRecordType::INSERT;
+  memcpy(data.data() + 16, &type, sizeof(LogRecordType));
+  RID rid(1, 0);
+  memcpy(data.data() + header_size, &rid, sizeof(RID));
+  tuple.SerializeTo(data.data() + header_size + sizeof(RID));
+
+  LogRecovery log_recovery(nullptr, nullptr);
+  LogRecord result;
+  ASSERT_TRUE(log_recovery.DeserializeLogRecord(data.data(), size, &result));
+  EXPECT_EQ(tuple.GetLength(), result.GetInsertTuple().GetLength());
+
+  // a tuple length running past the end of the record is not read
+  int32_t torn_length = 1 << 20;
+  memcpy(data.data() + header_size + sizeof(RID), &torn_length, sizeof(int32_t));
+  EXPECT_FALSE(log_recovery.DeserializeLogRecord(data.data(), size, &result));
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DeltaUpdateTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  // same layout as the test_1 table
+  std::vector<Column> cols{Column{"colA", TypeId::INTEGER}, Column{"colB", TypeId::INTEGER},
+                           Column{"colC", TypeId::INTEGER}, Column{"colD", TypeId::INTEGER}};
+  Schema schema{cols};
+  auto make_tuple = [&schema](int a, int b, int c, int d) {
+    return Tuple({ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b), ValueFactory::GetIntegerValue(c),
+                  ValueFactory::GetIntegerValue(d)},
+                 &schema);
+  };
+  auto log_end = [bustub_instance] {
+    auto *log_manager = bustub_instance->log_manager_;
+    return log_manager->GetLogOffset(log_manager->GetNextLSN());
+  };
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID winner_rid;
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(make_tuple(1, 2, 3, 4), &winner_rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(make_tuple(5, 6, 7, 8), &loser_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // an aborted update puts the old bytes back
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(make_tuple(1, 2, 30, 4), winner_rid, txn));
+  bustub_instance->transaction_manager_->Abort(txn);
+  delete txn;
+  txn = bustub_instance->transaction_manager_->Begin();
+  Tuple result;
+  ASSERT_TRUE(test_table->GetTuple(winner_rid, &result, txn));
+  EXPECT_EQ(3, result.GetValue(&schema, 2).GetAs<int32_t>());
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(make_tuple(5, 6, 70, 8), loser_rid, loser));
+  LOG_INFO("Loser update is written to disk");
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+
+  // changing one integer column logs that column instead of two copies of the row
+  Transaction *winner = bustub_instance->transaction_manager_->Begin();
+  int before = log_end();
+  ASSERT_TRUE(test_table->UpdateTuple(make_tuple(1, 20, 3, 4), winner_rid, winner));
+  int delta_bytes = log_end() - before;
+  int full_bytes = 20 + sizeof(RID) + 2 * (sizeof(int32_t) + 4 * sizeof(int32_t));
+  LOG_INFO("Log bytes per update: %d, %d with full tuple images", delta_bytes, full_bytes);
+  EXPECT_LT(delta_bytes, full_bytes);
+  bustub_instance->transaction_manager_->Commit(winner);
+
+  delete loser;
+  delete winner;
+  delete test_table;
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  ASSERT_TRUE(test_table->GetTuple(winner_rid, &result, txn));
+  EXPECT_EQ(20, result.GetValue(&schema, 1).GetAs<int32_t>());
+  EXPECT_EQ(3, result.GetValue(&schema, 2).GetAs<int32_t>());
+  ASSERT_TRUE(test_table->GetTuple(loser_rid, &result, txn));
+  EXPECT_EQ(7, result.GetValue(&schema, 2).GetAs<int32_t>());
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, IndexRecoveryTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *bpm = bustub_instance->buffer_pool_manager_;
+
+  // the index finds its root through its record in the header page
+  page_id_t header_page_id;
+  auto *header_page = static_cast<HeaderPage *>(bpm->NewPage(&header_page_id));
+  ASSERT_EQ(HEADER_PAGE_ID, header_page_id);
+  header_page->Init();
+  ASSERT_TRUE(header_page->InsertRecord("test_index", HEADER_PAGE_ID));
+  ASSERT_TRUE(header_page->UpdateRecord("test_index", INVALID_PAGE_ID));
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  bpm->FlushPage(HEADER_PAGE_ID);
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::BIGINT}}};
+  auto make_index = [&schema](BustubInstance *instance) {
+    auto metadata = std::make_unique<IndexMetadata>("test_index", "test_table", &schema, std::vector<uint32_t>{0});
+    return std::make_unique<BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>>(
+        std::move(metadata), instance->buffer_pool_manager_, instance->log_manager_);
+  };
+  auto make_key = [&schema](int64_t key) { return Tuple({ValueFactory::GetBigIntValue(key)}, &schema); };
+  auto make_rid = [](int64_t key) { return RID(static_cast<page_id_t>(key >> 16), static_cast<uint32_t>(key)); };
+
+  auto index = make_index(bustub_instance);
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int64_t key = 0; key < 600; key++) {
+    index->InsertEntry(make_key(key), make_rid(key), txn);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  for (int64_t key = 600; key < 650; key++) {
+    index->InsertEntry(make_key(key), make_rid(key), loser);
+  }
+  for (int64_t key = 0; key < 50; key++) {
+    index->DeleteEntry(make_key(key), make_rid(key), loser);
+  }
+  // committing the winner forces the loser's records to disk with it
+  Transaction *winner = bustub_instance->transaction_manager_->Begin();
+  index->InsertEntry(make_key(5000), make_rid(5000), winner);
+  bustub_instance->transaction_manager_->Commit(winner);
+
+  delete loser;
+  delete winner;
+  index.reset();
+  LOG_INFO("System crash");
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  index = make_index(bustub_instance);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->RegisterIndex(index.get());
+  log_recovery->Redo();
+  log_recovery->Undo();
+
+  std::vector<RID> result;
+  for (int64_t key = 0; key < 600; key++) {
+    result.clear();
+    index->ScanKey(make_key(key), &result, nullptr);
+    ASSERT_EQ(1, result.size()) << key;
+    EXPECT_EQ(make_rid(key), result[0]);
+  }
+  for (int64_t key = 600; key < 650; key++) {
+    result.clear();
+    index->ScanKey(make_key(key), &result, nullptr);
+    EXPECT_TRUE(result.empty()) << key;
+  }
+  result.clear();
+  index->ScanKey(make_key(5000), &result, nullptr);
+  EXPECT_EQ(1, result.size());
+
+  // pages allocated after the restart do not overwrite the recovered tree
+  for (int64_t key = 1000; key < 1300; key++) {
+    index->InsertEntry(make_key(key), make_rid(key), nullptr);
+  }
+  int64_t count = 0;
+  for (auto it = index->GetBeginIterator(); it != index->GetEndIterator(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(600 + 1 + 300, count);
+
+  delete log_recovery;
+  index.reset();
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_CheckpointThroughputBenchmark) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_mgr = bustub_instance->transaction_manager_;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = txn_mgr->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  std::vector<RID> rids(1000);
+  for (auto &rid : rids) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  }
+  txn_mgr->Commit(txn);
+  delete txn;
+
+  // keep updating tuples spread over more pages than the buffer pool holds
+  std::atomic<bool> done{false};
+  std::atomic<int> committed{0};
+  std::thread worker([&] {
+    for (size_t i = 0; !done; i++) {
+      Transaction *update_txn = txn_mgr->Begin();
+      test_table->UpdateTuple(tuple, rids[(i * 37) % rids.size()], update_txn);
+      txn_mgr->Commit(update_txn);
+      delete update_txn;
+      committed++;
+    }
+  });
+
+  auto throughput = [&committed](const std::function<void()> &during) {
+    int start_count = committed;
+    auto start = std::chrono::steady_clock::now();
+    during();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return (committed - start_count) / elapsed.count();
+  };
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  double idle = throughput([] { std::this_thread::sleep_for(std::chrono::milliseconds(500)); });
+  double checkpointing = throughput([bustub_instance] {
+    for (int i = 0; i < 20; i++) {
+      bustub_instance->checkpoint_manager_->BeginCheckpoint();
+      bustub_instance->checkpoint_manager_->EndCheckpoint();
+    }
+  });
+  done = true;
+  worker.join();
+
+  std::cout << "txn/s without checkpoint: " << idle << ", during checkpoints: " << checkpointing << std::endl;
+
+  delete test_table;
+  delete bustub_instance;
+}
+
 }  // namespace bustub
@@ -10,9 +10,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
+#include <iostream>
+#include <random>
 #include <thread>  // NOLINT
 
 #include "buffer/buffer_pool_manager_instance.h"
@@ -333,4 +337,324 @@ TEST(BPlusTreeConcurrentTest, MixTest) {
   remove("test.log");
 }
 
+TEST(BPlusTreeConcurrentTest, SplitMergeStressTest) {
+  // create KeyComparator and index schema
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(500, disk_manager);
+  // small nodes, so that the threads split and merge pages all the time
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 5);
+  // create and fetch header_page
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= 2000; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+  LaunchParallelTest(4, InsertHelperSplit, &tree, keys, 4);
+
+  std::vector<int64_t> remove_keys;
+  for (auto key : keys) {
+    if (key % 3 != 0) {
+      remove_keys.push_back(key);
+    }
+  }
+  LaunchParallelTest(4, DeleteHelperSplit, &tree, remove_keys, 4);
+
+  std::vector<RID> rids;
+  GenericKey<8> index_key;
+  for (int64_t key = 1; key <= 2000; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_EQ(tree.GetValue(index_key, &rids), key % 3 == 0);
+  }
+  int64_t current_key = 3;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key = current_key + 3;
+  }
+  EXPECT_EQ(current_key, 2001);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeConcurrentTest, ReadDuringSplitMergeTest) {
+  // create KeyComparator and index schema
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(500, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 5);
+  // create and fetch header_page
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // the even keys stay put while writers keep splitting and merging the pages around them
+  std::vector<int64_t> stable_keys;
+  std::vector<int64_t> moving_keys;
+  for (int64_t key = 1; key <= 1000; key++) {
+    (key % 2 == 0 ? stable_keys : moving_keys).push_back(key);
+  }
+  InsertHelper(&tree, stable_keys);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&, i] {
+      for (int round = 0; round < 5; round++) {
+        InsertHelperSplit(&tree, moving_keys, 2, i);
+        DeleteHelperSplit(&tree, moving_keys, 2, i);
+      }
+    });
+  }
+  threads.emplace_back([&] {
+    while (!done) {
+      std::vector<RID> rids;
+      GenericKey<8> index_key;
+      for (auto key : stable_keys) {
+        rids.clear();
+        index_key.SetFromInteger(key);
+        ASSERT_TRUE(tree.GetValue(index_key, &rids)) << key;
+        EXPECT_EQ(rids[0].GetSlotNum(), key);
+      }
+    }
+  });
+  // batched lookups resume from pages of the path of the key before, which may have split or merged since
+  threads.emplace_back([&] {
+    while (!done) {
+      std::vector<std::pair<GenericKey<8>, GenericKey<8>>> ranges;
+      for (int64_t key : stable_keys) {
+        ranges.emplace_back();
+        ranges.back().first.SetFromInteger(key);
+        ranges.back().second.SetFromInteger(key);
+      }
+      std::vector<std::vector<RID>> results;
+      tree.ScanRanges(ranges, &results);
+      for (size_t i = 0; i < stable_keys.size(); i++) {
+        ASSERT_EQ(results[i].size(), 1) << stable_keys[i];
+        EXPECT_EQ(results[i][0].GetSlotNum(), stable_keys[i]);
+      }
+      // a range over all leaves
+      ranges.resize(1);
+      ranges[0].first.SetFromInteger(0);
+      ranges[0].second.SetFromInteger(1000);
+      tree.ScanRanges(ranges, &results);
+      int64_t even_key = 2;
+      for (const RID &rid : results[0]) {
+        if (rid.GetSlotNum() % 2 == 0) {
+          EXPECT_EQ(rid.GetSlotNum(), even_key);
+          even_key += 2;
+        }
+      }
+      EXPECT_EQ(even_key, 1002);
+    }
+  });
+  // reverse scans follow left links, which may lead to a leaf that split, merged or lent entries to the right since
+  threads.emplace_back([&] {
+    while (!done) {
+      int64_t even_key = 1000;
+      for (auto iterator = tree.RBegin(); !iterator.isEnd(); ++iterator) {
+        if ((*iterator).second.GetSlotNum() % 2 == 0) {
+          EXPECT_EQ((*iterator).second.GetSlotNum(), even_key);
+          even_key -= 2;
+        }
+      }
+      EXPECT_EQ(even_key, 0);
+    }
+  });
+  threads[0].join();
+  threads[1].join();
+  done = true;
+  threads[2].join();
+  threads[3].join();
+  threads[4].join();
+
+  int64_t current_key = 2;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key = current_key + 2;
+  }
+  EXPECT_EQ(current_key, 1002);
+  for (auto iterator = tree.RBegin(); iterator != tree.End(); ++iterator) {
+    current_key = current_key - 2;
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+  }
+  EXPECT_EQ(current_key, 2);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeConcurrentTest, ParallelRangeScanTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(500, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 5);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  // the even keys stay put while writers split and merge the pages around them
+  std::vector<int64_t> stable_keys;
+  std::vector<int64_t> moving_keys;
+  for (int64_t key = 1; key <= 2000; key++) {
+    (key % 2 == 0 ? stable_keys : moving_keys).push_back(key);
+  }
+  InsertHelper(&tree, stable_keys);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 2; i++) {
+    writers.emplace_back([&, i] {
+      while (!done) {
+        InsertHelperSplit(&tree, moving_keys, 2, i);
+        DeleteHelperSplit(&tree, moving_keys, 2, i);
+      }
+    });
+  }
+
+  GenericKey<8> start_key;
+  start_key.SetFromInteger(501);
+  for (int parts : {1, 4, 16}) {
+    for (int round = 0; round < 5; round++) {
+      std::vector<GenericKey<8>> bounds = tree.SplitRange(start_key, parts);
+      ASSERT_GE(bounds.size(), 1);
+      ASSERT_LE(bounds.size(), parts);
+      EXPECT_EQ(comparator(bounds[0], start_key), 0);
+      // each range is scanned by a thread of its own, the stable keys are seen once each, in order
+      std::vector<std::vector<int64_t>> seen(bounds.size());
+      std::vector<std::thread> scanners;
+      for (size_t i = 0; i < bounds.size(); i++) {
+        scanners.emplace_back([&, i] {
+          auto iterator = i + 1 < bounds.size() ? tree.Begin(bounds[i], bounds[i + 1]) : tree.Begin(bounds[i]);
+          for (; !iterator.isEnd(); ++iterator) {
+            if ((*iterator).second.GetSlotNum() % 2 == 0) {
+              seen[i].push_back((*iterator).second.GetSlotNum());
+            }
+          }
+        });
+      }
+      for (auto &scanner : scanners) {
+        scanner.join();
+      }
+      if (parts > 1) {
+        EXPECT_GT(bounds.size(), 1);
+      }
+      int64_t current_key = 502;
+      for (size_t i = 0; i < bounds.size(); i++) {
+        for (int64_t key : seen[i]) {
+          EXPECT_EQ(key, current_key);
+          current_key += 2;
+        }
+      }
+      EXPECT_EQ(current_key, 2002);
+    }
+  }
+  done = true;
+  for (auto &writer : writers) {
+    writer.join();
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeConcurrentTest, DISABLED_ParallelRangeScanBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  const int64_t num_keys = 4000000;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(40000, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  GenericKey<8> index_key;
+  std::vector<std::pair<GenericKey<8>, RID>> entries;
+  for (int64_t key = 1; key <= num_keys; key++) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(0, key));
+  }
+  tree.BulkLoad(&entries);
+
+  index_key.SetFromInteger(1);
+  for (int num_threads : {1, 4, 16}) {
+    std::vector<GenericKey<8>> bounds = tree.SplitRange(index_key, num_threads);
+    std::vector<int64_t> counts(bounds.size());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < bounds.size(); i++) {
+      threads.emplace_back([&, i] {
+        auto iterator = i + 1 < bounds.size() ? tree.Begin(bounds[i], bounds[i + 1]) : tree.Begin(bounds[i]);
+        for (; !iterator.isEnd(); ++iterator) {
+          counts[i] += (*iterator).second.GetSlotNum() != 0 ? 1 : 0;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    int64_t total = 0;
+    for (int64_t count : counts) {
+      total += count;
+    }
+    EXPECT_EQ(total, num_keys);
+    std::cout << num_threads << " threads, " << bounds.size() << " ranges: "
+              << static_cast<int64_t>(total / elapsed.count() / 1000000) << "M entries per second" << std::endl;
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeConcurrentTest, DISABLED_InsertScalingBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= 200000; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+
+  for (int num_threads : {1, 2, 4, 8, 16, 32}) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManagerInstance(10000, disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+
+    auto start = std::chrono::steady_clock::now();
+    LaunchParallelTest(num_threads, InsertHelperSplit, &tree, keys, num_threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << num_threads << " threads: " << static_cast<int64_t>(keys.size() / elapsed.count())
+              << " inserts per second" << std::endl;
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
 }  // namespace bustub
@@ -11,12 +11,16 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <iostream>
+#include <random>
 
 #include "buffer/buffer_pool_manager_instance.h"
 #include "gtest/gtest.h"
 #include "storage/index/b_plus_tree.h"
 #include "test_util.h"  // NOLINT
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -145,4 +149,606 @@ TEST(BPlusTreeTests, InsertTest2) {
   remove("test.db");
   remove("test.log");
 }
+
+TEST(BPlusTreeTests, BulkLoadTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(1000, disk_manager);
+  // small pages, so that the load stacks several internal levels
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 5, 4);
+  GenericKey<8> index_key;
+  RID rid;
+  Transaction *transaction = new Transaction(0);
+
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= 1000; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+  std::vector<std::pair<GenericKey<8>, RID>> entries;
+  for (auto key : keys) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(0, key));
+  }
+  // of equal keys the first one is kept, like with inserts
+  index_key.SetFromInteger(500);
+  entries.emplace_back(index_key, RID(1, 500));
+  EXPECT_TRUE(tree.BulkLoad(&entries, 0.75, transaction));
+  EXPECT_FALSE(tree.BulkLoad(&entries, 0.75, transaction));
+
+  std::vector<RID> rids;
+  for (auto key : keys) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.GetValue(index_key, &rids));
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0], RID(0, key));
+  }
+
+  int64_t current_key = 1;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key = current_key + 1;
+  }
+  EXPECT_EQ(current_key, keys.size() + 1);
+  // the loaded leaves are linked back as well
+  for (auto iterator = tree.RBegin(); iterator != tree.End(); ++iterator) {
+    current_key = current_key - 1;
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+  }
+  EXPECT_EQ(current_key, 1);
+
+  // the loaded tree takes inserts and removes like any other
+  for (int64_t key = 1001; key <= 1200; key++) {
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.Insert(index_key, RID(0, key), transaction));
+  }
+  for (int64_t key = 2; key <= 1200; key += 2) {
+    index_key.SetFromInteger(key);
+    tree.Remove(index_key, transaction);
+  }
+  for (int64_t key = 1; key <= 1200; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_EQ(tree.GetValue(index_key, &rids), key % 2 == 1);
+  }
+  current_key = 1;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key = current_key + 2;
+  }
+  EXPECT_EQ(current_key, 1201);
+  // a scan from a key that is not in the tree starts at the next larger one
+  index_key.SetFromInteger(600);
+  {
+    auto iterator = tree.Begin(index_key);
+    EXPECT_EQ((*iterator).second.GetSlotNum(), 601);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, DISABLED_BulkLoadBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  // raise to 10M keys together with the pool size on a machine with the memory for it
+  const int64_t num_keys = 1000000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= num_keys; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+
+  for (bool bulk_load : {false, true}) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManagerInstance(20000, disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+
+    GenericKey<8> index_key;
+    auto start = std::chrono::steady_clock::now();
+    if (bulk_load) {
+      std::vector<std::pair<GenericKey<8>, RID>> entries;
+      for (auto key : keys) {
+        index_key.SetFromInteger(key);
+        entries.emplace_back(index_key, RID(0, key));
+      }
+      tree.BulkLoad(&entries);
+    } else {
+      for (auto key : keys) {
+        index_key.SetFromInteger(key);
+        tree.Insert(index_key, RID(0, key));
+      }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    int64_t leaf_pages = 0;
+    page_id_t last_page_id = INVALID_PAGE_ID;
+    for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+      if (iterator.GetPageId() != last_page_id) {
+        last_page_id = iterator.GetPageId();
+        leaf_pages++;
+      }
+    }
+    std::cout << (bulk_load ? "bulk load: " : "inserts: ") << elapsed.count() << " s, " << leaf_pages
+              << " leaf pages" << std::endl;
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
+TEST(BPlusTreeTests, DISABLED_PointLookupBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  const int64_t num_keys = 100000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= num_keys; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+
+  // the last one is as many entries as fit a leaf page
+  const int full_page_size = static_cast<int>((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - 2 * sizeof(GenericKey<8>)) /
+                                               (1 + sizeof(RID)));
+  for (int page_size : {16, 64, full_page_size}) {
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManagerInstance(20000, disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, page_size, page_size);
+    page_id_t page_id;
+    bpm->NewPage(&page_id);
+
+    GenericKey<8> index_key;
+    std::vector<std::pair<GenericKey<8>, RID>> entries;
+    for (auto key : keys) {
+      index_key.SetFromInteger(key);
+      entries.emplace_back(index_key, RID(0, key));
+    }
+    tree.BulkLoad(&entries, 1.0);
+
+    std::vector<RID> rids;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, &rids);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "page size " << page_size << ": " << static_cast<int64_t>(elapsed.count() / keys.size())
+              << " ns per lookup" << std::endl;
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
+TEST(BPlusTreeTests, ScanRangesTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  // the multiples of 3 up to 3000
+  GenericKey<8> index_key;
+  for (int64_t key = 3; key <= 3000; key += 3) {
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, RID(0, key));
+  }
+
+  // single keys, present or not, near each other and far apart, and ranges over several leaves
+  std::mt19937 rng(15445);
+  for (int round = 0; round < 20; round++) {
+    std::vector<std::pair<GenericKey<8>, GenericKey<8>>> ranges;
+    std::vector<std::pair<int64_t, int64_t>> bounds;
+    for (int64_t low = 0; low <= 3100;) {
+      int64_t high = low + (rng() % 4 == 0 ? rng() % 60 : 0);
+      bounds.emplace_back(low, high);
+      ranges.emplace_back();
+      ranges.back().first.SetFromInteger(low);
+      ranges.back().second.SetFromInteger(high);
+      low = high + 1 + (rng() % 2 == 0 ? rng() % 3 : rng() % 300);
+    }
+    std::vector<std::vector<RID>> results;
+    tree.ScanRanges(ranges, &results);
+    ASSERT_EQ(results.size(), ranges.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+      std::vector<RID> expected;
+      for (int64_t key = bounds[i].first; key <= bounds[i].second && key <= 3000; key++) {
+        if (key % 3 == 0 && key > 0) {
+          expected.emplace_back(0, key);
+        }
+      }
+      EXPECT_EQ(results[i], expected) << bounds[i].first << " " << bounds[i].second;
+    }
+  }
+
+  // every page is unpinned again
+  for (int i = 0; i < 49; i++) {
+    EXPECT_NE(bpm->NewPage(&page_id), nullptr);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, ReverseScanTest) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  // the multiples of 3 up to 3000 that are not multiples of 9, the removes merge leaves and make them lend entries
+  std::vector<int64_t> keys;
+  for (int64_t key = 3; key <= 3000; key += 3) {
+    keys.push_back(key);
+  }
+  std::mt19937 rng(15445);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  GenericKey<8> index_key;
+  for (int64_t key : keys) {
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, RID(0, key));
+  }
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (int64_t key : keys) {
+    if (key % 9 == 0) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key);
+    }
+  }
+  std::vector<int64_t> expected;
+  for (int64_t key = 3000; key > 0; key--) {
+    if (key % 3 == 0 && key % 9 != 0) {
+      expected.push_back(key);
+    }
+  }
+
+  std::vector<int64_t> seen;
+  for (auto iterator = tree.RBegin(); iterator != tree.End(); ++iterator) {
+    seen.push_back((*iterator).second.GetSlotNum());
+  }
+  EXPECT_EQ(seen, expected);
+
+  // from the last key smaller than the high key, down to the end key
+  GenericKey<8> end_key;
+  for (int round = 0; round < 50; round++) {
+    int64_t high = rng() % 3100;
+    int64_t low = rng() % 2 == 0 ? high - static_cast<int64_t>(rng() % 300) : -1;
+    index_key.SetFromInteger(high);
+    end_key.SetFromInteger(low);
+    seen.clear();
+    auto iterator = low < 0 ? tree.RBegin(index_key) : tree.RBegin(index_key, end_key);
+    for (; !iterator.isEnd(); ++iterator) {
+      seen.push_back((*iterator).second.GetSlotNum());
+    }
+    std::vector<int64_t> in_range;
+    for (int64_t key : expected) {
+      if (key < high && (low < 0 || key >= low)) {
+        in_range.push_back(key);
+      }
+    }
+    EXPECT_EQ(seen, in_range) << low << " " << high;
+  }
+  // a scan may stop before its end
+  index_key.SetFromInteger(1500);
+  for (auto iterator = tree.RBegin(index_key); !iterator.isEnd(); ++iterator) {
+    if ((*iterator).second.GetSlotNum() < 1000) {
+      break;
+    }
+  }
+
+  // every page is unpinned again
+  for (int i = 0; i < 49; i++) {
+    EXPECT_NE(bpm->NewPage(&page_id), nullptr);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, DISABLED_BatchLookupBenchmark) {
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema.get());
+  const int64_t num_keys = 1000000;
+  const int batch_size = 1000;
+  const int num_batches = 200;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(20000, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  GenericKey<8> index_key;
+  std::vector<std::pair<GenericKey<8>, RID>> entries;
+  for (int64_t key = 1; key <= num_keys; key++) {
+    index_key.SetFromInteger(key);
+    entries.emplace_back(index_key, RID(0, key));
+  }
+  tree.BulkLoad(&entries);
+
+  // batches of random keys over the whole tree, and of keys from a window of it as the inner side of a join sees
+  std::mt19937 rng(15445);
+  for (int64_t window : {num_keys, num_keys / 100}) {
+    std::vector<std::vector<int64_t>> batches(num_batches);
+    for (auto &batch : batches) {
+      int64_t base = static_cast<int64_t>(rng() % (num_keys - window + 1));
+      for (int i = 0; i < batch_size; i++) {
+        batch.push_back(base + 1 + static_cast<int64_t>(rng() % window));
+      }
+      std::sort(batch.begin(), batch.end());
+      batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+    }
+
+    std::vector<RID> rids;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &batch : batches) {
+      for (auto key : batch) {
+        rids.clear();
+        index_key.SetFromInteger(key);
+        tree.GetValue(index_key, &rids);
+      }
+    }
+    std::chrono::duration<double, std::milli> one_by_one = std::chrono::steady_clock::now() - start;
+
+    std::vector<std::vector<RID>> results;
+    start = std::chrono::steady_clock::now();
+    for (const auto &batch : batches) {
+      std::vector<std::pair<GenericKey<8>, GenericKey<8>>> ranges(batch.size());
+      for (size_t i = 0; i < batch.size(); i++) {
+        ranges[i].first.SetFromInteger(batch[i]);
+        ranges[i].second = ranges[i].first;
+      }
+      tree.ScanRanges(ranges, &results);
+    }
+    std::chrono::duration<double, std::milli> batched = std::chrono::steady_clock::now() - start;
+    std::cout << "keys from " << window << ": " << one_by_one.count() / num_batches << " ms per batch one by one, "
+              << batched.count() / num_batches << " ms batched" << std::endl;
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, MultiColumnKeyTest) {
+  auto key_schema = ParseCreateStatement("a integer,b double,c varchar(8)");
+  GenericComparator<32> comparator(key_schema.get());
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(100, disk_manager);
+  BPlusTree<GenericKey<32>, RID, GenericComparator<32>> tree("foo_pk", bpm, comparator, 5, 4);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  // ints and decimals of both signs, strings that are prefixes of each other
+  std::vector<std::vector<Value>> rows;
+  const std::vector<std::string> strings = {"", "a", "ab", "abc", "b", "ba"};
+  for (int32_t a : {-1000, -1, 0, 1, 1000}) {
+    for (double b : {-2.5, -0.5, 0.0, 0.5, 2.5}) {
+      for (const auto &c : strings) {
+        rows.push_back({ValueFactory::GetIntegerValue(a), ValueFactory::GetDecimalValue(b),
+                        ValueFactory::GetVarcharValue(c)});
+      }
+    }
+  }
+  std::vector<size_t> order(rows.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(15445));
+  for (size_t i : order) {
+    GenericKey<32> index_key;
+    Tuple key_tuple(rows[i], key_schema.get());
+    index_key.SetFromKey(key_tuple, key_schema.get());
+    EXPECT_TRUE(tree.Insert(index_key, RID(0, i), transaction));
+
+    // the key reads back as its values and encodes into the same bytes again
+    for (uint32_t col = 0; col < key_schema->GetColumnCount(); col++) {
+      EXPECT_EQ(index_key.ToValue(key_schema.get(), col).CompareEquals(rows[i][col]), CmpBool::CmpTrue);
+    }
+    GenericKey<32> rebuilt_key;
+    rebuilt_key.SetFromKey(index_key.ToKeyTuple(key_schema.get()), key_schema.get());
+    EXPECT_EQ(comparator(rebuilt_key, index_key), 0);
+  }
+
+  // the rows were generated in value order, the tree has to return them in the same order
+  size_t expected = 0;
+  for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, rows.size());
+
+  // -0.0 is the same key as 0.0
+  GenericKey<32> zero_key;
+  GenericKey<32> negative_zero_key;
+  zero_key.SetFromKey(Tuple(rows[2 * strings.size()], key_schema.get()), key_schema.get());
+  std::vector<Value> negative_zero_row = rows[2 * strings.size()];
+  negative_zero_row[1] = ValueFactory::GetDecimalValue(-0.0);
+  negative_zero_key.SetFromKey(Tuple(negative_zero_row, key_schema.get()), key_schema.get());
+  EXPECT_EQ(comparator(zero_key, negative_zero_key), 0);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, PrefixCompressionTest) {
+  // the keys of a group share all but the low bytes of c, the pages store them without that prefix
+  auto key_schema = ParseCreateStatement("a integer,b varchar(52),c bigint");
+  GenericComparator<64> comparator(key_schema.get());
+  const int32_t num_groups = 4;
+  const int64_t keys_per_group = 4000;
+  const int uncompressed_page_size = static_cast<int>((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - 2 * sizeof(GenericKey<64>)) /
+                                                     sizeof(std::pair<GenericKey<64>, RID>));
+  auto make_key = [&](int64_t key) {
+    GenericKey<64> index_key;
+    Tuple key_tuple({ValueFactory::GetIntegerValue(static_cast<int32_t>(key / keys_per_group)),
+                     ValueFactory::GetVarcharValue(""), ValueFactory::GetBigIntValue(key % keys_per_group)},
+                    key_schema.get());
+    index_key.SetFromKey(key_tuple, key_schema.get());
+    return index_key;
+  };
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_groups * keys_per_group; key++) {
+    keys.push_back(key);
+  }
+  std::mt19937 random(15445);
+  std::shuffle(keys.begin(), keys.end(), random);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(1000, disk_manager);
+  BPlusTree<GenericKey<64>, RID, GenericComparator<64>> tree("foo_pk", bpm, comparator);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  std::vector<bool> present(keys.size(), false);
+  // look up every key and scan the tree, counting its leaves
+  auto check = [&](int *leaf_pages) {
+    std::vector<RID> rids;
+    for (int64_t key = 0; key < static_cast<int64_t>(keys.size()); key++) {
+      rids.clear();
+      ASSERT_EQ(tree.GetValue(make_key(key), &rids), present[key]) << key;
+    }
+    int64_t expected = 0;
+    *leaf_pages = 0;
+    page_id_t last_page_id = INVALID_PAGE_ID;
+    for (auto iterator = tree.Begin(); iterator != tree.End(); ++iterator) {
+      while (!present[expected]) {
+        expected++;
+      }
+      ASSERT_EQ((*iterator).second.GetSlotNum(), expected);
+      expected++;
+      if (iterator.GetPageId() != last_page_id) {
+        last_page_id = iterator.GetPageId();
+        (*leaf_pages)++;
+      }
+    }
+  };
+
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Insert(make_key(key), RID(0, key), transaction));
+    present[key] = true;
+  }
+  int leaf_pages = 0;
+  check(&leaf_pages);
+  EXPECT_LT(leaf_pages * 3, static_cast<int>(keys.size()) / uncompressed_page_size);
+
+  // merges and borrows between pages of different groups widen the pages they end up in
+  for (size_t i = 0; i < keys.size() * 3 / 4; i++) {
+    tree.Remove(make_key(keys[i]), transaction);
+    present[keys[i]] = false;
+  }
+  int scanned_pages = 0;
+  check(&scanned_pages);
+  std::shuffle(keys.begin(), keys.end(), random);
+  for (auto key : keys) {
+    EXPECT_EQ(tree.Insert(make_key(key), RID(0, key), transaction), !present[key]);
+    present[key] = true;
+  }
+  check(&scanned_pages);
+  for (auto key : keys) {
+    tree.Remove(make_key(key), transaction);
+    present[key] = false;
+  }
+  EXPECT_TRUE(tree.IsEmpty());
+
+  // a bulk load fills its pages as far as the prefix of each lets it
+  std::vector<std::pair<GenericKey<64>, RID>> entries;
+  for (auto key : keys) {
+    entries.emplace_back(make_key(key), RID(0, key));
+    present[key] = true;
+  }
+  EXPECT_TRUE(tree.BulkLoad(&entries, 1.0, transaction));
+  check(&scanned_pages);
+  EXPECT_LE(scanned_pages, leaf_pages);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, DISABLED_MultiColumnLookupBenchmark) {
+  auto key_schema = ParseCreateStatement("a integer,b bigint");
+  GenericComparator<16> comparator(key_schema.get());
+  const int64_t num_keys = 100000;
+  std::vector<GenericKey<16>> keys;
+  for (int64_t key = 0; key < num_keys; key++) {
+    GenericKey<16> index_key;
+    Tuple key_tuple({ValueFactory::GetIntegerValue(static_cast<int32_t>(key % 100)), ValueFactory::GetBigIntValue(key)},
+                    key_schema.get());
+    index_key.SetFromKey(key_tuple, key_schema.get());
+    keys.push_back(index_key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(15445));
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManagerInstance(20000, disk_manager);
+  BPlusTree<GenericKey<16>, RID, GenericComparator<16>> tree("foo_pk", bpm, comparator);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+  std::vector<std::pair<GenericKey<16>, RID>> entries;
+  for (size_t i = 0; i < keys.size(); i++) {
+    entries.emplace_back(keys[i], RID(0, i));
+  }
+  tree.BulkLoad(&entries);
+
+  std::vector<RID> rids;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &index_key : keys) {
+    rids.clear();
+    tree.GetValue(index_key, &rids);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << static_cast<int64_t>(keys.size() / elapsed.count()) << " lookups per second" << std::endl;
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
 }  // namespace bustub
@@ -10,7 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -24,12 +28,18 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    for (int i = 0; i < 16; i++) {
+      remove(("test.log." + std::to_string(i)).c_str());
+    }
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    for (int i = 0; i < 16; i++) {
+      remove(("test.log." + std::to_string(i)).c_str());
+    }
   };
 };
 
@@ -72,6 +82,118 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentRecycleTest) {
+  const int batch = LOG_SEGMENT_SIZE / 4;
+  std::vector<char> buffers[2] = {std::vector<char>(batch), std::vector<char>(batch)};
+  std::vector<char> buf(batch);
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+
+  auto count_segments = [] {
+    int count = 0;
+    for (int i = 0; i < 16; i++) {
+      count += std::ifstream("test.log." + std::to_string(i)).is_open() ? 1 : 0;
+    }
+    return count;
+  };
+
+  // every batch is filled with its number, so reads can tell batches apart
+  int written = 0;
+  auto write_batches = [&](int n) {
+    for (int i = 0; i < n; i++, written++) {
+      auto &data = buffers[written % 2];
+      std::memset(data.data(), written, batch);
+      dm.WriteLog(data.data(), batch, written);
+    }
+  };
+
+  write_batches(14);
+  EXPECT_EQ(4, count_segments());
+  EXPECT_EQ(14 * batch, dm.GetLogEnd());
+
+  dm.TruncateLog(2 * LOG_SEGMENT_SIZE + batch);
+  EXPECT_FALSE(dm.ReadLog(buf.data(), batch, 0));
+  EXPECT_FALSE(dm.ReadLog(buf.data(), batch, LOG_SEGMENT_SIZE));
+  ASSERT_TRUE(dm.ReadLog(buf.data(), batch, 2 * LOG_SEGMENT_SIZE));
+  EXPECT_EQ(8, buf[0]);
+  EXPECT_EQ(4, count_segments());
+
+  // the log grows into the recycled files instead of new ones
+  write_batches(10);
+  EXPECT_EQ(4, count_segments());
+  dm.ShutDown();
+
+  auto reopened = DiskManager(db_file);
+  log_offset_t offset;
+  lsn_t start_lsn;
+  ASSERT_TRUE(reopened.GetLastLogSegment(&offset, &start_lsn));
+  EXPECT_EQ(5 * LOG_SEGMENT_SIZE, offset);
+  EXPECT_EQ(20, start_lsn);
+  EXPECT_EQ(24 * batch, reopened.GetLogEnd());
+  EXPECT_FALSE(reopened.ReadLog(buf.data(), batch, LOG_SEGMENT_SIZE));
+  for (int i = 8; i < 24; i++) {
+    ASSERT_TRUE(reopened.ReadLog(buf.data(), batch, i * batch));
+    EXPECT_EQ(i, buf[batch - 1]);
+  }
+  reopened.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogOffsetPastInt32Test) {
+  const int batch = LOG_SEGMENT_SIZE / 4;
+  std::vector<char> buffers[2] = {std::vector<char>(batch), std::vector<char>(batch)};
+  std::vector<char> buf(batch);
+  std::string db_file("test.db");
+
+  // a log that has been recycled for a long time, its oldest live segment starts right below INT32_MAX
+  const int first_segment = INT32_MAX / LOG_SEGMENT_SIZE;
+  const log_offset_t log_start = static_cast<log_offset_t>(first_segment) * LOG_SEGMENT_SIZE;
+  {
+    std::ofstream log_control("test.log", std::ios::binary | std::ios::trunc | std::ios::out);
+    uint32_t log_id = 15445;
+    log_control.write(reinterpret_cast<const char *>(&first_segment), sizeof(int));
+    log_control.write(reinterpret_cast<const char *>(&log_id), sizeof(uint32_t));
+  }
+  auto dm = DiskManager(db_file);
+  EXPECT_EQ(log_start, dm.GetLogStart());
+  EXPECT_EQ(log_start, dm.GetLogEnd());
+
+  for (int i = 0; i < 12; i++) {
+    auto &data = buffers[i % 2];
+    std::memset(data.data(), i, batch);
+    dm.WriteLog(data.data(), batch, i);
+  }
+  EXPECT_EQ(log_start + 12 * batch, dm.GetLogEnd());
+  EXPECT_GT(dm.GetLogEnd(), INT32_MAX);
+  for (int i = 0; i < 12; i++) {
+    ASSERT_TRUE(dm.ReadLog(buf.data(), batch, log_start + i * batch));
+    EXPECT_EQ(i, buf[batch - 1]);
+  }
+  dm.WriteMasterRecord(log_start + 9 * batch);
+  dm.TruncateLog(log_start + 2 * LOG_SEGMENT_SIZE);
+  EXPECT_FALSE(dm.ReadLog(buf.data(), batch, log_start));
+  EXPECT_EQ(log_start + 2 * LOG_SEGMENT_SIZE, dm.GetLogStart());
+  dm.ShutDown();
+
+  auto reopened = DiskManager(db_file);
+  log_offset_t offset;
+  lsn_t start_lsn;
+  ASSERT_TRUE(reopened.GetLastLogSegment(&offset, &start_lsn));
+  EXPECT_EQ(log_start + 2 * LOG_SEGMENT_SIZE, offset);
+  EXPECT_EQ(8, start_lsn);
+  EXPECT_EQ(log_start + 12 * batch, reopened.GetLogEnd());
+  EXPECT_EQ(log_start + 9 * batch, reopened.ReadMasterRecord());
+  ASSERT_TRUE(reopened.ReadLog(buf.data(), batch, log_start + 11 * batch));
+  EXPECT_EQ(11, buf[0]);
+  reopened.ShutDown();
+
+  remove("test.master");
+  for (int i = first_segment; i < first_segment + 8; i++) {
+    remove(("test.log." + std::to_string(i)).c_str());
+  }
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 